@@ -0,0 +1,196 @@
+#include <cstdlib>
+#include <iostream>
+#include <queue>
+#include "aho_corasick.hpp"
+#include "utils.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FASTX_AHO_CORASICK_X86 1
+#endif
+
+
+static
+size_t FindFirstOfScalar(const char *text, size_t len, const uint8_t *bytes,
+    int n)
+{
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t c = static_cast<uint8_t>(text[i]);
+        for (int k = 0; k < n; ++k) {
+            if (c == bytes[k]) return i;
+        }
+    }
+    return len;
+}
+
+
+#ifdef FASTX_AHO_CORASICK_X86
+
+__attribute__((target("sse2")))
+static
+size_t FindFirstOfSse2(const char *text, size_t len, const uint8_t *bytes,
+    int n)
+{
+    __m128i set[AHO_CORASICK_MAX_PREFILTER_BYTES];
+    for (int k = 0; k < n; ++k) set[k] = _mm_set1_epi8(bytes[k]);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(text + i));
+        __m128i hit = _mm_cmpeq_epi8(x, set[0]);
+        for (int k = 1; k < n; ++k) {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(x, set[k]));
+        }
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + FindFirstOfScalar(text + i, len - i, bytes, n);
+}
+
+
+__attribute__((target("avx2")))
+static
+size_t FindFirstOfAvx2(const char *text, size_t len, const uint8_t *bytes,
+    int n)
+{
+    __m256i set[AHO_CORASICK_MAX_PREFILTER_BYTES];
+    for (int k = 0; k < n; ++k) set[k] = _mm256_set1_epi8(bytes[k]);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(text + i));
+        __m256i hit = _mm256_cmpeq_epi8(x, set[0]);
+        for (int k = 1; k < n; ++k) {
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(x, set[k]));
+        }
+        uint32_t mask = _mm256_movemask_epi8(hit);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + FindFirstOfSse2(text + i, len - i, bytes, n);
+}
+
+#endif  // FASTX_AHO_CORASICK_X86
+
+
+size_t FindFirstOf(const char *text, size_t len, const uint8_t *bytes, int n)
+{
+    typedef size_t (*Kernel)(const char *, size_t, const uint8_t *, int);
+    static const Kernel kernel = [] {
+#ifdef FASTX_AHO_CORASICK_X86
+        __builtin_cpu_init();
+        if (SimdLimit() >= SimdLevel::kAvx2 &&
+            __builtin_cpu_supports("avx2"))
+        {
+            return &FindFirstOfAvx2;
+        }
+        if (SimdLimit() >= SimdLevel::kSse &&
+            __builtin_cpu_supports("sse2"))
+        {
+            return &FindFirstOfSse2;
+        }
+#endif
+        return &FindFirstOfScalar;
+    }();
+    return kernel(text, len, bytes, n);
+}
+
+
+void AhoCorasick::add(const std::string &pattern, int id) {
+    if (pattern.empty()) {
+        std::cerr << "[AhoCorasick::add] Error! Empty pattern" << std::endl;
+        std::exit(1);
+    }
+    patterns_.emplace_back(pattern, id);
+}
+
+
+void AhoCorasick::build() {
+    auto fold = [this](uint8_t c) -> uint8_t {
+        return ignore_case_ && c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+    };
+
+    // class 0 is for the bytes in no pattern
+    for (auto &p: patterns_) {
+        for (char c: p.first) {
+            uint8_t b = fold(static_cast<uint8_t>(c));
+            if (class_[b] == 0) class_[b] = n_classes_++;
+        }
+    }
+    if (ignore_case_) {
+        for (int c = 'a'; c <= 'z'; ++c) class_[c] = class_[c - 'a' + 'A'];
+    }
+
+    // trie, -1 for missing transitions
+    std::vector<std::vector<int32_t>> outputs(1);
+    delta_.assign(n_classes_, -1);
+    for (auto &p: patterns_) {
+        int32_t state = 0;
+        for (char c: p.first) {
+            size_t t = state * n_classes_ + class_[static_cast<uint8_t>(c)];
+            if (delta_[t] == -1) {
+                delta_[t] = outputs.size();
+                outputs.emplace_back();
+                delta_.resize(delta_.size() + n_classes_, -1);
+            }
+            state = delta_[t];
+        }
+        outputs[state].push_back(p.second);
+    }
+
+    // failure links in breadth first order, missing transitions are
+    // replaced with those of the failure state
+    size_t n_states = outputs.size();
+    std::vector<int32_t> fail(n_states, 0);
+    dict_link_.assign(n_states, -1);
+    std::queue<int32_t> queue;
+    for (int32_t c = 0; c < n_classes_; ++c) {
+        int32_t &t = delta_[c];
+        if (t == -1) {
+            t = 0;
+        } else {
+            queue.push(t);
+        }
+    }
+    while (!queue.empty()) {
+        int32_t s = queue.front();
+        queue.pop();
+        for (int32_t c = 0; c < n_classes_; ++c) {
+            int32_t &t = delta_[s * n_classes_ + c];
+            int32_t f = delta_[fail[s] * n_classes_ + c];
+            if (t == -1) {
+                t = f;
+                continue;
+            }
+            fail[t] = f;
+            dict_link_[t] = outputs[f].empty() ? dict_link_[f] : f;
+            queue.push(t);
+        }
+    }
+
+    out_begin_.assign(n_states + 1, 0);
+    out_ids_.clear();
+    has_output_.assign(n_states, 0);
+    for (size_t s = 0; s < n_states; ++s) {
+        out_begin_[s] = out_ids_.size();
+        out_ids_.insert(out_ids_.end(), outputs[s].begin(), outputs[s].end());
+        has_output_[s] = !outputs[s].empty() || dict_link_[s] != -1;
+    }
+    out_begin_[n_states] = out_ids_.size();
+
+    // prefilter on the first bytes
+    bool first[256] = {false};
+    for (auto &p: patterns_) {
+        uint8_t b = fold(static_cast<uint8_t>(p.first[0]));
+        first[b] = true;
+        if (ignore_case_ && b >= 'A' && b <= 'Z') first[b - 'A' + 'a'] = true;
+    }
+    n_first_bytes_ = 0;
+    for (int c = 0; c < 256; ++c) {
+        if (!first[c]) continue;
+        if (n_first_bytes_ == AHO_CORASICK_MAX_PREFILTER_BYTES) {
+            n_first_bytes_ = 0;
+            break;
+        }
+        first_bytes_[n_first_bytes_++] = c;
+    }
+}
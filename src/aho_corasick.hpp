@@ -0,0 +1,100 @@
+#ifndef FASTX_AHO_CORASICK_HPP
+#define FASTX_AHO_CORASICK_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// max number of distinct first bytes(both cases if ignoring case) of the
+// patterns to use the prefilter
+const int AHO_CORASICK_MAX_PREFILTER_BYTES = 4;
+
+
+/**
+ * @brief offset of the first byte of text in bytes, len if there is none.
+ * Uses AVX2 or SSE2 if the cpu supports them(checked at runtime).
+ *
+ * @param n number of bytes, at most AHO_CORASICK_MAX_PREFILTER_BYTES
+ */
+size_t FindFirstOf(const char *text, size_t len, const uint8_t *bytes, int n);
+
+
+/**
+ * @brief Aho-Corasick automaton over many patterns. Transitions are a dense
+ * table over the classes of the bytes in the patterns(all other bytes share
+ * one class), so that each text byte is a single lookup. While in the root
+ * state, text is skipped to the next first byte of a pattern by FindFirstOf
+ * if patterns start with few distinct bytes.
+ */
+class AhoCorasick {
+public:
+    /**
+     * @param ignore_case letters match in both cases
+     */
+    explicit AhoCorasick(bool ignore_case = false):
+        ignore_case_(ignore_case) {}
+
+    /**
+     * @brief add a non empty pattern reported as id, before build
+     */
+    void add(const std::string &pattern, int id);
+
+    void build();
+
+    /**
+     * @brief call func(id, end) for each match in text, end is the position
+     * past the last byte of the match. Stops once func returns true.
+     *
+     * @return true if stopped by func
+     */
+    template <typename Func>
+    bool search(const char *text, size_t len, Func func) const {
+        int32_t state = 0;
+        for (size_t i = 0; i < len; ++i) {
+            if (state == 0 && n_first_bytes_) {
+                i += FindFirstOf(text + i, len - i, first_bytes_,
+                    n_first_bytes_);
+                if (i == len) break;
+            }
+            state = delta_[state * n_classes_ +
+                class_[static_cast<uint8_t>(text[i])]];
+            if (!has_output_[state]) continue;
+
+            int32_t s = out_begin_[state] == out_begin_[state + 1] ?
+                dict_link_[state] : state;
+            for (; s != -1; s = dict_link_[s]) {
+                for (int32_t k = out_begin_[s]; k < out_begin_[s + 1]; ++k) {
+                    if (func(out_ids_[k], i + 1)) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    bool ignore_case_;
+    std::vector<std::pair<std::string, int>> patterns_;
+
+    uint8_t class_[256] = {0};
+    int32_t n_classes_ = 1;
+    // transitions, state * n_classes_ + class
+    std::vector<int32_t> delta_;
+    // ids of the patterns ending at a state are out_ids_[out_begin_[state],
+    // out_begin_[state + 1])
+    std::vector<int32_t> out_begin_;
+    std::vector<int32_t> out_ids_;
+    // nearest proper suffix state with patterns, -1 if none
+    std::vector<int32_t> dict_link_;
+    // the state or a suffix of it has patterns
+    std::vector<uint8_t> has_output_;
+
+    uint8_t first_bytes_[AHO_CORASICK_MAX_PREFILTER_BYTES] = {0};
+    // 0 if the prefilter is not used
+    int n_first_bytes_ = 0;
+};
+
+
+#endif  // FASTX_AHO_CORASICK_HPP
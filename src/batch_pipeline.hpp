@@ -0,0 +1,153 @@
+#ifndef FASTX_BATCH_PIPELINE_HPP
+#define FASTX_BATCH_PIPELINE_HPP
+
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "htslib/bgzf.h"
+#include "htslib/kstring.h"
+#include "htslib/thread_pool.h"
+
+
+// batches processed per thread ahead of the writer
+const uint64_t BATCH_PIPELINE_BATCHES_PER_THREAD = 4;
+
+
+/**
+ * @brief open output, gzip(BGZF) compressed if the file name ends with .gz.
+ * Compressed outputs use the thread pool.
+ */
+inline
+BGZF *BgzfOpenOutput(const std::string &output, int compress_level,
+    hts_tpool *pool)
+{
+    std::string mode = "wu";
+    if (output.size() >= 3 && output.substr(output.size()-3) == ".gz") {
+        mode = "w" + std::to_string(compress_level);
+    }
+
+    BGZF *outfp = bgzf_open(output.c_str(), mode.c_str());
+    if (outfp == NULL) {
+        std::cerr << "Error! Can not open " << output << " for writing"
+            << std::endl;
+        std::exit(1);
+    }
+    if (mode != "wu") bgzf_thread_pool(outfp, pool, 0);
+    return outfp;
+}
+
+
+inline
+void BgzfWriteOutput(BGZF *outfp, const char *data, size_t len,
+    const std::string &output)
+{
+    if (len && bgzf_write(outfp, data, len) < 0) {
+        std::cerr << "Error! Failed to write " << output << std::endl;
+        std::exit(1);
+    }
+}
+
+
+inline
+void BgzfWriteOutput(BGZF *outfp, const kstring_t &str,
+    const std::string &output)
+{
+    BgzfWriteOutput(outfp, str.s, str.l, output);
+}
+
+
+/**
+ * @brief process batches in parallel and consume the results in input
+ * order. Each worker takes a batch with its id, waits until the batch is
+ * within threads * BATCH_PIPELINE_BATCHES_PER_THREAD batches of the writer,
+ * and processes it into a Result. The calling thread hands the results to
+ * write() in id order, so ids must be 0, 1, 2, ... in the order batches are
+ * taken(as SeqReader::read_batch and PairReader::read_batch give them).
+ *
+ * @param take bool(Batch *batch, uint64_t *id), the next batch, false at the
+ * end of input. Called by the workers concurrently.
+ * @param process void(Batch *batch, uint64_t id, Result *result), also
+ * gives back the batch
+ * @param write void(Result &result), called in the calling thread
+ */
+template <typename Batch, typename Result, typename Take, typename Process,
+    typename Write>
+void RunBatchPipeline(int threads, Take take, Process process, Write write)
+{
+    std::map<uint64_t, Result> results;
+    uint64_t written = 0;
+    int finished = 0;
+    uint64_t window = static_cast<uint64_t>(threads) *
+        BATCH_PIPELINE_BATCHES_PER_THREAD;
+    std::mutex mutex;
+    std::condition_variable worker_cv;
+    std::condition_variable writer_cv;
+
+    auto worker = [&]() {
+        Batch batch{};
+        uint64_t id = 0;
+        while (take(&batch, &id)) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                worker_cv.wait(lock, [&]{return id < written + window;});
+            }
+
+            // value initialized, a kstring_t result starts empty
+            Result result{};
+            process(&batch, id, &result);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results.emplace(id, std::move(result));
+            }
+            writer_cv.notify_one();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++finished;
+        }
+        writer_cv.notify_one();
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+
+    while (true) {
+        Result result{};
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            writer_cv.wait(lock, [&]{
+                return results.count(written) || finished == threads;});
+            auto iter = results.find(written);
+            if (iter == results.end()) break;
+            result = std::move(iter->second);
+            results.erase(iter);
+        }
+
+        write(result);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++written;
+        }
+        worker_cv.notify_all();
+    }
+
+    for (auto &w: workers) w.join();
+}
+
+
+#endif  // FASTX_BATCH_PIPELINE_HPP
@@ -0,0 +1,100 @@
+#ifndef FASTX_BGZF_CLOSER_HPP
+#define FASTX_BGZF_CLOSER_HPP
+
+
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "htslib/bgzf.h"
+
+
+const int BGZF_CLOSER_MAX_PENDING = 4;
+
+
+/**
+ * @brief close BGZF writers in a background thread.
+ *
+ * bgzf_close has to wait for all blocks of the file to be compressed by the
+ * thread pool, closing a chunk in the main thread drains the pool at every
+ * chunk boundary. With the closer the next chunk is filled while previous
+ * chunks are being finalized, at most max_pending chunks are in flight.
+ * All writers should share one hts_tpool, and the pool must outlive the
+ * closer(call wait() before hts_tpool_destroy).
+ */
+class BgzfCloser {
+public:
+    explicit BgzfCloser(int max_pending = BGZF_CLOSER_MAX_PENDING):
+        max_pending_(max_pending < 1 ? 1 : max_pending), stop_(false)
+    {
+        closer_ = std::thread([this]() {
+            while (true) {
+                std::pair<BGZF *, std::string> item;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    closer_cv_.wait(lock,
+                        [this]{return !pending_.empty() || stop_;});
+                    if (pending_.empty()) break;
+                    item = pending_.front();
+                }
+
+                if (bgzf_close(item.first) < 0) {
+                    std::cerr << "[BgzfCloser] Error! Failed to close "
+                        << item.second << std::endl;
+                    std::exit(1);
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    pending_.pop();
+                }
+                producer_cv_.notify_all();
+            }
+        });
+    }
+
+    ~BgzfCloser() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        closer_cv_.notify_one();
+        if (closer_.joinable()) closer_.join();
+    }
+
+    /**
+     * @brief hand over a writer to be closed, blocks while max_pending
+     * writers are still being closed. fp must not be used after this call.
+     */
+    void close(BGZF *fp, const std::string &filename) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        producer_cv_.wait(lock,
+            [this]{return static_cast<int>(pending_.size()) < max_pending_;});
+        pending_.emplace(fp, filename);
+        closer_cv_.notify_one();
+    }
+
+    // wait until all handed over writers are closed
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        producer_cv_.wait(lock, [this]{return pending_.empty();});
+    }
+
+private:
+    int max_pending_;
+    bool stop_;
+    std::queue<std::pair<BGZF *, std::string>> pending_;
+    std::thread closer_;
+    std::mutex mutex_;
+    std::condition_variable closer_cv_;
+    std::condition_variable producer_cv_;
+};
+
+
+#endif  // FASTX_BGZF_CLOSER_HPP
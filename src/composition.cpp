@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "composition.hpp"
+#include "utils.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define FASTX_COMPOSITION_X86 1
+#endif
+
+
+// phred+33 characters of quality 20 and 30
+const char QUAL_CHAR_20 = 33 + 20;
+const char QUAL_CHAR_30 = 33 + 30;
+
+// byte counters of the vector kernels are flushed before they overflow
+const int BYTE_COUNTER_MAX = 255;
+
+// expected errors are summed in lanes, lane k adds qual[i + k] for every i
+// multiple of the lane count. All kernels add in this order, so the result
+// does not depend on the cpu.
+const int EXPECTED_ERRORS_LANES = 8;
+
+
+/**
+ * @brief index of a base in BaseCounts(0-4 for ACGTN), 5 for the others
+ */
+static
+const uint8_t *BaseIndexTable() {
+    static uint8_t table[256];
+    static bool initialized = [] {
+        std::memset(table, 5, sizeof(table));
+        const char *bases = "ACGTN";
+        for (int i = 0; i < 5; ++i) {
+            table[static_cast<unsigned char>(bases[i])] = i;
+            table[static_cast<unsigned char>(bases[i] | 0x20)] = i;
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+
+
+/**
+ * @brief error probability by quality character, characters below '!' have
+ * quality 0
+ */
+static
+const float *ErrorProbTable() {
+    static float table[256];
+    static bool initialized = [] {
+        for (int c = 0; c < 256; ++c) {
+            int q = std::max(c - 33, 0);
+            table[c] = static_cast<float>(std::pow(10.0, -q / 10.0));
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+
+
+static
+void CountBasesScalar(const char *seq, size_t len, BaseCounts *counts) {
+    const uint8_t *table = BaseIndexTable();
+    uint64_t n[6] = {0};
+    for (size_t i = 0; i < len; ++i) {
+        ++n[table[static_cast<unsigned char>(seq[i])]];
+    }
+    counts->a += n[0];
+    counts->c += n[1];
+    counts->g += n[2];
+    counts->t += n[3];
+    counts->n += n[4];
+}
+
+
+static
+void CountQualsScalar(const char *qual, size_t len, QualCounts *counts) {
+    for (size_t i = 0; i < len; ++i) {
+        counts->q20 += qual[i] >= QUAL_CHAR_20;
+        counts->q30 += qual[i] >= QUAL_CHAR_30;
+        counts->sum += static_cast<unsigned char>(qual[i]) - 33;
+    }
+}
+
+
+// sum of the lanes in order, then the tail
+static
+double ExpectedErrorsReduce(const double *lanes, const char *qual,
+    size_t len)
+{
+    const float *table = ErrorProbTable();
+    double sum = 0;
+    for (int k = 0; k < EXPECTED_ERRORS_LANES; ++k) sum += lanes[k];
+    for (size_t i = 0; i < len; ++i) {
+        sum += table[static_cast<unsigned char>(qual[i])];
+    }
+    return sum;
+}
+
+
+static
+double ExpectedErrorsScalar(const char *qual, size_t len) {
+    const float *table = ErrorProbTable();
+    double lanes[EXPECTED_ERRORS_LANES] = {0};
+    size_t i = 0;
+    for (; i + EXPECTED_ERRORS_LANES <= len; i += EXPECTED_ERRORS_LANES) {
+        for (int k = 0; k < EXPECTED_ERRORS_LANES; ++k) {
+            lanes[k] += table[static_cast<unsigned char>(qual[i + k])];
+        }
+    }
+    return ExpectedErrorsReduce(lanes, qual + i, len - i);
+}
+
+
+#ifdef FASTX_COMPOSITION_X86
+
+/*
+ * Bases are folded to lower case(| 0x20, only A and a become a), compared
+ * with each base and the matches are accumulated in byte counters, which
+ * are summed to 64-bit counters by sad every BYTE_COUNTER_MAX vectors.
+ */
+
+__attribute__((target("sse2")))
+static inline
+uint64_t Sum64Sse2(__m128i x) {
+    return static_cast<uint64_t>(_mm_cvtsi128_si64(x)) +
+        static_cast<uint64_t>(_mm_cvtsi128_si64(_mm_unpackhi_epi64(x, x)));
+}
+
+
+__attribute__((target("sse2")))
+static
+void CountBasesSse2(const char *seq, size_t len, BaseCounts *counts) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i base_a = _mm_set1_epi8('a');
+    const __m128i base_c = _mm_set1_epi8('c');
+    const __m128i base_g = _mm_set1_epi8('g');
+    const __m128i base_t = _mm_set1_epi8('t');
+    const __m128i base_n = _mm_set1_epi8('n');
+    size_t i = 0;
+    while (i + 16 <= len) {
+        __m128i acc_a = zero;
+        __m128i acc_c = zero;
+        __m128i acc_g = zero;
+        __m128i acc_t = zero;
+        __m128i acc_n = zero;
+        for (int k = 0; k < BYTE_COUNTER_MAX && i + 16 <= len; ++k, i += 16) {
+            __m128i x = _mm_or_si128(_mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(seq + i)), case_bit);
+            acc_a = _mm_sub_epi8(acc_a, _mm_cmpeq_epi8(x, base_a));
+            acc_c = _mm_sub_epi8(acc_c, _mm_cmpeq_epi8(x, base_c));
+            acc_g = _mm_sub_epi8(acc_g, _mm_cmpeq_epi8(x, base_g));
+            acc_t = _mm_sub_epi8(acc_t, _mm_cmpeq_epi8(x, base_t));
+            acc_n = _mm_sub_epi8(acc_n, _mm_cmpeq_epi8(x, base_n));
+        }
+        counts->a += Sum64Sse2(_mm_sad_epu8(acc_a, zero));
+        counts->c += Sum64Sse2(_mm_sad_epu8(acc_c, zero));
+        counts->g += Sum64Sse2(_mm_sad_epu8(acc_g, zero));
+        counts->t += Sum64Sse2(_mm_sad_epu8(acc_t, zero));
+        counts->n += Sum64Sse2(_mm_sad_epu8(acc_n, zero));
+    }
+    CountBasesScalar(seq + i, len - i, counts);
+}
+
+
+__attribute__((target("sse2")))
+static
+void CountQualsSse2(const char *qual, size_t len, QualCounts *counts) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i below_20 = _mm_set1_epi8(QUAL_CHAR_20 - 1);
+    const __m128i below_30 = _mm_set1_epi8(QUAL_CHAR_30 - 1);
+    __m128i sum = zero;
+    size_t i = 0;
+    while (i + 16 <= len) {
+        __m128i acc_20 = zero;
+        __m128i acc_30 = zero;
+        for (int k = 0; k < BYTE_COUNTER_MAX && i + 16 <= len; ++k, i += 16) {
+            __m128i x = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(qual + i));
+            acc_20 = _mm_sub_epi8(acc_20, _mm_cmpgt_epi8(x, below_20));
+            acc_30 = _mm_sub_epi8(acc_30, _mm_cmpgt_epi8(x, below_30));
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(x, zero));
+        }
+        counts->q20 += Sum64Sse2(_mm_sad_epu8(acc_20, zero));
+        counts->q30 += Sum64Sse2(_mm_sad_epu8(acc_30, zero));
+    }
+    counts->sum += Sum64Sse2(sum) - 33 * static_cast<uint64_t>(i);
+    CountQualsScalar(qual + i, len - i, counts);
+}
+
+
+__attribute__((target("avx2")))
+static inline
+uint64_t Sum64Avx2(__m256i x) {
+    return Sum64Sse2(_mm_add_epi64(_mm256_castsi256_si128(x),
+        _mm256_extracti128_si256(x, 1)));
+}
+
+
+__attribute__((target("avx2")))
+static
+void CountBasesAvx2(const char *seq, size_t len, BaseCounts *counts) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i base_a = _mm256_set1_epi8('a');
+    const __m256i base_c = _mm256_set1_epi8('c');
+    const __m256i base_g = _mm256_set1_epi8('g');
+    const __m256i base_t = _mm256_set1_epi8('t');
+    const __m256i base_n = _mm256_set1_epi8('n');
+    size_t i = 0;
+    while (i + 32 <= len) {
+        __m256i acc_a = zero;
+        __m256i acc_c = zero;
+        __m256i acc_g = zero;
+        __m256i acc_t = zero;
+        __m256i acc_n = zero;
+        for (int k = 0; k < BYTE_COUNTER_MAX && i + 32 <= len; ++k, i += 32) {
+            __m256i x = _mm256_or_si256(_mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(seq + i)), case_bit);
+            acc_a = _mm256_sub_epi8(acc_a, _mm256_cmpeq_epi8(x, base_a));
+            acc_c = _mm256_sub_epi8(acc_c, _mm256_cmpeq_epi8(x, base_c));
+            acc_g = _mm256_sub_epi8(acc_g, _mm256_cmpeq_epi8(x, base_g));
+            acc_t = _mm256_sub_epi8(acc_t, _mm256_cmpeq_epi8(x, base_t));
+            acc_n = _mm256_sub_epi8(acc_n, _mm256_cmpeq_epi8(x, base_n));
+        }
+        counts->a += Sum64Avx2(_mm256_sad_epu8(acc_a, zero));
+        counts->c += Sum64Avx2(_mm256_sad_epu8(acc_c, zero));
+        counts->g += Sum64Avx2(_mm256_sad_epu8(acc_g, zero));
+        counts->t += Sum64Avx2(_mm256_sad_epu8(acc_t, zero));
+        counts->n += Sum64Avx2(_mm256_sad_epu8(acc_n, zero));
+    }
+    CountBasesSse2(seq + i, len - i, counts);
+}
+
+
+__attribute__((target("avx2")))
+static
+void CountQualsAvx2(const char *qual, size_t len, QualCounts *counts) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i below_20 = _mm256_set1_epi8(QUAL_CHAR_20 - 1);
+    const __m256i below_30 = _mm256_set1_epi8(QUAL_CHAR_30 - 1);
+    __m256i sum = zero;
+    size_t i = 0;
+    while (i + 32 <= len) {
+        __m256i acc_20 = zero;
+        __m256i acc_30 = zero;
+        for (int k = 0; k < BYTE_COUNTER_MAX && i + 32 <= len; ++k, i += 32) {
+            __m256i x = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(qual + i));
+            acc_20 = _mm256_sub_epi8(acc_20, _mm256_cmpgt_epi8(x, below_20));
+            acc_30 = _mm256_sub_epi8(acc_30, _mm256_cmpgt_epi8(x, below_30));
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(x, zero));
+        }
+        counts->q20 += Sum64Avx2(_mm256_sad_epu8(acc_20, zero));
+        counts->q30 += Sum64Avx2(_mm256_sad_epu8(acc_30, zero));
+    }
+    counts->sum += Sum64Avx2(sum) - 33 * static_cast<uint64_t>(i);
+    CountQualsSse2(qual + i, len - i, counts);
+}
+
+
+
+__attribute__((target("avx2")))
+static
+double ExpectedErrorsAvx2(const char *qual, size_t len) {
+    const float *table = ErrorProbTable();
+    // the gathered probabilities are widened, sums are in double precision
+    __m256d sum_low = _mm256_setzero_pd();
+    __m256d sum_high = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + EXPECTED_ERRORS_LANES <= len; i += EXPECTED_ERRORS_LANES) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i *>(qual + i)));
+        __m256 prob = _mm256_i32gather_ps(table, idx, 4);
+        sum_low = _mm256_add_pd(sum_low,
+            _mm256_cvtps_pd(_mm256_castps256_ps128(prob)));
+        sum_high = _mm256_add_pd(sum_high,
+            _mm256_cvtps_pd(_mm256_extractf128_ps(prob, 1)));
+    }
+    double lanes[EXPECTED_ERRORS_LANES];
+    _mm256_storeu_pd(lanes, sum_low);
+    _mm256_storeu_pd(lanes + 4, sum_high);
+    return ExpectedErrorsReduce(lanes, qual + i, len - i);
+}
+
+#endif  // FASTX_COMPOSITION_X86
+
+
+void CountBases(const char *seq, size_t len, BaseCounts *counts) {
+    typedef void (*Kernel)(const char *, size_t, BaseCounts *);
+    static const Kernel kernel = [] {
+#ifdef FASTX_COMPOSITION_X86
+        __builtin_cpu_init();
+        if (SimdLimit() >= SimdLevel::kAvx2 &&
+            __builtin_cpu_supports("avx2"))
+        {
+            return &CountBasesAvx2;
+        }
+        if (SimdLimit() >= SimdLevel::kSse &&
+            __builtin_cpu_supports("sse2"))
+        {
+            return &CountBasesSse2;
+        }
+#endif
+        return &CountBasesScalar;
+    }();
+    kernel(seq, len, counts);
+}
+
+
+void CountQuals(const char *qual, size_t len, QualCounts *counts) {
+    typedef void (*Kernel)(const char *, size_t, QualCounts *);
+    static const Kernel kernel = [] {
+#ifdef FASTX_COMPOSITION_X86
+        __builtin_cpu_init();
+        if (SimdLimit() >= SimdLevel::kAvx2 &&
+            __builtin_cpu_supports("avx2"))
+        {
+            return &CountQualsAvx2;
+        }
+        if (SimdLimit() >= SimdLevel::kSse &&
+            __builtin_cpu_supports("sse2"))
+        {
+            return &CountQualsSse2;
+        }
+#endif
+        return &CountQualsScalar;
+    }();
+    kernel(qual, len, counts);
+}
+
+
+double ExpectedErrors(const char *qual, size_t len) {
+    typedef double (*Kernel)(const char *, size_t);
+    static const Kernel kernel = [] {
+#ifdef FASTX_COMPOSITION_X86
+        __builtin_cpu_init();
+        if (SimdLimit() >= SimdLevel::kAvx2 &&
+            __builtin_cpu_supports("avx2"))
+        {
+            return &ExpectedErrorsAvx2;
+        }
+#endif
+        return &ExpectedErrorsScalar;
+    }();
+    return kernel(qual, len);
+}
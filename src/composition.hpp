@@ -0,0 +1,56 @@
+#ifndef FASTX_COMPOSITION_HPP
+#define FASTX_COMPOSITION_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+/**
+ * @brief base counts, case insensitive. Bases other than ACGTN(IUPAC codes,
+ * gaps) are not counted.
+ */
+struct BaseCounts {
+    uint64_t a = 0;
+    uint64_t c = 0;
+    uint64_t g = 0;
+    uint64_t t = 0;
+    uint64_t n = 0;
+};
+
+
+/**
+ * @brief quality counts of phred+33 quality strings
+ */
+struct QualCounts {
+    // bases with quality >= 20 and >= 30
+    uint64_t q20 = 0;
+    uint64_t q30 = 0;
+    // sum of quality values
+    uint64_t sum = 0;
+};
+
+
+/**
+ * @brief add base counts of a sequence to counts. Uses AVX2 or SSE2 if the
+ * cpu supports them(checked at runtime), otherwise a lookup table.
+ */
+void CountBases(const char *seq, size_t len, BaseCounts *counts);
+
+
+/**
+ * @brief add quality counts of a phred+33 quality string to counts, with the
+ * same kernels as CountBases.
+ */
+void CountQuals(const char *qual, size_t len, QualCounts *counts);
+
+
+/**
+ * @brief expected number of errors of a phred+33 quality string, the sum of
+ * 10^(-q/10). Uses an AVX2 gather from a lookup table if the cpu supports
+ * it, sums are in double precision and in the same order on all cpus.
+ */
+double ExpectedErrors(const char *qual, size_t len);
+
+
+#endif  // FASTX_COMPOSITION_HPP
@@ -0,0 +1,46 @@
+#include "faidx_utils.hpp"
+
+
+uint64_t FaiRecordEnd(const faidx_t *fai, const faidx1_t &val) {
+    uint64_t offset = fai->format == FAI_FASTQ ?
+        val.qual_offset : val.seq_offset;
+    if (val.line_blen == 0) return offset;
+
+    offset += val.len / val.line_blen * val.line_len;
+    uint64_t rest = val.len % val.line_blen;
+    if (rest) {
+        offset += rest + (val.line_len - val.line_blen);
+    }
+    return offset;
+}
+
+
+bool FaiNameLineRange(const faidx_t *fai, const faidx1_t &val,
+    uint64_t *start, uint64_t *end)
+{
+    *start = 0;
+    if (val.id > 0) {
+        khiter_t prev = kh_get(s, fai->hash, fai->name[val.id-1]);
+        if (prev == kh_end(fai->hash)) return false;
+        *start = FaiRecordEnd(fai, kh_value(fai->hash, prev));
+    }
+    *end = val.seq_offset;
+    return *start < *end;
+}
+
+
+bool FaiTrimNameLine(std::string &buffer) {
+    while (!buffer.empty() &&
+        (buffer.back() == '\n' || buffer.back() == '\r'))
+    {
+        buffer.pop_back();
+    }
+
+    // skip blank lines before the name line
+    size_t line_start = buffer.rfind('\n');
+    if (line_start != std::string::npos) {
+        buffer.erase(0, line_start + 1);
+    }
+
+    return !buffer.empty() && (buffer[0] == '>' || buffer[0] == '@');
+}
@@ -0,0 +1,156 @@
+#ifndef FASTX_FAIDX_UTILS_HPP
+#define FASTX_FAIDX_UTILS_HPP
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/faidx.h"
+#include "htslib/khash.h"
+
+
+// copy from faidx.c of htslib, expose hidden struct faidx_t
+typedef struct {
+    int id; // faidx_t->name[id] is for this struct.
+    uint32_t line_len, line_blen;
+    uint64_t len;
+    uint64_t seq_offset;
+    uint64_t qual_offset;
+} faidx1_t;
+KHASH_MAP_INIT_STR(s, faidx1_t)
+
+// copy from faidx.c of htslib, expose hidden struct faidx_t
+struct faidx_t {
+    BGZF *bgzf;
+    int n, m;
+    char **name;
+    khash_t(s) *hash;
+    enum fai_format_options format;
+};
+
+
+
+/**
+ * @brief read-only mapping of an uncompressed fasta/q for fetching, the page
+ * cache is shared by all threads and by concurrent processes reading the
+ * same reference. Ranges are located with the line geometry of .fai and
+ * sequence lines are copied without the line breaks.
+ */
+class FaiMmap {
+public:
+    explicit FaiMmap(const std::string &filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = static_cast<const char *>(data);
+                size_ = st.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    ~FaiMmap() {
+        if (data_) munmap(const_cast<char *>(data_), size_);
+    }
+
+    FaiMmap(const FaiMmap &) = delete;
+    FaiMmap &operator=(const FaiMmap &) = delete;
+
+    bool ok() const {
+        return data_ != nullptr;
+    }
+
+    /**
+     * @brief copy the bytes in [start, end) of the file
+     * 
+     * @return false if the range is out of the file
+     */
+    bool read(uint64_t start, uint64_t end, std::string &out) const {
+        if (start > end || end > size_) return false;
+        out.assign(data_ + start, end - start);
+        return true;
+    }
+
+    /**
+     * @brief fetch 0-based closed range [start, end] of a sequence(quality
+     * if qual), positions are clamped as faidx_fetch_seq64 does.
+     * 
+     * @return char* malloc-ed string, NULL and len -1 if the range is out of
+     * the file
+     */
+    char *fetch(const faidx1_t &val, bool qual, int64_t start, int64_t end,
+        int64_t *len) const
+    {
+        int64_t seq_len = static_cast<int64_t>(val.len);
+        start = std::max<int64_t>(start, 0);
+        end = std::min<int64_t>(end, seq_len - 1);
+        int64_t n = end >= start ? end - start + 1 : 0;
+
+        char *seq = static_cast<char *>(malloc(n + 1));
+        uint64_t base = qual ? val.qual_offset : val.seq_offset;
+        char *p = seq;
+        for (int64_t pos = start; pos <= end; ) {
+            int64_t in_line = pos % val.line_blen;
+            int64_t n_copy = std::min<int64_t>(val.line_blen - in_line,
+                end - pos + 1);
+            uint64_t offset = base + pos / val.line_blen * val.line_len +
+                in_line;
+            if (offset + n_copy > size_) {
+                free(seq);
+                *len = -1;
+                return nullptr;
+            }
+            // one memcpy per line, the line break is skipped by geometry
+            std::memcpy(p, data_ + offset, n_copy);
+            p += n_copy;
+            pos += n_copy;
+        }
+        *p = '\0';
+        *len = n;
+        return seq;
+    }
+
+private:
+    const char *data_ = nullptr;
+    uint64_t size_ = 0;
+};
+
+
+/**
+ * @brief end offset(exclusive) of the last sequence line(quality line for
+ * fastq) of a record, computed from the line geometry in .fai
+ */
+uint64_t FaiRecordEnd(const faidx_t *fai, const faidx1_t &val);
+
+
+/**
+ * @brief byte range [start, end) between the end of the previous record and
+ * the sequence of val, the name line is the last line in it.
+ *
+ * @return false if the offsets in .fai are invalid
+ */
+bool FaiNameLineRange(const faidx_t *fai, const faidx1_t &val,
+    uint64_t *start, uint64_t *end);
+
+
+/**
+ * @brief keep only the name line of the bytes read from FaiNameLineRange,
+ * trailing line breaks and blank lines before it are dropped.
+ *
+ * @return false if there is no name line
+ */
+bool FaiTrimNameLine(std::string &buffer);
+
+
+#endif  // FASTX_FAIDX_UTILS_HPP
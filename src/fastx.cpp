@@ -7,8 +7,20 @@
 
 #include "version.hpp"
 #include "fastx_sample.hpp"
+#include "fastx_serve.hpp"
+#include "fastx_convert.hpp"
+#include "fastx_dedup.hpp"
+#include "fastx_interleave.hpp"
+#include "fastx_filter.hpp"
+#include "fastx_grep.hpp"
 #include "fastx_head.hpp"
+#include "fastx_pack.hpp"
+#include "fastx_rename.hpp"
+#include "fastx_sort.hpp"
 #include "fastx_split.hpp"
+#include "fastx_stats.hpp"
+#include "fastx_revcomp.hpp"
+#include "fastx_trim.hpp"
 
 
 static
@@ -20,10 +32,23 @@ void Usage() {
     std::cerr << "Usage: fastx <command> <arguments>\n" << std::endl;
     std::cerr
             << "Commands:\n"
+            << "  convert        convert formats and bin qualities\n"
+            << "  dedup          remove duplicated reads\n"
+            << "  deinterleave   split interleaved pairs into read1 and read2 files\n"
+            << "  filter         filter reads by length, N and quality\n"
+            << "  grep           search patterns in sequences, names or comments\n"
             << "  head           head sequences\n"
+            << "  interleave     interleave read1 and read2 files\n"
+            << "  pack           pack sequences to 2bit for subseq\n"
+            << "  rename         rename reads to prefix.N\n"
+            << "  revcomp        reverse complement sequences\n"
             << "  sample         subsample sequences\n"
+            << "  serve          serve subseq queries on a Unix socket\n"
+            << "  sort           sort sequences by name, length or sequence\n"
             << "  split          split fasta/fastq files.\n"
-            << "  subseq         extract subsequences of fasta/fastq"
+            << "  stats          statistics of fasta/fastq files\n"
+            << "  subseq         extract subsequences of fasta/fastq\n"
+            << "  trim           trim adapters, poly-G/A tails and low quality ends"
             << std::endl;
 }
 
@@ -35,10 +60,23 @@ int main(int argc, char **argv)
     }
 
     std::map<std::string, bool> registered_commands = {
+        {"convert", true},
+        {"dedup", true},
+        {"deinterleave", true},
+        {"filter", true},
+        {"grep", true},
         {"head", true},
+        {"interleave", true},
+        {"pack", true},
+        {"rename", true},
+        {"revcomp", true},
         {"sample", true},
+        {"serve", true},
+        {"sort", true},
         {"split", true},
-        {"subseq", true}
+        {"stats", true},
+        {"subseq", true},
+        {"trim", true}
         };
     
     if (registered_commands.find(argv[1]) != registered_commands.end())
@@ -52,17 +90,56 @@ int main(int argc, char **argv)
         std::exit(1);
     }
 
-    if ( strcmp(argv[1], "head") == 0 ) {
+    if ( strcmp(argv[1], "convert") == 0 ) {
+        return FastxConvertMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "dedup") == 0 )
+    {
+        return FastxDedupMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "deinterleave") == 0 )
+    {
+        return FastxDeinterleaveMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "filter") == 0 )
+    {
+        return FastxFilterMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "grep") == 0 )
+    {
+        return FastxGrepMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "head") == 0 )
+    {
         return FastxHeadMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "interleave") == 0 )
+    {
+        return FastxInterleaveMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "pack") == 0 )
+    {
+        return FastxPackMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "rename") == 0 )
+    {
+        return FastxRenameMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "revcomp") == 0 )
+    {
+        return FastxRevcompMain(argc - 1, argv + 1);
     } else if ( strcmp(argv[1], "sample") == 0 )
     {
         return FastxSampleMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "serve") == 0 )
+    {
+        return FastxServeMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "sort") == 0 )
+    {
+        return FastxSortMain(argc - 1, argv + 1);
     } else if ( strcmp(argv[1], "split") == 0 )
     {
         return FastxSplitMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "stats") == 0 )
+    {
+        return FastxStatsMain(argc - 1, argv + 1);
     } else if ( strcmp(argv[1], "subseq") == 0 )
     {
         return FastxSubseqMain(argc - 1, argv + 1);
+    } else if ( strcmp(argv[1], "trim") == 0 )
+    {
+        return FastxTrimMain(argc - 1, argv + 1);
     }
 
     return 0;
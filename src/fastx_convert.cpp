@@ -0,0 +1,255 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/thread_pool.h"
+#include "zlib.h"
+#include "batch_pipeline.hpp"
+#include "fastx_convert.hpp"
+#include "kseq_utils.hpp"
+#include "qual_map.hpp"
+#include "seq_reader.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+struct ConvertOptions {
+    // output type, fake quality and line width
+    KseqFormat format;
+    bool phred64 = false;
+    QualBinning binning = QualBinning::kNone;
+};
+
+
+/**
+ * @brief convert fasta/q in one streaming pass. Workers take batches from
+ * SeqReader, map the qualities and format the records, this thread writes
+ * the batches in input order.
+ */
+static
+int FastxConvert(const std::string &input, const std::string &output,
+    const ConvertOptions &options, int compress_level, int threads)
+{
+    gzFile fp = input == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input.c_str(), "r");
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + input).c_str());
+        std::exit(1);
+    }
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+    BGZF *outfp = BgzfOpenOutput(output, compress_level, pool);
+
+    QualMap qual_map(options.phred64, options.binning);
+    KseqFormat format = options.format;
+    if (!qual_map.identity()) format.qual_map = &qual_map;
+
+    {
+        SeqReader reader(fp);
+
+        auto take = [&](KseqArray **batch, uint64_t *id) {
+            return (*batch = reader.read_batch(id)) != nullptr;
+        };
+
+        auto process = [&](KseqArray **batch, uint64_t, kstring_t *result) {
+            for (int i = 0; i < (*batch)->size(); ++i) {
+                kseq_t *seq = (*batch)->get(i);
+                if (KstringAppendKseqFormat(result, seq, 0, seq->seq.l,
+                        format) < 0)
+                {
+                    std::cerr << "Error! Failed to buffer read: "
+                        << seq->name.s << std::endl;
+                    std::exit(1);
+                }
+            }
+            reader.release(*batch);
+        };
+
+        auto write = [&](kstring_t &result) {
+            BgzfWriteOutput(outfp, result, output);
+            free(result.s);
+        };
+
+        RunBatchPipeline<KseqArray *, kstring_t>(threads, take, process,
+            write);
+    }
+
+    if (bgzf_close(outfp) < 0) {
+        std::cerr << "Error! Failed to close output" << std::endl;
+        std::exit(1);
+    }
+    hts_tpool_destroy(pool);
+    gzclose(fp);
+
+    return 0;
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx convert " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  convert between fasta and fastq, phred+64 to phred+33, "
+              << "re-wrap sequence lines and bin qualities.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx convert [options] -i <in> [-o <out>]\n\n"
+            << "Options:\n"
+            << "  -i, --input, FILE           input fasta/fastq file name, - for stdin.\n"
+            << "  -o, --output, FILE          output file name [stdout]\n"
+            << "  -T, --to, STR               output format, fasta or fastq, same as input if not set\n"
+            << "  -Q, --fake-qual, INT        quality of fasta records converted to fastq(0 to 93) [40]\n"
+            << "  -6, --phred64               input qualities are phred+64, converted to phred+33\n"
+            << "  -b, --bin, INT              quality binning, 8(Illumina 8-level) or 4(NovaSeq 4-level)\n"
+            << "  -w, --line-width, INT       wrap sequence lines to INT bases, 0 for no wrap, fasta only [0]\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for converting and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version.\n\n"
+            << "  Illumina 8-level bins: 3-9 to 6, 10-19 to 15, 20-24 to 22, 25-29 to 27,\n"
+            << "  30-34 to 33, 35-39 to 37, 40 and above to 40. NovaSeq 4-level bins:\n"
+            << "  3-14 to 12, 15-30 to 23, 31 and above to 37. Qualities 0 to 2 are kept."
+            << std::endl;
+}
+
+
+int FastxConvertMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"input", required_argument, 0, 'i'},
+            {"output", required_argument, 0, 'o'},
+            {"to", required_argument, 0, 'T'},
+            {"fake-qual", required_argument, 0, 'Q'},
+            {"phred64", no_argument, 0, '6'},
+            {"bin", required_argument, 0, 'b'},
+            {"line-width", required_argument, 0, 'w'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "i:o:T:Q:6b:w:l:t:hV";
+
+    std::string input;
+    std::string output = "-";
+    std::string to;
+    int bin = 0;
+    ConvertOptions options;
+    int compress_level = 6;
+    int num_threads = 4;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'i':
+                input = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'T':
+                to = optarg;
+                break;
+            case 'Q':
+                options.format.fake_qual = SafeStrtol(optarg, 10);
+                break;
+            case '6':
+                options.phred64 = true;
+                break;
+            case 'b':
+                bin = SafeStrtol(optarg, 10);
+                break;
+            case 'w':
+                options.format.line_width = SafeStrtol(optarg, 10);
+                break;
+            case 'l':
+                compress_level = SafeStrtol(optarg, 10);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (input.empty()) {
+        std::cerr << "Error! Must set the input fasta/fastq file using "
+            << "-i(--input)." << std::endl;
+        std::exit(1);
+    }
+
+    if (to == "fasta") {
+        options.format.type = KseqOutputType::kFasta;
+    } else if (to == "fastq") {
+        options.format.type = KseqOutputType::kFastq;
+    } else if (!to.empty()) {
+        std::cerr << "Error! Unknown output format " << to
+            << ", must be fasta or fastq." << std::endl;
+        std::exit(1);
+    }
+
+    if (options.format.fake_qual < 0 || options.format.fake_qual > 93) {
+        std::cerr << "Error! Fake quality -Q(--fake-qual) must be in 0 to 93."
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (bin == 8) {
+        options.binning = QualBinning::kIllumina8;
+    } else if (bin == 4) {
+        options.binning = QualBinning::kNovaSeq4;
+    } else if (bin != 0) {
+        std::cerr << "Error! Quality binning -b(--bin) must be 8 or 4."
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (options.format.line_width < 0) {
+        std::cerr << "Error! Line width -w(--line-width) must be greater than"
+            << " or equal to 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (compress_level < 0) {
+        std::cerr << "Error! Compression level must be greater than or equal to"
+            << " 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    return FastxConvert(input, output, options, compress_level, num_threads);
+}
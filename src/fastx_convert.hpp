@@ -0,0 +1,8 @@
+#ifndef FASTX_CONVERT_HPP
+#define FASTX_CONVERT_HPP
+
+
+int FastxConvertMain(int argc, char **argv);
+
+
+#endif  // FASTX_CONVERT_HPP
@@ -0,0 +1,598 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/thread_pool.h"
+#include "zlib.h"
+#include "batch_pipeline.hpp"
+#include "fastx_dedup.hpp"
+#include "hash_set128.hpp"
+#include "kseq_utils.hpp"
+#include "seq_reader.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+// long only options
+const int FASTX_DEDUP_OPT_INTERLEAVED = 256;
+
+// number of hash partitions once the table exceeds --max-memory
+const int FASTX_DEDUP_PARTITIONS = 256;
+
+// buffer of each partition file
+const size_t FASTX_DEDUP_SPILL_BUFFER = 64 * 1024;
+
+// index of hashes in the table when it was spilled, all already written
+const uint64_t FASTX_DEDUP_SEEN = UINT64_MAX;
+
+
+struct DedupOptions {
+    // dedup by name instead of sequence
+    bool by_name = false;
+    int64_t max_memory = 0;
+    std::string tmp_dir;
+};
+
+
+/**
+ * @brief hash of the dedup key of a read(pair): sequence of read1 and read2,
+ * or name of read1 without the /1 suffix.
+ */
+static
+Hash128 DedupKey(const kseq_t *read1, const kseq_t *read2, bool by_name) {
+    if (by_name) {
+        size_t len = read1->name.l;
+        if (read2 && len >= 2 && read1->name.s[len-2] == '/' &&
+            read1->name.s[len-1] == '1')
+        {
+            len -= 2;
+        }
+        return MurmurHash128(read1->name.s, len);
+    }
+
+    Hash128 hash = MurmurHash128(read1->seq.s, read1->seq.l);
+    if (read2) hash = MurmurHash128(read2->seq.s, read2->seq.l, hash);
+    return hash;
+}
+
+
+static
+FILE *DedupOpenFile(const std::string &filename, const char *mode) {
+    FILE *fp = std::fopen(filename.c_str(), mode);
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + filename).c_str());
+        std::exit(1);
+    }
+    return fp;
+}
+
+
+static
+void DedupWriteFile(const void *data, size_t size, FILE *fp,
+    const std::string &filename)
+{
+    if (std::fwrite(data, 1, size, fp) != size) {
+        std::perror(("Error! Failed to write " + filename).c_str());
+        std::exit(1);
+    }
+}
+
+
+/**
+ * @brief hashes partitioned to disk once the table exceeds the memory limit.
+ * Partitions are deduplicated one by one, the indices of the reads to keep
+ * are then merged in order for the second pass.
+ */
+class DedupSpill {
+public:
+    explicit DedupSpill(const std::string &tmp_dir) {
+        std::string prefix = tmp_dir + "/fastx_dedup." +
+            std::to_string(getpid()) + ".";
+        for (int p = 0; p < FASTX_DEDUP_PARTITIONS; ++p) {
+            filenames_.push_back(prefix + std::to_string(p));
+            files_.push_back(DedupOpenFile(filenames_.back(), "wb"));
+            std::setvbuf(files_.back(), NULL, _IOFBF,
+                FASTX_DEDUP_SPILL_BUFFER);
+        }
+    }
+
+    ~DedupSpill() {
+        for (size_t p = 0; p < files_.size(); ++p) {
+            if (files_[p]) std::fclose(files_[p]);
+            std::remove(filenames_[p].c_str());
+        }
+    }
+
+    DedupSpill(const DedupSpill &) = delete;
+    DedupSpill &operator=(const DedupSpill &) = delete;
+
+    void add(const Hash128 &hash, uint64_t index) {
+        Entry entry{hash, index};
+        int p = hash.hi >> (64 - 8);
+        DedupWriteFile(&entry, sizeof(entry), files_[p], filenames_[p]);
+    }
+
+    /**
+     * @brief dedup each partition, the first entry of a hash is kept unless
+     * it was already written(FASTX_DEDUP_SEEN). The partition file is
+     * replaced with the sorted indices to keep.
+     */
+    void finish() {
+        for (size_t p = 0; p < files_.size(); ++p) {
+            if (std::fclose(files_[p]) != 0) {
+                std::perror(("Error! Failed to write " +
+                    filenames_[p]).c_str());
+                std::exit(1);
+            }
+            files_[p] = nullptr;
+
+            FILE *in = DedupOpenFile(filenames_[p], "rb");
+            std::fseek(in, 0, SEEK_END);
+            size_t n = std::ftell(in) / sizeof(Entry);
+            std::rewind(in);
+
+            std::string keep_filename = filenames_[p] + ".keep";
+            FILE *keep = DedupOpenFile(keep_filename, "wb");
+            HashSet128 set;
+            set.reserve(n);
+            Entry entry;
+            while (std::fread(&entry, sizeof(entry), 1, in) == 1) {
+                if (set.insert(entry.hash) &&
+                    entry.index != FASTX_DEDUP_SEEN)
+                {
+                    DedupWriteFile(&entry.index, sizeof(entry.index), keep,
+                        keep_filename);
+                }
+            }
+            std::fclose(in);
+            if (std::fclose(keep) != 0) {
+                std::perror(("Error! Failed to write " +
+                    keep_filename).c_str());
+                std::exit(1);
+            }
+            std::rename(keep_filename.c_str(), filenames_[p].c_str());
+        }
+
+        for (size_t p = 0; p < files_.size(); ++p) {
+            files_[p] = DedupOpenFile(filenames_[p], "rb");
+            uint64_t index;
+            if (std::fread(&index, sizeof(index), 1, files_[p]) == 1) {
+                heap_.emplace(index, p);
+            }
+        }
+    }
+
+    /**
+     * @brief next index to keep in increasing order, FASTX_DEDUP_SEEN if no
+     * more. Valid after finish.
+     */
+    uint64_t next_keep() {
+        if (heap_.empty()) return FASTX_DEDUP_SEEN;
+        auto top = heap_.top();
+        heap_.pop();
+        uint64_t index;
+        if (std::fread(&index, sizeof(index), 1, files_[top.second]) == 1) {
+            heap_.emplace(index, top.second);
+        }
+        return top.first;
+    }
+
+private:
+    struct Entry {
+        Hash128 hash;
+        uint64_t index;
+    };
+
+    std::vector<std::string> filenames_;
+    std::vector<FILE *> files_;
+    std::priority_queue<std::pair<uint64_t, size_t>,
+        std::vector<std::pair<uint64_t, size_t>>,
+        std::greater<std::pair<uint64_t, size_t>>> heap_;
+};
+
+
+static
+gzFile DedupOpenInput(const std::string &input) {
+    gzFile fp = input == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input.c_str(), "r");
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + input).c_str());
+        std::exit(1);
+    }
+    return fp;
+}
+
+
+/**
+ * @brief second pass after spilling: read the inputs again and write the
+ * kept reads, all after the spill.
+ */
+static
+void DedupSecondPass(const std::string &input1, const std::string &input2,
+    bool interleaved, DedupSpill &spill, BGZF *outfp1, BGZF *outfp2,
+    const std::string &output1, const std::string &output2)
+{
+    gzFile fp1 = DedupOpenInput(input1);
+    gzFile fp2 = input2.empty() ? nullptr : DedupOpenInput(input2);
+    bool paired = fp2 || interleaved;
+    std::unique_ptr<SeqReader> reader(paired ? nullptr : new SeqReader(fp1));
+    std::unique_ptr<PairReader> pair_reader(
+        paired ? new PairReader(fp1, fp2) : nullptr);
+    kseq_t *read1 = nullptr;
+    kseq_t *read2 = nullptr;
+    auto next = [&]() {
+        if (paired) return pair_reader->read(&read1, &read2);
+        return (read1 = reader->read()) != nullptr;
+    };
+
+    kstring_t out1 = {0, 0, NULL};
+    kstring_t out2 = {0, 0, NULL};
+    // mates of interleaved input are written together
+    kstring_t *mate_out = outfp2 ? &out2 : &out1;
+
+    uint64_t keep = spill.next_keep();
+    uint64_t index = 0;
+    while (keep != FASTX_DEDUP_SEEN && next()) {
+        // reads before the spill are all written or dropped already
+        if (index++ != keep) continue;
+
+        KstringAppendKseq(&out1, read1);
+        if (read2) KstringAppendKseq(mate_out, read2);
+        if (out1.l + out2.l >= FASTX_DEDUP_SPILL_BUFFER) {
+            BgzfWriteOutput(outfp1, out1.s, out1.l, output1);
+            if (outfp2) BgzfWriteOutput(outfp2, out2.s, out2.l, output2);
+            out1.l = 0;
+            out2.l = 0;
+        }
+        keep = spill.next_keep();
+    }
+    BgzfWriteOutput(outfp1, out1.s, out1.l, output1);
+    if (outfp2) BgzfWriteOutput(outfp2, out2.s, out2.l, output2);
+
+    free(out1.s);
+    free(out2.s);
+    // stop the reader threads before closing the inputs
+    reader.reset();
+    pair_reader.reset();
+    gzclose(fp1);
+    if (fp2) gzclose(fp2);
+}
+
+
+/**
+ * @brief remove duplicated reads(pairs), the first read of each key is kept
+ * and reads are written in input order. Workers take batches from
+ * SeqReader(PairReader for pairs), hash the keys and format the records, this
+ * thread checks the hashes against the table in input order and writes the
+ * new reads.
+ *
+ * When the table would exceed max_memory, its hashes and those of all the
+ * following reads are partitioned to disk, the partitions are deduplicated
+ * one by one and the reads after the spill are written in a second pass.
+ *
+ * @param input2 read2 input, empty for single end or interleaved input1
+ * @param interleaved input1 is interleaved pairs, written interleaved to
+ * output1
+ */
+int FastxDedup(const std::string &input1, const std::string &input2,
+    const std::string &output1, const std::string &output2, bool interleaved,
+    const DedupOptions &options, int compress_level, int threads)
+{
+    bool paired = !input2.empty() || interleaved;
+    gzFile fp1 = DedupOpenInput(input1);
+    gzFile fp2 = input2.empty() ? nullptr : DedupOpenInput(input2);
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+    BGZF *outfp1 = BgzfOpenOutput(output1, compress_level, pool);
+    BGZF *outfp2 = !input2.empty() ?
+        BgzfOpenOutput(output2, compress_level, pool) : nullptr;
+
+    HashSet128 table;
+    std::unique_ptr<DedupSpill> spill;
+    uint64_t index = 0;
+    // no more records are formatted once spilled
+    std::atomic_bool spilled(false);
+
+    {
+        // mates are checked by PairReader
+        std::unique_ptr<SeqReader> reader(
+            paired ? nullptr : new SeqReader(fp1));
+        std::unique_ptr<PairReader> pair_reader(
+            paired ? new PairReader(fp1, fp2) : nullptr);
+
+        struct Result {
+            std::vector<Hash128> hashes;
+            // end offsets of the records in out1 and out2
+            std::vector<size_t> ends1;
+            std::vector<size_t> ends2;
+            kstring_t out1 = {0, 0, NULL};
+            kstring_t out2 = {0, 0, NULL};
+        };
+
+        struct Batch {
+            KseqArray *reads = nullptr;
+            PairReader::Batch pairs;
+        };
+
+        auto take = [&](Batch *batch, uint64_t *id) {
+            return paired ? pair_reader->read_batch(&batch->pairs, id) :
+                (batch->reads = reader->read_batch(id)) != nullptr;
+        };
+
+        auto process = [&](Batch *batch, uint64_t, Result *result) {
+            // mates of interleaved input are written together
+            kstring_t *out2 = interleaved ? &result->out1 : &result->out2;
+            bool format = !spilled;
+            int size = paired ? batch->pairs.size() : batch->reads->size();
+            for (int i = 0; i < size; ++i) {
+                kseq_t *read1 = paired ?
+                    batch->pairs.read1(i) : batch->reads->get(i);
+                kseq_t *read2 = paired ? batch->pairs.read2(i) : nullptr;
+                result->hashes.push_back(
+                    DedupKey(read1, read2, options.by_name));
+                if (!format) continue;
+
+                if (KstringAppendKseq(&result->out1, read1) < 0 ||
+                    (paired && KstringAppendKseq(out2, read2) < 0))
+                {
+                    std::cerr << "Error! Failed to buffer read: "
+                        << read1->name.s << std::endl;
+                    std::exit(1);
+                }
+                result->ends1.push_back(result->out1.l);
+                result->ends2.push_back(result->out2.l);
+            }
+            if (paired) {
+                pair_reader->release(&batch->pairs);
+            } else {
+                reader->release(batch->reads);
+            }
+        };
+
+        // write the records in [begin, end) of a batch
+        auto write_run = [&](const Result &result, size_t begin, size_t end) {
+            if (begin == end) return;
+            size_t from1 = begin ? result.ends1[begin-1] : 0;
+            BgzfWriteOutput(outfp1, result.out1.s + from1,
+                result.ends1[end-1] - from1, output1);
+            if (!outfp2) return;
+            size_t from2 = begin ? result.ends2[begin-1] : 0;
+            BgzfWriteOutput(outfp2, result.out2.s + from2,
+                result.ends2[end-1] - from2, output2);
+        };
+
+        auto write = [&](Result &result) {
+            // runs of new records are written at once
+            size_t run_begin = 0;
+            for (size_t i = 0; i < result.hashes.size(); ++i, ++index) {
+                if (!spill && table.will_grow() &&
+                    static_cast<int64_t>(table.bytes() * 3) >
+                        options.max_memory)
+                {
+                    // growing would hold the old and the doubled table
+                    if (input1 == "-") {
+                        std::cerr << "Error! The hash table exceeds "
+                            << "--max-memory, which needs a second pass "
+                            << "that is not possible for stdin" << std::endl;
+                        std::exit(1);
+                    }
+                    write_run(result, run_begin, i);
+                    spill.reset(new DedupSpill(options.tmp_dir));
+                    table.for_each([&spill](const Hash128 &hash) {
+                        spill->add(hash, FASTX_DEDUP_SEEN);
+                    });
+                    table.clear();
+                    spilled = true;
+                }
+
+                if (spill) {
+                    spill->add(result.hashes[i], index);
+                } else if (!table.insert(result.hashes[i])) {
+                    write_run(result, run_begin, i);
+                    run_begin = i + 1;
+                }
+            }
+            if (!spill) write_run(result, run_begin, result.hashes.size());
+            free(result.out1.s);
+            free(result.out2.s);
+        };
+
+        RunBatchPipeline<Batch, Result>(threads, take, process, write);
+    }
+    gzclose(fp1);
+    if (fp2) gzclose(fp2);
+
+    if (spill) {
+        spill->finish();
+        DedupSecondPass(input1, input2, interleaved, *spill, outfp1, outfp2,
+            output1, output2);
+    }
+
+    if (bgzf_close(outfp1) < 0 || (outfp2 && bgzf_close(outfp2) < 0)) {
+        std::cerr << "Error! Failed to close output" << std::endl;
+        std::exit(1);
+    }
+    hts_tpool_destroy(pool);
+
+    return 0;
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx dedup " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  remove duplicated reads by sequence or name(pairs by "
+              << "both mates), the first read is kept.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx dedup [options] -i <in1> [-I <in2>] [-o <out1>] [-O <out2>]\n\n"
+            << "Options:\n"
+            << "  -i, --in1, FILE             input fasta/fastq file name for read1, - for stdin.\n"
+            << "  -I, --in2, FILE             input fasta/fastq file name for read2.\n"
+            << "  -o, --out1, FILE            output file name for read1 [stdout]\n"
+            << "  -O, --out2, FILE            output file name for read2.\n"
+            << "      --interleaved           input1 is interleaved pairs, written interleaved to output1.\n"
+            << "  -n, --by-name               dedup by name instead of sequence\n"
+            << "  -m, --max-memory, STR       memory of the hash table(K/M/G), hashes are\n"
+            << "                              partitioned to disk beyond it [4G]\n"
+            << "  -T, --tmp-dir, DIR          directory of the partitions [$TMPDIR or /tmp]\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for hashing and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version."
+            << std::endl;
+}
+
+
+int FastxDedupMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"in1", required_argument, 0, 'i'},
+            {"in2", required_argument, 0, 'I'},
+            {"out1", required_argument, 0, 'o'},
+            {"out2", required_argument, 0, 'O'},
+            {"by-name", no_argument, 0, 'n'},
+            {"max-memory", required_argument, 0, 'm'},
+            {"tmp-dir", required_argument, 0, 'T'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {"interleaved", no_argument, 0, FASTX_DEDUP_OPT_INTERLEAVED},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "i:I:o:O:nm:T:l:t:hV";
+
+    std::string input1;
+    std::string input2;
+    std::string output1 = "-";
+    std::string output2;
+    DedupOptions options;
+    options.max_memory = KmgStrToInt("4G");
+    const char *tmp_dir = std::getenv("TMPDIR");
+    options.tmp_dir = tmp_dir ? tmp_dir : "/tmp";
+    int compress_level = 6;
+    int num_threads = 4;
+    bool interleaved = false;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'i':
+                input1 = optarg;
+                break;
+            case 'I':
+                input2 = optarg;
+                break;
+            case 'o':
+                output1 = optarg;
+                break;
+            case 'O':
+                output2 = optarg;
+                break;
+            case 'n':
+                options.by_name = true;
+                break;
+            case 'm':
+                options.max_memory = KmgStrToInt(optarg);
+                break;
+            case 'T':
+                options.tmp_dir = optarg;
+                break;
+            case 'l':
+                compress_level = SafeStrtol(optarg, 10);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case FASTX_DEDUP_OPT_INTERLEAVED:
+                interleaved = true;
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (input1.empty()) {
+        std::cerr << "Error! Must set at least one input fasta/fastq file "
+            << "using -i(--in1)." << std::endl;
+        std::exit(1);
+    }
+
+    if (interleaved && (!input2.empty() || !output2.empty())) {
+        std::cerr << "Error! -I(--in2) and -O(--out2) can not be used with "
+            << "--interleaved." << std::endl;
+        std::exit(1);
+    }
+
+    if (!input2.empty() && output2.empty()) {
+        std::cerr << "Error! Must set at the second output fasta/fastq file "
+            << "using -O(--out2) When inputting 2 fasta/fastq files."
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (input2.empty() && !output2.empty()) {
+        std::cerr << "Error! -O(--out2) needs the second input file "
+            << "-I(--in2)." << std::endl;
+        std::exit(1);
+    }
+
+    if (input2 == "-") {
+        std::cerr << "Error! Only read1 can be read from stdin" << std::endl;
+        std::exit(1);
+    }
+
+    if (options.max_memory <= 0) {
+        std::cerr << "Error! -m(--max-memory) must be positive" << std::endl;
+        std::exit(1);
+    }
+
+    if (compress_level < 0) {
+        std::cerr << "Error! Compression level must be greater than or equal to"
+            << " 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    return FastxDedup(input1, input2, output1, output2, interleaved,
+        options, compress_level, num_threads);
+}
@@ -0,0 +1,8 @@
+#ifndef FASTX_DEDUP_HPP
+#define FASTX_DEDUP_HPP
+
+
+int FastxDedupMain(int argc, char **argv);
+
+
+#endif  // FASTX_DEDUP_HPP
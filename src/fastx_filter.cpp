@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/thread_pool.h"
+#include "zlib.h"
+#include "batch_pipeline.hpp"
+#include "composition.hpp"
+#include "fastx_filter.hpp"
+#include "kseq_utils.hpp"
+#include "seq_reader.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+// long only options
+const int FASTX_FILTER_OPT_INTERLEAVED = 256;
+
+
+struct FilterOptions {
+    int64_t min_len = 0;
+    // -1 for no limit
+    int64_t max_len = -1;
+    double min_mean_qual = -1;
+    int64_t max_n = -1;
+    double max_expected_errors = -1;
+};
+
+
+/**
+ * @brief check a record against the filters. Quality filters only apply to
+ * records with quality.
+ */
+static
+bool PassFilter(const kseq_t *seq, const FilterOptions &options) {
+    int64_t len = seq->seq.l;
+    if (len < options.min_len) return false;
+    if (options.max_len >= 0 && len > options.max_len) return false;
+
+    if (options.max_n >= 0) {
+        BaseCounts counts;
+        CountBases(seq->seq.s, seq->seq.l, &counts);
+        if (static_cast<int64_t>(counts.n) > options.max_n) return false;
+    }
+
+    if (seq->qual.l == 0) return true;
+
+    if (options.min_mean_qual >= 0) {
+        QualCounts counts;
+        CountQuals(seq->qual.s, seq->qual.l, &counts);
+        if (counts.sum < options.min_mean_qual * seq->qual.l) return false;
+    }
+
+    if (options.max_expected_errors >= 0 &&
+        ExpectedErrors(seq->qual.s, seq->qual.l) >
+            options.max_expected_errors)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief filter single or paired fasta/q in one streaming pass. Workers take
+ * batches from SeqReader(PairReader for pairs), filter them and format the
+ * kept records, this thread writes the batches in input order. Mates are kept
+ * or dropped together.
+ *
+ * @param input2 read2 input, empty for single end or interleaved input1
+ * @param interleaved input1 is interleaved pairs, written interleaved to
+ * output1
+ */
+int FastxFilter(const std::string &input1, const std::string &input2,
+    const std::string &output1, const std::string &output2, bool interleaved,
+    const FilterOptions &options, int compress_level, int threads)
+{
+    bool paired = !input2.empty() || interleaved;
+
+    gzFile fp1 = input1 == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input1.c_str(), "r");
+    if (fp1 == nullptr) {
+        std::perror(("Error! Can not open " + input1).c_str());
+        std::exit(1);
+    }
+    gzFile fp2 = nullptr;
+    if (!input2.empty()) {
+        fp2 = gzopen(input2.c_str(), "r");
+        if (fp2 == nullptr) {
+            std::perror(("Error! Can not open " + input2).c_str());
+            std::exit(1);
+        }
+    }
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+    BGZF *outfp1 = BgzfOpenOutput(output1, compress_level, pool);
+    BGZF *outfp2 = !input2.empty() ?
+        BgzfOpenOutput(output2, compress_level, pool) : nullptr;
+
+    {
+        // mates are checked by PairReader
+        std::unique_ptr<SeqReader> reader(
+            paired ? nullptr : new SeqReader(fp1));
+        std::unique_ptr<PairReader> pair_reader(
+            paired ? new PairReader(fp1, fp2) : nullptr);
+
+        struct Result {
+            kstring_t out1 = {0, 0, NULL};
+            kstring_t out2 = {0, 0, NULL};
+        };
+
+        struct Batch {
+            KseqArray *reads = nullptr;
+            PairReader::Batch pairs;
+        };
+
+        auto take = [&](Batch *batch, uint64_t *id) {
+            return paired ? pair_reader->read_batch(&batch->pairs, id) :
+                (batch->reads = reader->read_batch(id)) != nullptr;
+        };
+
+        auto process = [&](Batch *batch, uint64_t, Result *result) {
+            // mates of interleaved input are written together
+            kstring_t *out2 = interleaved ? &result->out1 : &result->out2;
+            int size = paired ? batch->pairs.size() : batch->reads->size();
+            for (int i = 0; i < size; ++i) {
+                kseq_t *read1 = paired ?
+                    batch->pairs.read1(i) : batch->reads->get(i);
+                kseq_t *read2 = paired ? batch->pairs.read2(i) : nullptr;
+                if (!PassFilter(read1, options)) continue;
+                if (paired && !PassFilter(read2, options)) continue;
+
+                if (KstringAppendKseq(&result->out1, read1) < 0 ||
+                    (paired && KstringAppendKseq(out2, read2) < 0))
+                {
+                    std::cerr << "Error! Failed to buffer read: "
+                        << read1->name.s << std::endl;
+                    std::exit(1);
+                }
+            }
+            if (paired) {
+                pair_reader->release(&batch->pairs);
+            } else {
+                reader->release(batch->reads);
+            }
+        };
+
+        auto write = [&](Result &result) {
+            BgzfWriteOutput(outfp1, result.out1, output1);
+            if (outfp2) BgzfWriteOutput(outfp2, result.out2, output2);
+            free(result.out1.s);
+            free(result.out2.s);
+        };
+
+        RunBatchPipeline<Batch, Result>(threads, take, process, write);
+    }
+
+    if (bgzf_close(outfp1) < 0 || (outfp2 && bgzf_close(outfp2) < 0)) {
+        std::cerr << "Error! Failed to close output" << std::endl;
+        std::exit(1);
+    }
+    hts_tpool_destroy(pool);
+    gzclose(fp1);
+    if (fp2) gzclose(fp2);
+
+    return 0;
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx filter " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  filter reads by length, N and quality, mates of paired "
+              << "reads are kept or dropped together.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx filter [options] -i <in1> [-I <in2>] [-o <out1>] [-O <out2>]\n\n"
+            << "Options:\n"
+            << "  -i, --in1, FILE             input fasta/fastq file name for read1, - for stdin.\n"
+            << "  -I, --in2, FILE             input fasta/fastq file name for read2.\n"
+            << "  -o, --out1, FILE            output file name for read1 [stdout]\n"
+            << "  -O, --out2, FILE            output file name for read2.\n"
+            << "      --interleaved           input1 is interleaved pairs, written interleaved to output1.\n"
+            << "  -m, --min-len, INT          min length [0]\n"
+            << "  -M, --max-len, INT          max length, -1 for no limit [-1]\n"
+            << "  -q, --min-mean-q, FLOAT     min mean quality\n"
+            << "  -n, --max-n, INT            max number of N\n"
+            << "  -e, --max-expected-errors, FLOAT\n"
+            << "                              max expected errors(sum of 10^(-q/10))\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for filtering and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version.\n\n"
+            << "  Quality filters only apply to records with quality."
+            << std::endl;
+}
+
+
+int FastxFilterMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"in1", required_argument, 0, 'i'},
+            {"in2", required_argument, 0, 'I'},
+            {"out1", required_argument, 0, 'o'},
+            {"out2", required_argument, 0, 'O'},
+            {"min-len", required_argument, 0, 'm'},
+            {"max-len", required_argument, 0, 'M'},
+            {"min-mean-q", required_argument, 0, 'q'},
+            {"max-n", required_argument, 0, 'n'},
+            {"max-expected-errors", required_argument, 0, 'e'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {"interleaved", no_argument, 0, FASTX_FILTER_OPT_INTERLEAVED},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "i:I:o:O:m:M:q:n:e:l:t:hV";
+
+    std::string input1;
+    std::string input2;
+    std::string output1 = "-";
+    std::string output2;
+    FilterOptions options;
+    int compress_level = 6;
+    int num_threads = 4;
+    bool interleaved = false;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'i':
+                input1 = optarg;
+                break;
+            case 'I':
+                input2 = optarg;
+                break;
+            case 'o':
+                output1 = optarg;
+                break;
+            case 'O':
+                output2 = optarg;
+                break;
+            case 'm':
+                options.min_len = SafeStrtol(optarg, 10);
+                break;
+            case 'M':
+                options.max_len = SafeStrtol(optarg, 10);
+                break;
+            case 'q':
+                options.min_mean_qual = SafeStrtod(optarg);
+                break;
+            case 'n':
+                options.max_n = SafeStrtol(optarg, 10);
+                break;
+            case 'e':
+                options.max_expected_errors = SafeStrtod(optarg);
+                break;
+            case 'l':
+                compress_level = SafeStrtol(optarg, 10);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case FASTX_FILTER_OPT_INTERLEAVED:
+                interleaved = true;
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (input1.empty()) {
+        std::cerr << "Error! Must set at least one input fasta/fastq file "
+            << "using -i(--in1)." << std::endl;
+        std::exit(1);
+    }
+
+    if (interleaved && (!input2.empty() || !output2.empty())) {
+        std::cerr << "Error! -I(--in2) and -O(--out2) can not be used with "
+            << "--interleaved." << std::endl;
+        std::exit(1);
+    }
+
+    if (!input2.empty() && output2.empty()) {
+        std::cerr << "Error! Must set at the second output fasta/fastq file "
+            << "using -O(--out2) When inputting 2 fasta/fastq files."
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (input2.empty() && !output2.empty()) {
+        std::cerr << "Error! -O(--out2) needs the second input file "
+            << "-I(--in2)." << std::endl;
+        std::exit(1);
+    }
+
+    if (input2 == "-") {
+        std::cerr << "Error! Only read1 can be read from stdin" << std::endl;
+        std::exit(1);
+    }
+
+    if (options.max_len >= 0 && options.max_len < options.min_len) {
+        std::cerr << "Error! -M(--max-len) must be greater than or equal to "
+            << "-m(--min-len)" << std::endl;
+        std::exit(1);
+    }
+
+    if (compress_level < 0) {
+        std::cerr << "Error! Compression level must be greater than or equal to"
+            << " 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    return FastxFilter(input1, input2, output1, output2, interleaved,
+        options, compress_level, num_threads);
+}
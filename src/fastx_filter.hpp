@@ -0,0 +1,8 @@
+#ifndef FASTX_FILTER_HPP
+#define FASTX_FILTER_HPP
+
+
+int FastxFilterMain(int argc, char **argv);
+
+
+#endif  // FASTX_FILTER_HPP
@@ -0,0 +1,480 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/thread_pool.h"
+#include "zlib.h"
+#include "batch_pipeline.hpp"
+#include "aho_corasick.hpp"
+#include "fastx_grep.hpp"
+#include "kseq_utils.hpp"
+#include "revcomp.hpp"
+#include "seq_reader.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+// long only options
+const int FASTX_GREP_OPT_INTERLEAVED = 256;
+
+
+enum class GrepField {kSeq, kName, kComment};
+
+
+struct GrepOptions {
+    GrepField field = GrepField::kSeq;
+    // max mismatches of a match
+    int mismatches = 0;
+    // also match reverse complement of patterns
+    bool revcomp = false;
+    // output records which do not match
+    bool invert = false;
+};
+
+
+/**
+ * @brief match many patterns with up to k mismatches. Each pattern is cut
+ * into k + 1 pieces, at least one of which matches exactly in any match with
+ * k mismatches(pigeonhole). The pieces are searched with Aho-Corasick and
+ * each hit is verified on the whole pattern.
+ */
+class GrepMatcher {
+public:
+    /**
+     * @param ignore_case letters match in both cases(sequences)
+     */
+    GrepMatcher(const std::vector<std::string> &patterns, int mismatches,
+        bool ignore_case): patterns_(patterns), mismatches_(mismatches),
+        ignore_case_(ignore_case), automaton_(ignore_case)
+    {
+        for (size_t p = 0; p < patterns_.size(); ++p) {
+            size_t len = patterns_[p].size();
+            int n = mismatches_ + 1;
+            for (int k = 0; k < n; ++k) {
+                size_t begin = len * k / n;
+                size_t end = len * (k + 1) / n;
+                automaton_.add(patterns_[p].substr(begin, end - begin),
+                    pieces_.size());
+                pieces_.push_back(Piece{p, begin, end - begin});
+            }
+        }
+        automaton_.build();
+    }
+
+    bool match(const char *text, size_t len) const {
+        if (mismatches_ == 0) {
+            return automaton_.search(text, len,
+                [](int, size_t) { return true; });
+        }
+
+        return automaton_.search(text, len, [&](int id, size_t end) {
+            const Piece &piece = pieces_[id];
+            const std::string &pattern = patterns_[piece.pattern];
+            if (end < piece.offset + piece.len) return false;
+            size_t start = end - piece.len - piece.offset;
+            if (start + pattern.size() > len) return false;
+            return Mismatches(text + start, pattern) <= mismatches_;
+        });
+    }
+
+private:
+    struct Piece {
+        size_t pattern;
+        // offset in the pattern
+        size_t offset;
+        size_t len;
+    };
+
+    // mismatches of pattern at text, stops counting past the max
+    int Mismatches(const char *text, const std::string &pattern) const {
+        int n = 0;
+        for (size_t i = 0; i < pattern.size() && n <= mismatches_; ++i) {
+            char a = text[i];
+            char b = pattern[i];
+            if (ignore_case_) {
+                if (a >= 'a' && a <= 'z') a -= 'a' - 'A';
+                if (b >= 'a' && b <= 'z') b -= 'a' - 'A';
+            }
+            n += a != b;
+        }
+        return n;
+    }
+
+    std::vector<std::string> patterns_;
+    int mismatches_;
+    bool ignore_case_;
+    std::vector<Piece> pieces_;
+    AhoCorasick automaton_;
+};
+
+
+static
+bool GrepMatch(const kseq_t *seq, const GrepMatcher &matcher,
+    GrepField field)
+{
+    if (field == GrepField::kName) {
+        return matcher.match(seq->name.s, seq->name.l);
+    } else if (field == GrepField::kComment) {
+        return matcher.match(seq->comment.s, seq->comment.l);
+    }
+    return matcher.match(seq->seq.s, seq->seq.l);
+}
+
+
+/**
+ * @brief read patterns of a file, one per line
+ */
+static
+void GrepReadPatterns(const std::string &filename,
+    std::vector<std::string> &patterns)
+{
+    std::ifstream in(filename);
+    if (!in) {
+        std::perror(("Error! Can not open " + filename).c_str());
+        std::exit(1);
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) patterns.push_back(line);
+    }
+}
+
+
+/**
+ * @brief write the records(pairs) matching any pattern. Workers take batches
+ * from SeqReader(PairReader for pairs), match them and format the matching
+ * records, this thread writes the batches in input order. A pair matches if
+ * either mate matches.
+ *
+ * @param input2 read2 input, empty for single end or interleaved input1
+ * @param interleaved input1 is interleaved pairs, written interleaved to
+ * output1
+ */
+int FastxGrep(const std::string &input1, const std::string &input2,
+    const std::string &output1, const std::string &output2, bool interleaved,
+    const GrepMatcher &matcher, const GrepOptions &options,
+    int compress_level, int threads)
+{
+    bool paired = !input2.empty() || interleaved;
+
+    gzFile fp1 = input1 == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input1.c_str(), "r");
+    if (fp1 == nullptr) {
+        std::perror(("Error! Can not open " + input1).c_str());
+        std::exit(1);
+    }
+    gzFile fp2 = nullptr;
+    if (!input2.empty()) {
+        fp2 = gzopen(input2.c_str(), "r");
+        if (fp2 == nullptr) {
+            std::perror(("Error! Can not open " + input2).c_str());
+            std::exit(1);
+        }
+    }
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+    BGZF *outfp1 = BgzfOpenOutput(output1, compress_level, pool);
+    BGZF *outfp2 = !input2.empty() ?
+        BgzfOpenOutput(output2, compress_level, pool) : nullptr;
+
+    {
+        // mates are checked by PairReader
+        std::unique_ptr<SeqReader> reader(
+            paired ? nullptr : new SeqReader(fp1));
+        std::unique_ptr<PairReader> pair_reader(
+            paired ? new PairReader(fp1, fp2) : nullptr);
+
+        struct Result {
+            kstring_t out1 = {0, 0, NULL};
+            kstring_t out2 = {0, 0, NULL};
+        };
+
+        struct Batch {
+            KseqArray *reads = nullptr;
+            PairReader::Batch pairs;
+        };
+
+        auto take = [&](Batch *batch, uint64_t *id) {
+            return paired ? pair_reader->read_batch(&batch->pairs, id) :
+                (batch->reads = reader->read_batch(id)) != nullptr;
+        };
+
+        auto process = [&](Batch *batch, uint64_t, Result *result) {
+            // mates of interleaved input are written together
+            kstring_t *out2 = interleaved ? &result->out1 : &result->out2;
+            int size = paired ? batch->pairs.size() : batch->reads->size();
+            for (int i = 0; i < size; ++i) {
+                kseq_t *read1 = paired ?
+                    batch->pairs.read1(i) : batch->reads->get(i);
+                kseq_t *read2 = paired ? batch->pairs.read2(i) : nullptr;
+                bool matched = GrepMatch(read1, matcher, options.field) ||
+                    (paired && GrepMatch(read2, matcher, options.field));
+                if (matched == options.invert) continue;
+
+                if (KstringAppendKseq(&result->out1, read1) < 0 ||
+                    (paired && KstringAppendKseq(out2, read2) < 0))
+                {
+                    std::cerr << "Error! Failed to buffer read: "
+                        << read1->name.s << std::endl;
+                    std::exit(1);
+                }
+            }
+            if (paired) {
+                pair_reader->release(&batch->pairs);
+            } else {
+                reader->release(batch->reads);
+            }
+        };
+
+        auto write = [&](Result &result) {
+            BgzfWriteOutput(outfp1, result.out1, output1);
+            if (outfp2) BgzfWriteOutput(outfp2, result.out2, output2);
+            free(result.out1.s);
+            free(result.out2.s);
+        };
+
+        RunBatchPipeline<Batch, Result>(threads, take, process, write);
+    }
+
+    if (bgzf_close(outfp1) < 0 || (outfp2 && bgzf_close(outfp2) < 0)) {
+        std::cerr << "Error! Failed to close output" << std::endl;
+        std::exit(1);
+    }
+    hts_tpool_destroy(pool);
+    gzclose(fp1);
+    if (fp2) gzclose(fp2);
+
+    return 0;
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx grep " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  search patterns in sequences, names or comments, mates of "
+              << "paired reads are written together.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx grep [options] -p <pattern> -i <in1> [-I <in2>] [-o <out1>] [-O <out2>]\n\n"
+            << "Options:\n"
+            << "  -i, --in1, FILE             input fasta/fastq file name for read1, - for stdin.\n"
+            << "  -I, --in2, FILE             input fasta/fastq file name for read2.\n"
+            << "  -o, --out1, FILE            output file name for read1 [stdout]\n"
+            << "  -O, --out2, FILE            output file name for read2.\n"
+            << "      --interleaved           input1 is interleaved pairs, written interleaved to output1.\n"
+            << "  -p, --pattern, STR          pattern, can be set multiple times\n"
+            << "  -f, --pattern-file, FILE    file of patterns, one per line\n"
+            << "  -w, --where, STR            field to search, seq, name or comment [seq]\n"
+            << "  -r, --revcomp               also search reverse complement of patterns\n"
+            << "  -m, --mismatches, INT       max mismatches [0]\n"
+            << "  -v, --invert                output records which do not match\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for matching and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version.\n\n"
+            << "  Sequences are matched ignoring case, names and comments are not. A pair\n"
+            << "  matches if either mate matches."
+            << std::endl;
+}
+
+
+int FastxGrepMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"in1", required_argument, 0, 'i'},
+            {"in2", required_argument, 0, 'I'},
+            {"out1", required_argument, 0, 'o'},
+            {"out2", required_argument, 0, 'O'},
+            {"pattern", required_argument, 0, 'p'},
+            {"pattern-file", required_argument, 0, 'f'},
+            {"where", required_argument, 0, 'w'},
+            {"revcomp", no_argument, 0, 'r'},
+            {"mismatches", required_argument, 0, 'm'},
+            {"invert", no_argument, 0, 'v'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {"interleaved", no_argument, 0, FASTX_GREP_OPT_INTERLEAVED},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "i:I:o:O:p:f:w:rm:vl:t:hV";
+
+    std::string input1;
+    std::string input2;
+    std::string output1 = "-";
+    std::string output2;
+    std::vector<std::string> patterns;
+    std::string where = "seq";
+    GrepOptions options;
+    int compress_level = 6;
+    int num_threads = 4;
+    bool interleaved = false;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'i':
+                input1 = optarg;
+                break;
+            case 'I':
+                input2 = optarg;
+                break;
+            case 'o':
+                output1 = optarg;
+                break;
+            case 'O':
+                output2 = optarg;
+                break;
+            case 'p':
+                patterns.push_back(optarg);
+                break;
+            case 'f':
+                GrepReadPatterns(optarg, patterns);
+                break;
+            case 'w':
+                where = optarg;
+                break;
+            case 'r':
+                options.revcomp = true;
+                break;
+            case 'm':
+                options.mismatches = SafeStrtol(optarg, 10);
+                break;
+            case 'v':
+                options.invert = true;
+                break;
+            case 'l':
+                compress_level = SafeStrtol(optarg, 10);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case FASTX_GREP_OPT_INTERLEAVED:
+                interleaved = true;
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (input1.empty()) {
+        std::cerr << "Error! Must set at least one input fasta/fastq file "
+            << "using -i(--in1)." << std::endl;
+        std::exit(1);
+    }
+
+    if (interleaved && (!input2.empty() || !output2.empty())) {
+        std::cerr << "Error! -I(--in2) and -O(--out2) can not be used with "
+            << "--interleaved." << std::endl;
+        std::exit(1);
+    }
+
+    if (!input2.empty() && output2.empty()) {
+        std::cerr << "Error! Must set at the second output fasta/fastq file "
+            << "using -O(--out2) When inputting 2 fasta/fastq files."
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (input2.empty() && !output2.empty()) {
+        std::cerr << "Error! -O(--out2) needs the second input file "
+            << "-I(--in2)." << std::endl;
+        std::exit(1);
+    }
+
+    if (input2 == "-") {
+        std::cerr << "Error! Only read1 can be read from stdin" << std::endl;
+        std::exit(1);
+    }
+
+    if (patterns.empty()) {
+        std::cerr << "Error! Must set patterns using -p(--pattern) or "
+            << "-f(--pattern-file)" << std::endl;
+        std::exit(1);
+    }
+
+    if (where == "seq") {
+        options.field = GrepField::kSeq;
+    } else if (where == "name") {
+        options.field = GrepField::kName;
+    } else if (where == "comment") {
+        options.field = GrepField::kComment;
+    } else {
+        std::cerr << "Error! Unknown field " << where << ", must be seq, "
+            << "name or comment" << std::endl;
+        std::exit(1);
+    }
+
+    if (options.mismatches < 0) {
+        std::cerr << "Error! -m(--mismatches) must be greater than or equal "
+            << "to 0" << std::endl;
+        std::exit(1);
+    }
+
+    for (auto &pattern: patterns) {
+        if (static_cast<int64_t>(pattern.size()) <= options.mismatches) {
+            std::cerr << "Error! Pattern " << pattern << " must be longer "
+                << "than -m(--mismatches)" << std::endl;
+            std::exit(1);
+        }
+    }
+
+    if (options.revcomp) {
+        size_t n = patterns.size();
+        for (size_t i = 0; i < n; ++i) {
+            std::string pattern = patterns[i];
+            ReverseComplement(&pattern[0], pattern.size());
+            if (pattern != patterns[i]) patterns.push_back(pattern);
+        }
+    }
+
+    if (compress_level < 0) {
+        std::cerr << "Error! Compression level must be greater than or equal to"
+            << " 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    GrepMatcher matcher(patterns, options.mismatches,
+        options.field == GrepField::kSeq);
+    return FastxGrep(input1, input2, output1, output2, interleaved,
+        matcher, options, compress_level, num_threads);
+}
@@ -0,0 +1,8 @@
+#ifndef FASTX_GREP_HPP
+#define FASTX_GREP_HPP
+
+
+int FastxGrepMain(int argc, char **argv);
+
+
+#endif  // FASTX_GREP_HPP
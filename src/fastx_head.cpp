@@ -21,6 +21,10 @@
 #include "version.hpp"
 
 
+// long only options
+const int FASTX_HEAD_OPT_INTERLEAVED = 256;
+
+
 void FastxHeadBasesSingle(
     const std::string &ifilename1, const std::string &ofilename1,
     int64_t bases, int threads, int compress_level)
@@ -85,13 +89,18 @@ void FastxHeadBasesSingle(
 }
 
 
-void FastxHeadBasesPair(
+/**
+ * @brief head pairs of read1 and read2 files, or of an interleaved file if
+ * ifilename2 is empty, which are written interleaved to ofilename1. Stops
+ * at bases(sum of both mates) if bases > 0, else at reads pairs.
+ */
+void FastxHeadPair(
     const std::string &ifilename1, const std::string &ifilename2,
     const std::string &ofilename1, const std::string &ofilename2,
-    int64_t bases, int threads, int compress_level)
+    int64_t bases, int64_t reads, int threads, int compress_level)
 {
     gzFile fp1 = gzopen(ifilename1.c_str(), "r");
-    gzFile fp2 = gzopen(ifilename2.c_str(), "r");
+    gzFile fp2 = nullptr;
 
     if (fp1 == nullptr)
     {
@@ -99,14 +108,17 @@ void FastxHeadBasesPair(
         std::exit(1);
     }
 
-    if (fp2 == nullptr)
+    if (!ifilename2.empty())
     {
-        std::perror(("Error! Can not open " + ifilename2).c_str());
-        std::exit(1);
+        fp2 = gzopen(ifilename2.c_str(), "r");
+        if (fp2 == nullptr)
+        {
+            std::perror(("Error! Can not open " + ifilename2).c_str());
+            std::exit(1);
+        }
     }
 
-    SeqReader reader1 = SeqReader(fp1);
-    SeqReader reader2 = SeqReader(fp2);
+    PairReader *reader = new PairReader(fp1, fp2);
 
     hts_tpool *pool = hts_tpool_init(threads);
     if (pool == NULL) {
@@ -125,26 +137,30 @@ void FastxHeadBasesPair(
     }
 
     bgzf_thread_pool(bgzfp1, pool, 0);
-    BGZF* bgzfp2 = bgzf_open(ofilename2.c_str(), mode_str.str().c_str());
-    if (bgzfp2 == NULL) {
-        std::cerr << "Error! Can not open "
-            << ofilename2 << " for writing" << std::endl;
-        std::exit(1);
-    }
+    BGZF* bgzfp2 = bgzfp1;
+    if (!ofilename2.empty()) {
+        bgzfp2 = bgzf_open(ofilename2.c_str(), mode_str.str().c_str());
+        if (bgzfp2 == NULL) {
+            std::cerr << "Error! Can not open "
+                << ofilename2 << " for writing" << std::endl;
+            std::exit(1);
+        }
 
-    bgzf_thread_pool(bgzfp2, pool, 0);
+        bgzf_thread_pool(bgzfp2, pool, 0);
+    }
 
     int64_t base_count = 0;
+    int64_t read_count = 0;
 
     int ret;
     kseq_t *read1 = nullptr;
     kseq_t *read2 = nullptr;
-    while ((read1 = reader1.read()) != nullptr &&
-        (read2 = reader2.read()) != nullptr)
+    while (reader->read(&read1, &read2))
     {
         base_count += read1->seq.l;
         base_count += read2->seq.l;
-        if (base_count <= bases) {
+        ++read_count;
+        if (bases > 0 ? base_count <= bases : read_count <= reads) {
             ret = BgzfWriteKseq(bgzfp1, read1);
             if (ret < 0) {
                 std::cerr << "Error! Failed to write read1: "
@@ -163,10 +179,12 @@ void FastxHeadBasesPair(
     }
 
     bgzf_close(bgzfp1);
-    bgzf_close(bgzfp2);
+    if (bgzfp2 != bgzfp1) bgzf_close(bgzfp2);
     hts_tpool_destroy(pool);
+    // stop the reader threads before closing the inputs
+    delete reader;
     gzclose(fp1);
-    gzclose(fp2);
+    if (fp2) gzclose(fp2);
 }
 
 
@@ -249,6 +267,7 @@ void Usage() {
             << "  -O, --out2, FILE            output fasta/fastq file name for read2.\n"
             << "  -b, --bases, STR            get this value of bases(K/M/G).\n"
             << "  -n, --number, STR           get this value of read pairs(K/M/G).\n"
+            << "      --interleaved           input1 is interleaved pairs, written interleaved to output1.\n"
             << "  -l, --level, INT            compression level(0 to 9, or 11).[6]\n"
             << "  -t, --thread, INT           number of threads.[4]\n"
             << "  -h, --help                  print this message and exit.\n"
@@ -277,7 +296,9 @@ int FastxHeadMain(int argc, char **argv)
             {"seed", required_argument, 0, 's'},
             {"thread", required_argument, 0, 't'},
             {"help", no_argument, 0, 'h'},
-            {"version", no_argument, 0, 'V'}
+            {"version", no_argument, 0, 'V'},
+            {"interleaved", no_argument, 0, FASTX_HEAD_OPT_INTERLEAVED},
+            {0, 0, 0, 0}
     };
 
     int c, long_idx;
@@ -291,6 +312,7 @@ int FastxHeadMain(int argc, char **argv)
     int64_t reads = -1;
     int compress_level = 6;
     int num_threads = 4;
+    bool interleaved = false;
 
     while ((c = getopt_long(
         argc, argv, opt_str, long_options, &long_idx)) != -1)
@@ -332,6 +354,9 @@ int FastxHeadMain(int argc, char **argv)
             case 't':
                 num_threads = SafeStrtol(optarg, 10);
                 break;
+            case FASTX_HEAD_OPT_INTERLEAVED:
+                interleaved = true;
+                break;
             case 'h':
                 Usage();
                 return 0;
@@ -356,6 +381,12 @@ int FastxHeadMain(int argc, char **argv)
         std::exit(1);
     }
 
+    if (interleaved && (!input2.empty() || !output2.empty())) {
+        std::cerr << "Error! -I(--in2) and -O(--out2) can not be used with "
+            << "--interleaved." << std::endl;
+        std::exit(1);
+    }
+
     if (!input2.empty() && output2.empty()) {
         std::cerr << "Error! Must set at the second output fasta/fastq file "
             << "using -O(--out2) When inputting 2 fasta/fastq files."
@@ -389,28 +420,17 @@ int FastxHeadMain(int argc, char **argv)
         std::exit(1);
     }
 
-    if (input2.empty()) {
+    if (!input2.empty() || interleaved) {
+        // paired reads
+        FastxHeadPair(input1, input2, output1, output2, bases, reads,
+            num_threads, compress_level);
+    } else if (bases > 0) {
         // single read
-        if (bases > 0)
-        {
-            FastxHeadBasesSingle(
-                input1, output1, bases, num_threads, compress_level);
-        } else {
-            FastxHeadReadsSingle(
-                input1, output1, reads, num_threads, compress_level);
-        }
+        FastxHeadBasesSingle(
+            input1, output1, bases, num_threads, compress_level);
     } else {
-        // paired reads
-        if (bases > 0)
-        {
-            FastxHeadBasesPair(input1, input2, output1, output2, bases,
-                num_threads, compress_level);
-        } else {
-            FastxHeadReadsSingle(
-                input1, output1, reads, num_threads, compress_level);
-            FastxHeadReadsSingle(
-                input2, output2, reads, num_threads, compress_level);
-        }
+        FastxHeadReadsSingle(
+            input1, output1, reads, num_threads, compress_level);
     }
 
     return 0;
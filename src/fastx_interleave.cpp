@@ -0,0 +1,287 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/thread_pool.h"
+#include "zlib.h"
+#include "batch_pipeline.hpp"
+#include "fastx_interleave.hpp"
+#include "kseq_utils.hpp"
+#include "seq_reader.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+/**
+ * @brief interleave read1 and read2 files into output1, or deinterleave
+ * input1 into output1 and output2, in one pass. Workers take batches of
+ * pairs from PairReader and format them, this thread writes the batches in
+ * input order to the outputs, which share one thread pool.
+ *
+ * @param input2 read2 input, empty if input1 is interleaved
+ * @param output2 read2 output, empty to interleave into output1
+ */
+static
+int FastxInterleave(const std::string &input1, const std::string &input2,
+    const std::string &output1, const std::string &output2,
+    int compress_level, int threads)
+{
+    gzFile fp1 = input1 == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input1.c_str(), "r");
+    if (fp1 == nullptr) {
+        std::perror(("Error! Can not open " + input1).c_str());
+        std::exit(1);
+    }
+    gzFile fp2 = nullptr;
+    if (!input2.empty()) {
+        fp2 = gzopen(input2.c_str(), "r");
+        if (fp2 == nullptr) {
+            std::perror(("Error! Can not open " + input2).c_str());
+            std::exit(1);
+        }
+    }
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+    bool split = !output2.empty();
+    BGZF *outfp1 = BgzfOpenOutput(output1, compress_level, pool);
+    BGZF *outfp2 = split ?
+        BgzfOpenOutput(output2, compress_level, pool) : nullptr;
+
+    {
+        PairReader reader(fp1, fp2);
+
+        struct Result {
+            kstring_t out1 = {0, 0, NULL};
+            kstring_t out2 = {0, 0, NULL};
+        };
+
+        auto take = [&](PairReader::Batch *batch, uint64_t *id) {
+            return reader.read_batch(batch, id);
+        };
+
+        auto process = [&](PairReader::Batch *batch, uint64_t,
+            Result *result)
+        {
+            for (int i = 0; i < batch->size(); ++i) {
+                kseq_t *read1 = batch->read1(i);
+                kseq_t *read2 = batch->read2(i);
+                if (KstringAppendKseq(&result->out1, read1) < 0 ||
+                    KstringAppendKseq(split ? &result->out2 : &result->out1,
+                        read2) < 0)
+                {
+                    std::cerr << "Error! Failed to buffer read: "
+                        << read1->name.s << std::endl;
+                    std::exit(1);
+                }
+            }
+            reader.release(batch);
+        };
+
+        auto write = [&](Result &result) {
+            BgzfWriteOutput(outfp1, result.out1, output1);
+            if (split) BgzfWriteOutput(outfp2, result.out2, output2);
+            free(result.out1.s);
+            free(result.out2.s);
+        };
+
+        RunBatchPipeline<PairReader::Batch, Result>(threads, take, process,
+            write);
+    }
+
+    if (bgzf_close(outfp1) < 0 || (outfp2 && bgzf_close(outfp2) < 0)) {
+        std::cerr << "Error! Failed to close output" << std::endl;
+        std::exit(1);
+    }
+    hts_tpool_destroy(pool);
+    gzclose(fp1);
+    if (fp2) gzclose(fp2);
+
+    return 0;
+}
+
+
+static
+void InterleaveUsage() {
+    std::cerr << "fastx interleave " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  interleave read1 and read2 files into one file, mates are "
+              << "checked by name.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx interleave [options] -i <in1> -I <in2> [-o <out>]\n\n"
+            << "Options:\n"
+            << "  -i, --in1, FILE             input fasta/fastq file name for read1, - for stdin.\n"
+            << "  -I, --in2, FILE             input fasta/fastq file name for read2.\n"
+            << "  -o, --output, FILE          output file name [stdout]\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for formatting and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version."
+            << std::endl;
+}
+
+
+static
+void DeinterleaveUsage() {
+    std::cerr << "fastx deinterleave " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  split an interleaved file into read1 and read2 files, mates "
+              << "are checked by name.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx deinterleave [options] -i <in> -o <out1> -O <out2>\n\n"
+            << "Options:\n"
+            << "  -i, --input, FILE           input interleaved fasta/fastq file name, - for stdin.\n"
+            << "  -o, --out1, FILE            output file name for read1.\n"
+            << "  -O, --out2, FILE            output file name for read2.\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for formatting and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version."
+            << std::endl;
+}
+
+
+/**
+ * @brief parse the options of interleave(two inputs) and deinterleave(two
+ * outputs), which differ only in the number of inputs and outputs
+ */
+static
+int FastxInterleaveCommand(int argc, char **argv, bool deinterleave)
+{
+    void (*usage)() = deinterleave ? DeinterleaveUsage : InterleaveUsage;
+    if (argc == 1)
+    {
+        usage();
+        return 0;
+    }
+
+    static const struct option interleave_options[] = {
+            {"in1", required_argument, 0, 'i'},
+            {"in2", required_argument, 0, 'I'},
+            {"output", required_argument, 0, 'o'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {0, 0, 0, 0}
+    };
+
+    static const struct option deinterleave_options[] = {
+            {"input", required_argument, 0, 'i'},
+            {"out1", required_argument, 0, 'o'},
+            {"out2", required_argument, 0, 'O'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const struct option *long_options = deinterleave ?
+        deinterleave_options : interleave_options;
+    const char *opt_str = deinterleave ? "i:o:O:l:t:hV" : "i:I:o:l:t:hV";
+
+    std::string input1;
+    std::string input2;
+    std::string output1 = deinterleave ? "" : "-";
+    std::string output2;
+    int compress_level = 6;
+    int num_threads = 4;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'i':
+                input1 = optarg;
+                break;
+            case 'I':
+                input2 = optarg;
+                break;
+            case 'o':
+                output1 = optarg;
+                break;
+            case 'O':
+                output2 = optarg;
+                break;
+            case 'l':
+                compress_level = SafeStrtol(optarg, 10);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case 'h':
+                usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (input1.empty()) {
+        std::cerr << "Error! Must set the input fasta/fastq file using "
+            << "-i." << std::endl;
+        std::exit(1);
+    }
+
+    if (!deinterleave && input2.empty()) {
+        std::cerr << "Error! Must set the read2 input fasta/fastq file using "
+            << "-I(--in2)." << std::endl;
+        std::exit(1);
+    }
+
+    if (deinterleave && (output1.empty() || output2.empty())) {
+        std::cerr << "Error! Must set the output files of read1 and read2 "
+            << "using -o(--out1) and -O(--out2)." << std::endl;
+        std::exit(1);
+    }
+
+    if (input2 == "-") {
+        std::cerr << "Error! Only read1 can be read from stdin" << std::endl;
+        std::exit(1);
+    }
+
+    if (compress_level < 0) {
+        std::cerr << "Error! Compression level must be greater than or equal to"
+            << " 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    return FastxInterleave(input1, input2, output1, output2, compress_level,
+        num_threads);
+}
+
+
+int FastxInterleaveMain(int argc, char **argv)
+{
+    return FastxInterleaveCommand(argc, argv, false);
+}
+
+
+int FastxDeinterleaveMain(int argc, char **argv)
+{
+    return FastxInterleaveCommand(argc, argv, true);
+}
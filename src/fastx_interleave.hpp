@@ -0,0 +1,10 @@
+#ifndef FASTX_INTERLEAVE_HPP
+#define FASTX_INTERLEAVE_HPP
+
+
+int FastxInterleaveMain(int argc, char **argv);
+
+int FastxDeinterleaveMain(int argc, char **argv);
+
+
+#endif  // FASTX_INTERLEAVE_HPP
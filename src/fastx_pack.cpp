@@ -0,0 +1,322 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "zlib.h"
+#include "fastx_pack.hpp"
+#include "kseq_utils.hpp"
+#include "two_bit.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+// copy buffer size when assembling the output file
+const size_t FASTX_PACK_COPY_BUFFER = 1 << 20;
+
+
+/**
+ * @brief 2-bit codes of bases(T=0 C=1 A=2 G=3), -1 for others.
+ */
+static
+const int8_t *PackCodes() {
+    static int8_t codes[256];
+    static bool initialized = [] {
+        std::memset(codes, -1, sizeof(codes));
+        codes['T'] = codes['t'] = 0;
+        codes['C'] = codes['c'] = 1;
+        codes['A'] = codes['a'] = 2;
+        codes['G'] = codes['g'] = 3;
+        return true;
+    }();
+    (void)initialized;
+    return codes;
+}
+
+
+static
+void WriteOrDie(const void *data, size_t size, FILE *fp,
+    const std::string &filename)
+{
+    if (size > 0 && std::fwrite(data, 1, size, fp) != size) {
+        std::perror(("Error! Failed to write " + filename).c_str());
+        std::exit(1);
+    }
+}
+
+
+static
+void WriteU32(uint32_t v, FILE *fp, const std::string &filename) {
+    WriteOrDie(&v, sizeof(v), fp, filename);
+}
+
+
+/**
+ * @brief runs of N(bases other than ACGT) and lower case bases.
+ */
+struct PackBlocks {
+    std::vector<uint32_t> n_starts;
+    std::vector<uint32_t> n_sizes;
+    std::vector<uint32_t> mask_starts;
+    std::vector<uint32_t> mask_sizes;
+};
+
+
+/**
+ * @brief pack a sequence to 2 bits per base and collect its N and mask
+ * blocks. Bases in N blocks are packed as T.
+ */
+static
+void PackSeq(const char *seq, uint32_t len, std::vector<uint8_t> &packed,
+    PackBlocks &blocks)
+{
+    const int8_t *codes = PackCodes();
+    packed.assign((static_cast<size_t>(len) + 3) / 4, 0);
+    blocks.n_starts.clear();
+    blocks.n_sizes.clear();
+    blocks.mask_starts.clear();
+    blocks.mask_sizes.clear();
+
+    bool in_n = false;
+    bool in_mask = false;
+    for (uint32_t i = 0; i < len; ++i) {
+        unsigned char c = static_cast<unsigned char>(seq[i]);
+        int8_t code = codes[c];
+        if (code < 0) {
+            if (!in_n) {
+                blocks.n_starts.push_back(i);
+                blocks.n_sizes.push_back(0);
+                in_n = true;
+            }
+            ++blocks.n_sizes.back();
+            code = 0;
+        } else {
+            in_n = false;
+        }
+
+        if (c >= 'a' && c <= 'z') {
+            if (!in_mask) {
+                blocks.mask_starts.push_back(i);
+                blocks.mask_sizes.push_back(0);
+                in_mask = true;
+            }
+            ++blocks.mask_sizes.back();
+        } else {
+            in_mask = false;
+        }
+
+        packed[i >> 2] |= static_cast<uint8_t>(code << (6 - 2 * (i & 3)));
+    }
+}
+
+
+/**
+ * @brief pack a fasta/q file to UCSC .2bit format(quality is dropped). The
+ * records are packed to a temporary file first, the header and the index,
+ * whose size is known only after all names are read, are written before
+ * them at the end.
+ *
+ * @param input input file name, - for stdin
+ * @param output output .2bit file name
+ */
+void FastxPack(const std::string &input, const std::string &output) {
+    gzFile fp = input == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input.c_str(), "r");
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + input).c_str());
+        std::exit(1);
+    }
+
+    std::string body_filename = output + ".tmp";
+    FILE *body = std::fopen(body_filename.c_str(), "w+b");
+    if (body == nullptr) {
+        std::perror(("Error! Can not open " + body_filename).c_str());
+        std::exit(1);
+    }
+
+    std::vector<std::string> names;
+    std::vector<uint64_t> offsets;
+    std::unordered_set<std::string> seen;
+    std::vector<uint8_t> packed;
+    PackBlocks blocks;
+    uint64_t body_size = 0;
+
+    kseq_t *read = kseq_init(fp);
+    int ret;
+    while ((ret = kseq_read(read)) >= 0) {
+        std::string name(read->name.s, read->name.l);
+        if (name.size() > 255) {
+            std::cerr << "Error! Sequence name longer than 255 characters: "
+                << name << std::endl;
+            std::exit(1);
+        }
+        if (!seen.insert(name).second) {
+            std::cerr << "Error! Duplicated sequence name: " << name
+                << std::endl;
+            std::exit(1);
+        }
+        if (read->seq.l > UINT32_MAX) {
+            std::cerr << "Error! Sequence longer than 4G bases: " << name
+                << std::endl;
+            std::exit(1);
+        }
+
+        uint32_t len = static_cast<uint32_t>(read->seq.l);
+        PackSeq(read->seq.s, len, packed, blocks);
+
+        names.push_back(std::move(name));
+        offsets.push_back(body_size);
+
+        WriteU32(len, body, body_filename);
+        WriteU32(blocks.n_starts.size(), body, body_filename);
+        WriteOrDie(blocks.n_starts.data(), blocks.n_starts.size() * 4, body,
+            body_filename);
+        WriteOrDie(blocks.n_sizes.data(), blocks.n_sizes.size() * 4, body,
+            body_filename);
+        WriteU32(blocks.mask_starts.size(), body, body_filename);
+        WriteOrDie(blocks.mask_starts.data(), blocks.mask_starts.size() * 4,
+            body, body_filename);
+        WriteOrDie(blocks.mask_sizes.data(), blocks.mask_sizes.size() * 4,
+            body, body_filename);
+        WriteU32(0, body, body_filename);
+        WriteOrDie(packed.data(), packed.size(), body, body_filename);
+        body_size += 16 + 8 * (blocks.n_starts.size() +
+            blocks.mask_starts.size()) + packed.size();
+    }
+
+    if (ret < -1) {
+        std::cerr << "Error! Input file truncated! File was " << input
+            << std::endl;
+        std::exit(1);
+    }
+    kseq_destroy(read);
+    gzclose(fp);
+
+    // header and index
+    uint64_t index_size = 0;
+    for (const auto &name: names) index_size += 1 + name.size() + 4;
+    uint32_t version = 16 + index_size + body_size > UINT32_MAX ? 1 : 0;
+    if (version == 1) index_size += 4 * names.size();
+    uint64_t records_offset = 16 + index_size;
+
+    FILE *out = std::fopen(output.c_str(), "wb");
+    if (out == nullptr) {
+        std::perror(("Error! Can not open " + output).c_str());
+        std::exit(1);
+    }
+    WriteU32(TWO_BIT_SIGNATURE, out, output);
+    WriteU32(version, out, output);
+    WriteU32(names.size(), out, output);
+    WriteU32(0, out, output);
+    for (size_t i = 0; i < names.size(); ++i) {
+        uint8_t name_size = static_cast<uint8_t>(names[i].size());
+        WriteOrDie(&name_size, 1, out, output);
+        WriteOrDie(names[i].data(), names[i].size(), out, output);
+        uint64_t offset = records_offset + offsets[i];
+        if (version == 0) {
+            WriteU32(static_cast<uint32_t>(offset), out, output);
+        } else {
+            WriteOrDie(&offset, sizeof(offset), out, output);
+        }
+    }
+
+    std::rewind(body);
+    std::vector<char> buffer(FASTX_PACK_COPY_BUFFER);
+    size_t n;
+    while ((n = std::fread(buffer.data(), 1, buffer.size(), body)) > 0) {
+        WriteOrDie(buffer.data(), n, out, output);
+    }
+    if (std::ferror(body)) {
+        std::perror(("Error! Failed to read " + body_filename).c_str());
+        std::exit(1);
+    }
+    std::fclose(body);
+    std::remove(body_filename.c_str());
+
+    if (std::fclose(out) != 0) {
+        std::perror(("Error! Failed to close " + output).c_str());
+        std::exit(1);
+    }
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx pack " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  pack fasta/q to 2bit(UCSC .2bit, N runs and soft-masking "
+              << "kept, other IUPAC codes become N), which can be read by "
+              << "subseq directly.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx pack [options] -o <file.2bit> <file.fasta|file.fastq|->\n\n"
+            << "Options:\n"
+            << "  -o, --output, FILE          output .2bit file name\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version."
+            << std::endl;
+}
+
+
+int FastxPackMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"output", required_argument, 0, 'o'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "o:hV";
+
+    std::string input;
+    std::string output;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (optind < argc) {
+        input = argv[optind];
+    } else {
+        std::cerr << "Error! Missing input file" << std::endl;
+        std::exit(1);
+    }
+
+    if (output.empty() || output == "-") {
+        std::cerr << "Error! Missing output file -o(--output)" << std::endl;
+        std::exit(1);
+    }
+
+    FastxPack(input, output);
+
+    return 0;
+}
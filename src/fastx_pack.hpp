@@ -0,0 +1,8 @@
+#ifndef FASTX_PACK_HPP
+#define FASTX_PACK_HPP
+
+
+int FastxPackMain(int argc, char **argv);
+
+
+#endif  // FASTX_PACK_HPP
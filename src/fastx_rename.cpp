@@ -0,0 +1,384 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/thread_pool.h"
+#include "zlib.h"
+#include "batch_pipeline.hpp"
+#include "fastx_rename.hpp"
+#include "kseq_utils.hpp"
+#include "seq_reader.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+// max length of the prefix of new names
+const size_t FASTX_RENAME_MAX_PREFIX = 256;
+
+// long only options
+const int FASTX_RENAME_OPT_INTERLEAVED = 256;
+
+
+// two digits of 0 to 99
+static const char kDigitPairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+
+/**
+ * @brief write the decimal digits of v to p, two digits at a time from the
+ * end.
+ *
+ * @return end of the digits
+ */
+static
+char *FormatUint(char *p, uint64_t v) {
+    char buffer[20];
+    char *end = buffer + sizeof(buffer);
+    char *q = end;
+    while (v >= 100) {
+        q -= 2;
+        memcpy(q, kDigitPairs + 2 * (v % 100), 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        q -= 2;
+        memcpy(q, kDigitPairs + 2 * v, 2);
+    } else {
+        *--q = '0' + v;
+    }
+    memcpy(p, q, end - q);
+    return p + (end - q);
+}
+
+
+/**
+ * @brief append a line of "old<TAB>new" to the name map
+ */
+static
+int RenameAppendMap(kstring_t *str, const kseq_t *seq, const char *name,
+    size_t name_len)
+{
+    size_t len = seq->name.l + 1 + name_len + 1;
+    if (ks_resize(str, str->l + len + 1) < 0) return -1;
+
+    char *p = str->s + str->l;
+    memcpy(p, seq->name.s, seq->name.l);
+    p += seq->name.l;
+    *p++ = '\t';
+    memcpy(p, name, name_len);
+    p += name_len;
+    *p++ = '\n';
+    *p = '\0';
+    str->l += len;
+    return 0;
+}
+
+
+/**
+ * @brief rename the records of single or paired fasta/q to prefix.N(N from
+ * 1 in input order) in one streaming pass, both mates get the same name.
+ * Workers take batches and format the records with the new names, this
+ * thread writes the batches in input order. Batches are full except the
+ * last one, so N is known from the batch id and the reads(pairs) per batch.
+ *
+ * @param input2 read2 input, empty for single end or interleaved input1
+ * @param interleaved input1 is interleaved pairs, written interleaved to
+ * output1
+ * @param map_output name map output, empty for none
+ */
+static
+int FastxRename(const std::string &input1, const std::string &input2,
+    const std::string &output1, const std::string &output2, bool interleaved,
+    const std::string &map_output, const std::string &prefix,
+    bool strip_comment, int compress_level, int threads)
+{
+    bool paired = !input2.empty() || interleaved;
+
+    gzFile fp1 = input1 == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input1.c_str(), "r");
+    if (fp1 == nullptr) {
+        std::perror(("Error! Can not open " + input1).c_str());
+        std::exit(1);
+    }
+    gzFile fp2 = nullptr;
+    if (!input2.empty()) {
+        fp2 = gzopen(input2.c_str(), "r");
+        if (fp2 == nullptr) {
+            std::perror(("Error! Can not open " + input2).c_str());
+            std::exit(1);
+        }
+    }
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+    BGZF *outfp1 = BgzfOpenOutput(output1, compress_level, pool);
+    BGZF *outfp2 = !input2.empty() ?
+        BgzfOpenOutput(output2, compress_level, pool) : nullptr;
+    BGZF *mapfp = map_output.empty() ?
+        nullptr : BgzfOpenOutput(map_output, compress_level, pool);
+
+    {
+        // mates are checked by PairReader
+        std::unique_ptr<SeqReader> reader(
+            paired ? nullptr : new SeqReader(fp1));
+        std::unique_ptr<PairReader> pair_reader(
+            paired ? new PairReader(fp1, fp2) : nullptr);
+        uint64_t per_batch = paired ?
+            pair_reader->pairs_per_batch() : KSEQ_ARRAY_CAPACITY;
+
+        struct Batch {
+            KseqArray *reads = nullptr;
+            PairReader::Batch pairs;
+        };
+
+        struct Result {
+            kstring_t out1 = {0, 0, NULL};
+            kstring_t out2 = {0, 0, NULL};
+            kstring_t map = {0, 0, NULL};
+        };
+
+        auto take = [&](Batch *batch, uint64_t *id) {
+            return paired ? pair_reader->read_batch(&batch->pairs, id) :
+                (batch->reads = reader->read_batch(id)) != nullptr;
+        };
+
+        auto process = [&](Batch *batch, uint64_t id, Result *result) {
+            char name[FASTX_RENAME_MAX_PREFIX + 24];
+            memcpy(name, prefix.data(), prefix.size());
+            name[prefix.size()] = '.';
+            char *digits = name + prefix.size() + 1;
+            KseqFormat format;
+            format.name = name;
+            format.strip_comment = strip_comment;
+            // mates of interleaved input are written together
+            kstring_t *out2 = interleaved ? &result->out1 : &result->out2;
+
+            int size = paired ? batch->pairs.size() : batch->reads->size();
+            uint64_t first = id * per_batch + 1;
+            for (int i = 0; i < size; ++i) {
+                kseq_t *read1 = paired ?
+                    batch->pairs.read1(i) : batch->reads->get(i);
+                format.name_len = FormatUint(digits, first + i) - name;
+                kseq_t *read2 = paired ? batch->pairs.read2(i) : nullptr;
+                if (KstringAppendKseqFormat(&result->out1, read1, 0,
+                        read1->seq.l, format) < 0 ||
+                    (paired && KstringAppendKseqFormat(out2, read2, 0,
+                        read2->seq.l, format) < 0) ||
+                    (mapfp && RenameAppendMap(&result->map, read1, name,
+                        format.name_len) < 0))
+                {
+                    std::cerr << "Error! Failed to buffer read: "
+                        << read1->name.s << std::endl;
+                    std::exit(1);
+                }
+            }
+            if (paired) {
+                pair_reader->release(&batch->pairs);
+            } else {
+                reader->release(batch->reads);
+            }
+        };
+
+        auto write = [&](Result &result) {
+            BgzfWriteOutput(outfp1, result.out1, output1);
+            if (outfp2) BgzfWriteOutput(outfp2, result.out2, output2);
+            if (mapfp) BgzfWriteOutput(mapfp, result.map, map_output);
+            free(result.out1.s);
+            free(result.out2.s);
+            free(result.map.s);
+        };
+
+        RunBatchPipeline<Batch, Result>(threads, take, process, write);
+    }
+
+    if (bgzf_close(outfp1) < 0 || (outfp2 && bgzf_close(outfp2) < 0) ||
+        (mapfp && bgzf_close(mapfp) < 0))
+    {
+        std::cerr << "Error! Failed to close output" << std::endl;
+        std::exit(1);
+    }
+    hts_tpool_destroy(pool);
+    gzclose(fp1);
+    if (fp2) gzclose(fp2);
+
+    return 0;
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx rename " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  rename reads to <prefix>.N in input order(N from 1), "
+              << "mates of paired reads get the same name.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx rename [options] -i <in1> [-I <in2>] [-o <out1>] [-O <out2>]\n\n"
+            << "Options:\n"
+            << "  -i, --in1, FILE             input fasta/fastq file name for read1, - for stdin.\n"
+            << "  -I, --in2, FILE             input fasta/fastq file name for read2.\n"
+            << "  -o, --out1, FILE            output file name for read1 [stdout]\n"
+            << "  -O, --out2, FILE            output file name for read2.\n"
+            << "      --interleaved           input1 is interleaved pairs, written interleaved to output1.\n"
+            << "  -p, --prefix, STR           prefix of new names [read]\n"
+            << "  -s, --strip-comment         remove comments.\n"
+            << "  -m, --map, FILE             write old<TAB>new names(of read1) to FILE.\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for renaming and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version."
+            << std::endl;
+}
+
+
+int FastxRenameMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"in1", required_argument, 0, 'i'},
+            {"in2", required_argument, 0, 'I'},
+            {"out1", required_argument, 0, 'o'},
+            {"out2", required_argument, 0, 'O'},
+            {"prefix", required_argument, 0, 'p'},
+            {"strip-comment", no_argument, 0, 's'},
+            {"map", required_argument, 0, 'm'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {"interleaved", no_argument, 0, FASTX_RENAME_OPT_INTERLEAVED},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "i:I:o:O:p:sm:l:t:hV";
+
+    std::string input1;
+    std::string input2;
+    std::string output1 = "-";
+    std::string output2;
+    std::string prefix = "read";
+    bool strip_comment = false;
+    std::string map_output;
+    int compress_level = 6;
+    int num_threads = 4;
+    bool interleaved = false;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'i':
+                input1 = optarg;
+                break;
+            case 'I':
+                input2 = optarg;
+                break;
+            case 'o':
+                output1 = optarg;
+                break;
+            case 'O':
+                output2 = optarg;
+                break;
+            case 'p':
+                prefix = optarg;
+                break;
+            case 's':
+                strip_comment = true;
+                break;
+            case 'm':
+                map_output = optarg;
+                break;
+            case 'l':
+                compress_level = SafeStrtol(optarg, 10);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case FASTX_RENAME_OPT_INTERLEAVED:
+                interleaved = true;
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (input1.empty()) {
+        std::cerr << "Error! Must set at least one input fasta/fastq file "
+            << "using -i(--in1)." << std::endl;
+        std::exit(1);
+    }
+
+    if (interleaved && (!input2.empty() || !output2.empty())) {
+        std::cerr << "Error! -I(--in2) and -O(--out2) can not be used with "
+            << "--interleaved." << std::endl;
+        std::exit(1);
+    }
+
+    if (!input2.empty() && output2.empty()) {
+        std::cerr << "Error! Must set at the second output fasta/fastq file "
+            << "using -O(--out2) When inputting 2 fasta/fastq files."
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (input2.empty() && !output2.empty()) {
+        std::cerr << "Error! -O(--out2) needs the second input file "
+            << "-I(--in2)." << std::endl;
+        std::exit(1);
+    }
+
+    if (input2 == "-") {
+        std::cerr << "Error! Only read1 can be read from stdin" << std::endl;
+        std::exit(1);
+    }
+
+    if (prefix.size() > FASTX_RENAME_MAX_PREFIX) {
+        std::cerr << "Error! Prefix -p(--prefix) must be at most "
+            << FASTX_RENAME_MAX_PREFIX << " characters" << std::endl;
+        std::exit(1);
+    }
+
+    if (compress_level < 0) {
+        std::cerr << "Error! Compression level must be greater than or equal to"
+            << " 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    return FastxRename(input1, input2, output1, output2, interleaved,
+        map_output, prefix, strip_comment, compress_level, num_threads);
+}
@@ -0,0 +1,8 @@
+#ifndef FASTX_RENAME_HPP
+#define FASTX_RENAME_HPP
+
+
+int FastxRenameMain(int argc, char **argv);
+
+
+#endif  // FASTX_RENAME_HPP
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/thread_pool.h"
+#include "zlib.h"
+#include "batch_pipeline.hpp"
+#include "fastx_revcomp.hpp"
+#include "kseq_utils.hpp"
+#include "revcomp.hpp"
+#include "seq_reader.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+/**
+ * @brief reverse complement sequences of a fasta/q file(quality is
+ * reversed), names and comments are kept. Workers take batches from
+ * SeqReader and format the records, this thread writes the batches in input
+ * order.
+ * 
+ * @param input input file name, - for stdin
+ * @param output output file name, - for stdout. Gzip(BGZF) compressed if
+ * ends with .gz
+ */
+void FastxRevcomp(const std::string &input, const std::string &output,
+    int compress_level, int threads)
+{
+    gzFile fp = input == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input.c_str(), "r");
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + input).c_str());
+        std::exit(1);
+    }
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+    BGZF *outfp = BgzfOpenOutput(output, compress_level, pool);
+
+    {
+        SeqReader reader(fp);
+
+        auto take = [&](KseqArray **batch, uint64_t *id) {
+            return (*batch = reader.read_batch(id)) != nullptr;
+        };
+
+        auto process = [&](KseqArray **batch, uint64_t, kstring_t *result) {
+            for (int i = 0; i < (*batch)->size(); ++i) {
+                kseq_t *seq = (*batch)->get(i);
+                ReverseComplement(seq->seq.s, seq->seq.l);
+                std::reverse(seq->qual.s, seq->qual.s + seq->qual.l);
+                if (KstringAppendKseq(result, seq) < 0) {
+                    std::cerr << "Error! Failed to buffer read: "
+                        << seq->name.s << std::endl;
+                    std::exit(1);
+                }
+            }
+            reader.release(*batch);
+        };
+
+        auto write = [&](kstring_t &result) {
+            BgzfWriteOutput(outfp, result, output);
+            free(result.s);
+        };
+
+        RunBatchPipeline<KseqArray *, kstring_t>(threads, take, process,
+            write);
+    }
+
+    if (bgzf_close(outfp) < 0) {
+        std::cerr << "Error! Failed to close " << output << std::endl;
+        std::exit(1);
+    }
+    hts_tpool_destroy(pool);
+    gzclose(fp);
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx revcomp " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  reverse complement sequences(IUPAC codes, case kept).\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx revcomp [options] <file.fasta|file.fastq|->\n\n"
+            << "Options:\n"
+            << "  -o, --output, FILE          output file name [stdout]\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for reverse complementing and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version."
+            << std::endl;
+}
+
+
+int FastxRevcompMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"output", required_argument, 0, 'o'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "o:l:t:hV";
+
+    std::string input;
+    std::string output = "-";
+    int compress_level = 6;
+    int num_threads = 4;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'l':
+                compress_level = SafeStrtol(optarg, 10);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (optind < argc) {
+        input = argv[optind];
+    } else {
+        std::cerr << "Error! Missing input file" << std::endl;
+        std::exit(1);
+    }
+
+    if (compress_level < 0) {
+        std::cerr << "Error! Compression level must be greater than or equal to"
+            << " 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    FastxRevcomp(input, output, compress_level, num_threads);
+
+    return 0;
+}
@@ -0,0 +1,8 @@
+#ifndef FASTX_REVCOMP_CMD_HPP
+#define FASTX_REVCOMP_CMD_HPP
+
+
+int FastxRevcompMain(int argc, char **argv);
+
+
+#endif  // FASTX_REVCOMP_CMD_HPP
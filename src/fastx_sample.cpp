@@ -25,6 +25,11 @@
 
 namespace fs = std::filesystem;
 
+
+// long only options
+const int FASTX_SAMPLE_OPT_INTERLEAVED = 256;
+
+
 struct SubsampleSummary {
     int64_t total_bases;
     int64_t expected_subsample_bases;
@@ -125,6 +130,10 @@ void FastxSampleSingle(
 }
 
 
+/**
+ * @brief subsample pairs of read1 and read2 files, or of an interleaved file
+ * if ifilename2 is empty, which are written interleaved to ofilename1.
+ */
 void FastxSamplePair(
     const std::string &ifilename1, const std::string &ifilename2,
     const std::string &ofilename1, const std::string &ofilename2,
@@ -135,8 +144,10 @@ void FastxSamplePair(
     {
         fs::copy_file(ifilename1, ofilename1,
             fs::copy_options::overwrite_existing);
-        fs::copy_file(ifilename2, ofilename2,
-            fs::copy_options::overwrite_existing);
+        if (!ifilename2.empty()) {
+            fs::copy_file(ifilename2, ofilename2,
+                fs::copy_options::overwrite_existing);
+        }
         summary.real_subsample_bases = summary.total_bases;
         summary.real_subsample_fraction = 1.0;
         return;
@@ -150,7 +161,7 @@ void FastxSamplePair(
     fraction *= 1.05;
 
     gzFile fp1 = gzopen(ifilename1.c_str(), "r");
-    gzFile fp2 = gzopen(ifilename2.c_str(), "r");
+    gzFile fp2 = nullptr;
 
     if (fp1 == nullptr)
     {
@@ -158,14 +169,17 @@ void FastxSamplePair(
         std::exit(1);
     }
 
-    if (fp2 == nullptr)
+    if (!ifilename2.empty())
     {
-        std::perror(("Error! Can not open " + ifilename2).c_str());
-        std::exit(1);
+        fp2 = gzopen(ifilename2.c_str(), "r");
+        if (fp2 == nullptr)
+        {
+            std::perror(("Error! Can not open " + ifilename2).c_str());
+            std::exit(1);
+        }
     }
 
-    SeqReader reader1 = SeqReader(fp1);
-    SeqReader reader2 = SeqReader(fp2);
+    PairReader *reader = new PairReader(fp1, fp2);
 
     std::random_device rd;
     std::mt19937 g(rd());
@@ -190,13 +204,16 @@ void FastxSamplePair(
     }
     bgzf_thread_pool(bgzfp1, pool, 0);
     
-    BGZF* bgzfp2 = bgzf_open(ofilename2.c_str(), mode_str.str().c_str());
-    if (bgzfp2 == NULL) {
-        std::cerr << "Error! Can not open "
-            << ofilename2 << " for writing" << std::endl;
-        std::exit(1);
+    BGZF* bgzfp2 = bgzfp1;
+    if (!ofilename2.empty()) {
+        bgzfp2 = bgzf_open(ofilename2.c_str(), mode_str.str().c_str());
+        if (bgzfp2 == NULL) {
+            std::cerr << "Error! Can not open "
+                << ofilename2 << " for writing" << std::endl;
+            std::exit(1);
+        }
+        bgzf_thread_pool(bgzfp2, pool, 0);
     }
-    bgzf_thread_pool(bgzfp2, pool, 0);
 
 
     int64_t subsample_bases = 0;
@@ -204,8 +221,7 @@ void FastxSamplePair(
     int ret;
     kseq_t *read1 = nullptr;
     kseq_t *read2 = nullptr;
-    while ((read1 = reader1.read()) != nullptr &&
-        (read2 = reader2.read()) != nullptr)
+    while (reader->read(&read1, &read2))
     {
         // weight p by read length
         double p = random_u(g) * (read1->seq.l + read2->seq.l) / mean_length;
@@ -232,10 +248,12 @@ void FastxSamplePair(
     }
 
     bgzf_close(bgzfp1);
-    bgzf_close(bgzfp2);
+    if (bgzfp2 != bgzfp1) bgzf_close(bgzfp2);
     hts_tpool_destroy(pool);
+    // stop the reader threads before closing the inputs
+    delete reader;
     gzclose(fp1);
-    gzclose(fp2);
+    if (fp2) gzclose(fp2);
 
     summary.real_subsample_bases = subsample_bases;
 }
@@ -255,6 +273,7 @@ void Usage() {
             << "  -O, --out2, FILE            output fasta/fastq file name for read2.\n"
             << "  -b, --bases, STR            expected bases to subsample(K/M/G).\n"
             << "  -f, --fraction, FLOAT       expected fraction of bases to subsample.\n"
+            << "      --interleaved           input1 is interleaved pairs, written interleaved to output1.\n"
             << "  -l, --level, INT            compression level(0 to 9, or 11).[6]\n"
             << "  -s, --seed, INT             random seed.[11]\n"
             << "  -t, --thread, INT           number of threads.[4]\n"
@@ -283,7 +302,9 @@ int FastxSampleMain(int argc, char **argv)
             {"seed", required_argument, 0, 's'},
             {"thread", required_argument, 0, 't'},
             {"help", no_argument, 0, 'h'},
-            {"version", no_argument, 0, 'V'}
+            {"version", no_argument, 0, 'V'},
+            {"interleaved", no_argument, 0, FASTX_SAMPLE_OPT_INTERLEAVED},
+            {0, 0, 0, 0}
     };
 
     int c, long_idx;
@@ -298,6 +319,7 @@ int FastxSampleMain(int argc, char **argv)
     int compress_level = 6;
     int seed = 11;
     int num_threads = 4;
+    bool interleaved = false;
 
     while ((c = getopt_long(
         argc, argv, opt_str, long_options, &long_idx)) != -1)
@@ -342,6 +364,9 @@ int FastxSampleMain(int argc, char **argv)
             case 't':
                 num_threads = SafeStrtol(optarg, 10);
                 break;
+            case FASTX_SAMPLE_OPT_INTERLEAVED:
+                interleaved = true;
+                break;
             case 'h':
                 Usage();
                 return 0;
@@ -366,6 +391,12 @@ int FastxSampleMain(int argc, char **argv)
         std::exit(1);
     }
 
+    if (interleaved && (!input2.empty() || !output2.empty())) {
+        std::cerr << "Error! -I(--in2) and -O(--out2) can not be used with "
+            << "--interleaved." << std::endl;
+        std::exit(1);
+    }
+
     if (!input2.empty() && output2.empty()) {
         std::cerr << "Error! Must set at the second output fasta/fastq file "
             << "using -O(--out2) When inputting 2 fasta/fastq files."
@@ -401,7 +432,7 @@ int FastxSampleMain(int argc, char **argv)
 
     SubsampleSummary summary;
 
-    if (input2.empty()) {
+    if (input2.empty() && !interleaved) {
         // single read
         int64_t total_reads, total_bases;
         FastxCount(input1, total_reads, total_bases);
@@ -427,7 +458,11 @@ int FastxSampleMain(int argc, char **argv)
     } else {
         // paired reads
         int64_t total_reads, total_bases;
-        FastxCountPair(input1, input2, total_reads, total_bases);
+        if (interleaved) {
+            FastxCount(input1, total_reads, total_bases);
+        } else {
+            FastxCountPair(input1, input2, total_reads, total_bases);
+        }
 
         summary.total_bases = total_bases;
 
@@ -0,0 +1,843 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <getopt.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "zlib.h"
+#include "faidx_utils.hpp"
+#include "fastx_serve.hpp"
+#include "kseq_utils.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+// max size of a request frame
+const uint32_t FASTX_SERVE_MAX_REQUEST = 16 * 1024 * 1024;
+
+// pending connections of the listening socket
+const int FASTX_SERVE_BACKLOG = 128;
+
+// a client not reading its response for this long is dropped
+const int FASTX_SERVE_WRITE_TIMEOUT_MS = 30000;
+
+// BGZF block header: gzip header(12 bytes) followed by the extra field
+const size_t BGZF_HEADER_PREFIX = 12;
+
+
+// removed on SIGINT/SIGTERM
+static char serve_socket_path[sizeof(sockaddr_un::sun_path)];
+
+
+static
+void ServeSignalHandler(int) {
+    unlink(serve_socket_path);
+    _exit(0);
+}
+
+
+/**
+ * @brief LRU cache of decompressed BGZF blocks, shared by all workers and
+ * all references. Blocks are decompressed outside the lock, a block missed
+ * by two workers at the same time is decompressed twice and cached once.
+ */
+class BlockCache {
+public:
+    explicit BlockCache(size_t capacity): capacity_(capacity) {}
+
+    BlockCache(const BlockCache &) = delete;
+    BlockCache &operator=(const BlockCache &) = delete;
+
+    std::shared_ptr<const std::string> get(uint64_t key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto iter = index_.find(key);
+        if (iter == index_.end()) return nullptr;
+        lru_.splice(lru_.begin(), lru_, iter->second);
+        return iter->second->second;
+    }
+
+    void put(uint64_t key, std::shared_ptr<const std::string> block) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index_.find(key) != index_.end()) return;
+        size_ += block->size();
+        lru_.emplace_front(key, std::move(block));
+        index_.emplace(key, lru_.begin());
+        // the newest block is kept even if it is larger than the capacity
+        while (size_ > capacity_ && lru_.size() > 1) {
+            size_ -= lru_.back().second->size();
+            index_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+    }
+
+private:
+    typedef std::pair<uint64_t, std::shared_ptr<const std::string>> Entry;
+
+    std::mutex mutex_;
+    std::list<Entry> lru_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+    size_t capacity_;
+    size_t size_ = 0;
+};
+
+
+/**
+ * @brief an indexed fasta/q loaded once for all queries. Uncompressed files
+ * are mapped, BGZF files are read block by block through the shared cache,
+ * blocks are located with the .gzi index. Reads are thread safe, faidx is
+ * only used for its hash.
+ */
+class ServeReference {
+public:
+    ServeReference(const std::string &filename, uint64_t id,
+        BlockCache *cache): filename_(filename), id_(id), cache_(cache)
+    {
+        fai_ = fai_load_format(filename.c_str(),
+            IsFastq(filename.c_str()) ? FAI_FASTQ : FAI_FASTA);
+        if (fai_ == nullptr) {
+            std::cerr << "[FastxServe] Error! Fail to load fai index for "
+                << filename << std::endl;
+            std::exit(1);
+        }
+
+        if (!fai_->bgzf->is_compressed) {
+            map_.reset(new FaiMmap(filename));
+            if (!map_->ok()) {
+                std::cerr << "[FastxServe] Error! Can not map " << filename
+                    << std::endl;
+                std::exit(1);
+            }
+            return;
+        }
+
+        fd_ = open(filename.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            std::perror(("Error! Can not open " + filename).c_str());
+            std::exit(1);
+        }
+        LoadGzi(filename + ".gzi");
+    }
+
+    ~ServeReference() {
+        if (fd_ >= 0) close(fd_);
+        fai_destroy(fai_);
+    }
+
+    ServeReference(const ServeReference &) = delete;
+    ServeReference &operator=(const ServeReference &) = delete;
+
+    bool is_fastq() const {
+        return fai_->format == FAI_FASTQ;
+    }
+
+    // NULL if name not found
+    const faidx1_t *find(const std::string &name) const {
+        khiter_t iter = kh_get(s, fai_->hash, name.c_str());
+        return iter == kh_end(fai_->hash) ? nullptr :
+            &kh_value(fai_->hash, iter);
+    }
+
+    /**
+     * @brief read the uncompressed bytes in [start, end) of the file
+     *
+     * @return false if the range is out of the file
+     */
+    bool read(uint64_t start, uint64_t end, std::string &out) const {
+        if (map_) return map_->read(start, end, out);
+
+        out.clear();
+        while (start < end) {
+            size_t b = std::upper_bound(uaddr_.begin(), uaddr_.end(),
+                start) - uaddr_.begin() - 1;
+            std::shared_ptr<const std::string> block = GetBlock(b);
+            if (block == nullptr) return false;
+            uint64_t in_block = start - uaddr_[b];
+            if (in_block >= block->size()) return false;
+            uint64_t n = std::min<uint64_t>(block->size() - in_block,
+                end - start);
+            out.append(*block, in_block, n);
+            start += n;
+        }
+        return true;
+    }
+
+    /**
+     * @brief fetch 0-based closed range [start, end] of a sequence(quality
+     * if qual), positions are clamped as faidx_fetch_seq64 does.
+     *
+     * @return false if the range is out of the file
+     */
+    bool fetch(const faidx1_t &val, bool qual, int64_t start, int64_t end,
+        std::string &out) const
+    {
+        out.clear();
+        if (map_) {
+            int64_t len;
+            char *seq = map_->fetch(val, qual, start, end, &len);
+            if (seq == nullptr) return false;
+            out.assign(seq, len);
+            free(seq);
+            return true;
+        }
+
+        start = std::max<int64_t>(start, 0);
+        end = std::min<int64_t>(end, static_cast<int64_t>(val.len) - 1);
+        if (start > end) return true;
+
+        // one read for the whole span, then the sequence lines are copied
+        // without the line breaks
+        uint64_t base = qual ? val.qual_offset : val.seq_offset;
+        auto offset = [&val, base](int64_t pos) {
+            return base + pos / val.line_blen * val.line_len +
+                pos % val.line_blen;
+        };
+        uint64_t span_start = offset(start);
+        std::string span;
+        if (!read(span_start, offset(end) + 1, span)) return false;
+
+        out.reserve(end - start + 1);
+        for (int64_t pos = start; pos <= end; ) {
+            int64_t in_line = pos % val.line_blen;
+            int64_t n_copy = std::min<int64_t>(val.line_blen - in_line,
+                end - pos + 1);
+            out.append(span, offset(pos) - span_start, n_copy);
+            pos += n_copy;
+        }
+        return true;
+    }
+
+    /**
+     * @brief name line(include name and comment) of a sequence
+     *
+     * @return false if it can not be read
+     */
+    bool name_line(const faidx1_t &val, std::string &out) const {
+        uint64_t start;
+        uint64_t end;
+        return FaiNameLineRange(fai_, val, &start, &end) &&
+            read(start, end, out) && FaiTrimNameLine(out);
+    }
+
+private:
+    /**
+     * @brief load .gzi, a count followed by (compressed, uncompressed)
+     * offset pairs of all blocks except the first one.
+     */
+    void LoadGzi(const std::string &gzi) {
+        FILE *fp = std::fopen(gzi.c_str(), "rb");
+        uint64_t n = 0;
+        if (fp == nullptr || std::fread(&n, sizeof(n), 1, fp) != 1) {
+            std::cerr << "[FastxServe] Error! Can not load " << gzi
+                << ", compressed input must be BGZF with .gzi index"
+                << std::endl;
+            std::exit(1);
+        }
+
+        caddr_.assign(1, 0);
+        uaddr_.assign(1, 0);
+        for (uint64_t i = 0; i < n; ++i) {
+            uint64_t offsets[2];
+            if (std::fread(offsets, sizeof(uint64_t), 2, fp) != 2) {
+                std::cerr << "[FastxServe] Error! " << gzi << " is truncated"
+                    << std::endl;
+                std::exit(1);
+            }
+            caddr_.push_back(offsets[0]);
+            uaddr_.push_back(offsets[1]);
+        }
+        std::fclose(fp);
+    }
+
+    std::shared_ptr<const std::string> GetBlock(size_t b) const {
+        // blocks of all references share the cache
+        uint64_t key = id_ << 48 | b;
+        std::shared_ptr<const std::string> block = cache_->get(key);
+        if (block) return block;
+
+        block = InflateBlock(caddr_[b]);
+        if (block) cache_->put(key, block);
+        return block;
+    }
+
+    // read and decompress the BGZF block at offset, NULL on failure
+    std::shared_ptr<const std::string> InflateBlock(uint64_t offset) const {
+        unsigned char prefix[BGZF_HEADER_PREFIX];
+        if (pread(fd_, prefix, sizeof(prefix), offset) !=
+            static_cast<ssize_t>(sizeof(prefix)) ||
+            prefix[0] != 31 || prefix[1] != 139 || !(prefix[3] & 4))
+        {
+            return nullptr;
+        }
+
+        // total block size is in the BC subfield of the extra field
+        size_t xlen = prefix[10] | prefix[11] << 8;
+        std::string extra(xlen, '\0');
+        if (pread(fd_, &extra[0], xlen, offset + sizeof(prefix)) !=
+            static_cast<ssize_t>(xlen))
+        {
+            return nullptr;
+        }
+        size_t block_size = 0;
+        for (size_t i = 0; i + 4 <= xlen; ) {
+            size_t len = static_cast<unsigned char>(extra[i + 2]) |
+                static_cast<unsigned char>(extra[i + 3]) << 8;
+            if (extra[i] == 'B' && extra[i + 1] == 'C' && len == 2 &&
+                i + 6 <= xlen)
+            {
+                block_size = (static_cast<unsigned char>(extra[i + 4]) |
+                    static_cast<unsigned char>(extra[i + 5]) << 8) + 1;
+                break;
+            }
+            i += 4 + len;
+        }
+        size_t header_size = sizeof(prefix) + xlen;
+        if (block_size < header_size + 8) return nullptr;
+
+        std::string raw(block_size, '\0');
+        if (pread(fd_, &raw[0], block_size, offset) !=
+            static_cast<ssize_t>(block_size))
+        {
+            return nullptr;
+        }
+
+        const unsigned char *tail = reinterpret_cast<const unsigned char *>(
+            raw.data() + block_size - 4);
+        uint32_t isize = tail[0] | tail[1] << 8 | tail[2] << 16 |
+            static_cast<uint32_t>(tail[3]) << 24;
+        auto block = std::make_shared<std::string>(isize, '\0');
+
+        z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        if (inflateInit2(&zs, -15) != Z_OK) return nullptr;
+        zs.next_in = reinterpret_cast<Bytef *>(&raw[header_size]);
+        zs.avail_in = block_size - header_size - 8;
+        zs.next_out = reinterpret_cast<Bytef *>(&(*block)[0]);
+        zs.avail_out = isize;
+        int ret = inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+        if (ret != Z_STREAM_END || zs.total_out != isize) return nullptr;
+
+        return block;
+    }
+
+    std::string filename_;
+    uint64_t id_;
+    BlockCache *cache_;
+    faidx_t *fai_ = nullptr;
+    std::unique_ptr<FaiMmap> map_;
+    int fd_ = -1;
+    std::vector<uint64_t> caddr_;
+    std::vector<uint64_t> uaddr_;
+};
+
+
+typedef std::vector<std::unique_ptr<ServeReference>> ServeReferences;
+
+
+/**
+ * @brief answer a query: regions(name or name:start-end, 1-based) separated
+ * by commas or new lines. Names are looked up in the references in order,
+ * a name containing ':' is tried as a name first.
+ *
+ * @return "OK\n" followed by the records, or "ERROR <message>\n"
+ */
+static
+std::string HandleQuery(const ServeReferences &refs, const std::string &query)
+{
+    std::string response = "OK\n";
+    std::string seq;
+    std::string qual;
+    std::string name_line;
+
+    size_t i = 0;
+    while (i < query.size()) {
+        size_t j = query.find_first_of(",\n", i);
+        if (j == std::string::npos) j = query.size();
+        std::string region = query.substr(i, j - i);
+        i = j + 1;
+        if (!region.empty() && region.back() == '\r') region.pop_back();
+        if (region.empty()) continue;
+
+        std::string name = region;
+        int64_t start = 0;
+        int64_t end = 0;
+        bool whole = true;
+        const ServeReference *ref = nullptr;
+        const faidx1_t *val = nullptr;
+        auto locate = [&refs, &ref, &val](const std::string &n) {
+            for (auto &r: refs) {
+                if ((val = r->find(n)) != nullptr) {
+                    ref = r.get();
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        if (!locate(name)) {
+            size_t colon = region.rfind(':');
+            size_t dash = colon == std::string::npos ?
+                std::string::npos : region.find('-', colon);
+            if (dash == std::string::npos) {
+                return "ERROR sequence not found: " + region + "\n";
+            }
+            const char *p = region.data();
+            auto start_result = std::from_chars(p + colon + 1, p + dash,
+                start);
+            auto end_result = std::from_chars(p + dash + 1,
+                p + region.size(), end);
+            if (start_result.ec != std::errc() ||
+                start_result.ptr != p + dash ||
+                end_result.ec != std::errc() ||
+                end_result.ptr != p + region.size())
+            {
+                return "ERROR sequence not found: " + region + "\n";
+            }
+            name = region.substr(0, colon);
+            whole = false;
+            if (!locate(name)) {
+                return "ERROR sequence not found: " + name + "\n";
+            }
+        }
+
+        if (whole) {
+            if (!ref->name_line(*val, name_line)) {
+                return "ERROR failed to read name line of " + name + "\n";
+            }
+            response += name_line;
+            start = 0;
+            end = static_cast<int64_t>(val->len) - 1;
+        } else {
+            response += ref->is_fastq() ? '@' : '>';
+            response += region;
+            start -= 1;
+            end -= 1;
+        }
+        response += '\n';
+
+        if (!ref->fetch(*val, false, start, end, seq) ||
+            (ref->is_fastq() && !ref->fetch(*val, true, start, end, qual)))
+        {
+            return "ERROR failed to fetch " + region + "\n";
+        }
+        response += seq;
+        response += '\n';
+        if (ref->is_fastq()) {
+            response += "+\n";
+            response += qual;
+            response += '\n';
+        }
+    }
+
+    return response;
+}
+
+
+static
+bool WriteFull(int fd, const void *buffer, size_t n) {
+    const char *p = static_cast<const char *>(buffer);
+    while (n > 0) {
+        ssize_t ret = send(fd, p, n, MSG_NOSIGNAL);
+        if (ret < 0 && errno == EINTR) continue;
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // connections are non-blocking, a client not reading its
+            // response is dropped after the timeout
+            pollfd pfd = {fd, POLLOUT, 0};
+            int ready = poll(&pfd, 1, FASTX_SERVE_WRITE_TIMEOUT_MS);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0) return false;
+            continue;
+        }
+        if (ret <= 0) return false;
+        p += ret;
+        n -= ret;
+    }
+    return true;
+}
+
+
+// frame: 4-byte little endian length followed by the payload
+static
+bool WriteFrame(int fd, const std::string &payload) {
+    uint32_t len = static_cast<uint32_t>(payload.size());
+    unsigned char header[4] = {
+        static_cast<unsigned char>(len), static_cast<unsigned char>(len >> 8),
+        static_cast<unsigned char>(len >> 16),
+        static_cast<unsigned char>(len >> 24)};
+    return WriteFull(fd, header, sizeof(header)) &&
+        WriteFull(fd, payload.data(), payload.size());
+}
+
+
+/**
+ * @brief take a complete request frame from the bytes received on a
+ * connection
+ *
+ * @return 1 and the payload in query if buffer holds a whole frame, 0 if
+ * more bytes are needed, -1 if the frame is too large
+ */
+static
+int TakeFrame(std::string &buffer, std::string &query) {
+    if (buffer.size() < 4) return 0;
+    const unsigned char *header =
+        reinterpret_cast<const unsigned char *>(buffer.data());
+    uint32_t len = header[0] | header[1] << 8 | header[2] << 16 |
+        static_cast<uint32_t>(header[3]) << 24;
+    if (len > FASTX_SERVE_MAX_REQUEST) return -1;
+    if (buffer.size() - 4 < len) return 0;
+    query.assign(buffer, 4, len);
+    buffer.erase(0, 4 + static_cast<size_t>(len));
+    return 1;
+}
+
+
+/**
+ * @brief read what is available on a non-blocking connection
+ *
+ * @return false if the client closed the connection or it failed
+ */
+static
+bool ReadAvailable(int fd, std::string &buffer) {
+    char chunk[65536];
+    while (true) {
+        ssize_t ret = ::read(fd, chunk, sizeof(chunk));
+        if (ret > 0) {
+            buffer.append(chunk, ret);
+            if (buffer.size() > FASTX_SERVE_MAX_REQUEST + 4) return true;
+            continue;
+        }
+        if (ret < 0 && errno == EINTR) continue;
+        return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+
+/**
+ * @brief answer one request of a connection
+ *
+ * @return false if the response can not be sent
+ */
+static
+bool ServeRequest(int fd, const ServeReferences &refs,
+    const std::string &query)
+{
+    std::string response = HandleQuery(refs, query);
+    if (response.size() > UINT32_MAX) {
+        response = "ERROR response too large\n";
+    }
+    return WriteFrame(fd, response);
+}
+
+
+/**
+ * @brief load references once and answer queries on a Unix domain socket.
+ * This thread polls the idle connections and collects the request frames,
+ * a connection with a complete request is handed to a worker, which answers
+ * it and hands the connection back, so any number of clients share the
+ * workers and a client sending a partial request holds none of them. Runs until SIGINT or SIGTERM,
+ * which removes the socket.
+ *
+ * @param inputs indexed fasta/q files, plain or BGZF with .gzi
+ * @param cache_size size of the BGZF block cache in bytes
+ */
+int FastxServe(const std::vector<std::string> &inputs,
+    const std::string &socket_path, int threads, size_t cache_size)
+{
+    BlockCache cache(cache_size);
+    ServeReferences refs;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        refs.emplace_back(new ServeReference(inputs[i], i, &cache));
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        std::perror("Error! Can not create socket");
+        std::exit(1);
+    }
+
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strcpy(addr.sun_path, socket_path.c_str());
+    std::strcpy(serve_socket_path, socket_path.c_str());
+
+    // a socket left by a killed server is replaced, a live one is not
+    struct stat st;
+    if (stat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool stale = probe >= 0 && connect(probe,
+            reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 &&
+            errno == ECONNREFUSED;
+        if (probe >= 0) close(probe);
+        if (!stale) {
+            std::cerr << "[FastxServe] Error! " << socket_path
+                << " is already serving" << std::endl;
+            std::exit(1);
+        }
+        unlink(socket_path.c_str());
+    }
+
+    if (bind(server, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(server, FASTX_SERVE_BACKLOG) < 0)
+    {
+        std::perror(("Error! Can not listen on " + socket_path).c_str());
+        std::exit(1);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, ServeSignalHandler);
+    signal(SIGTERM, ServeSignalHandler);
+
+    // workers wake the poll loop through the pipe when they return a
+    // connection
+    int wake[2];
+    if (pipe(wake) < 0) {
+        std::perror("Error! Can not create pipe");
+        std::exit(1);
+    }
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+
+    std::queue<std::pair<int, std::string>> ready;
+    std::vector<int> returned;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    auto worker = [&]() {
+        while (true) {
+            std::pair<int, std::string> request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]{return !ready.empty();});
+                request = std::move(ready.front());
+                ready.pop();
+            }
+            if (!ServeRequest(request.first, refs, request.second)) {
+                // closed by the poll loop, which owns the receive buffer
+                shutdown(request.first, SHUT_RDWR);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                returned.push_back(request.first);
+            }
+            char byte = 0;
+            while (write(wake[1], &byte, 1) < 0 && errno == EINTR) {}
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i) {
+        workers.emplace_back(worker);
+    }
+
+    std::cerr << "[FastxServe] Listening on " << socket_path << std::endl;
+
+    // bytes received but not yet handed to a worker, by connection
+    std::unordered_map<int, std::string> received;
+    // idle connections, owned by this thread until a request is complete
+    std::vector<int> idle;
+    std::vector<pollfd> fds;
+    std::vector<std::pair<int, std::string>> requests;
+    std::vector<int> back;
+    while (true) {
+        fds.clear();
+        fds.push_back({server, POLLIN, 0});
+        fds.push_back({wake[0], POLLIN, 0});
+        for (int fd: idle) fds.push_back({fd, POLLIN, 0});
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            std::perror("Error! poll failed");
+            break;
+        }
+
+        back.clear();
+        if (fds[1].revents) {
+            char buffer[256];
+            while (read(wake[0], buffer, sizeof(buffer)) > 0) {}
+            std::lock_guard<std::mutex> lock(mutex);
+            back.swap(returned);
+        }
+
+        // a connection stays idle until a whole request has arrived, a
+        // returned one may already hold the next request
+        std::vector<int> still_idle;
+        requests.clear();
+        auto dispatch = [&](int fd) {
+            std::string &buffer = received[fd];
+            std::string query;
+            if (ReadAvailable(fd, buffer)) {
+                int frame = TakeFrame(buffer, query);
+                if (frame > 0) {
+                    requests.emplace_back(fd, std::move(query));
+                    return;
+                }
+                if (frame == 0) {
+                    still_idle.push_back(fd);
+                    return;
+                }
+                WriteFrame(fd, "ERROR request too large\n");
+            }
+            received.erase(fd);
+            close(fd);
+        };
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (fds[i].revents) {
+                dispatch(fds[i].fd);
+            } else {
+                still_idle.push_back(fds[i].fd);
+            }
+        }
+        for (int fd: back) dispatch(fd);
+        idle.swap(still_idle);
+
+        if (!requests.empty()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto &request: requests) ready.push(std::move(request));
+            }
+            cv.notify_all();
+        }
+
+        if (fds[0].revents) {
+            int fd = accept(server, NULL, NULL);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                std::perror("Error! accept failed");
+                break;
+            }
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            idle.push_back(fd);
+        }
+    }
+
+    close(server);
+    unlink(socket_path.c_str());
+    std::exit(1);
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx serve " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  serve subsequence queries of indexed fasta/fastq on a "
+              << "Unix domain socket.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx serve [options] -s <socket> <file.fasta|file.fastq> [...]\n\n"
+            << "Options:\n"
+            << "  -s, --socket, FILE          Unix domain socket path\n"
+            << "  -c, --cache-size, STR       BGZF block cache size(K/M/G) [256M]\n"
+            << "  -t, --thread, INT           number of workers answering requests [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version.\n\n"
+            << "Protocol:\n"
+            << "  Requests and responses are frames of a 4-byte little endian length\n"
+            << "  followed by the payload. A request is regions(name or name:start-end,\n"
+            << "  1-based) separated by commas or new lines. The response is \"OK\\n\"\n"
+            << "  followed by the records, or \"ERROR <message>\\n\". A connection can\n"
+            << "  send any number of requests."
+            << std::endl;
+}
+
+
+int FastxServeMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"socket", required_argument, 0, 's'},
+            {"cache-size", required_argument, 0, 'c'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "s:c:t:hV";
+
+    std::string socket_path;
+    int64_t cache_size = KmgStrToInt("256M");
+    int num_threads = 4;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 's':
+                socket_path = optarg;
+                break;
+            case 'c':
+                cache_size = KmgStrToInt(optarg);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    std::vector<std::string> inputs(argv + optind, argv + argc);
+    if (inputs.empty()) {
+        std::cerr << "Error! Missing input file" << std::endl;
+        std::exit(1);
+    }
+
+    if (socket_path.empty()) {
+        std::cerr << "Error! Missing socket -s(--socket)" << std::endl;
+        std::exit(1);
+    }
+
+    if (socket_path.size() >= sizeof(sockaddr_un::sun_path)) {
+        std::cerr << "Error! Socket path is longer than "
+            << sizeof(sockaddr_un::sun_path) - 1 << " characters" << std::endl;
+        std::exit(1);
+    }
+
+    if (cache_size < 0) {
+        std::cerr << "Error! Cache size -c(--cache-size) must be greater than"
+            << " or equal to 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    return FastxServe(inputs, socket_path, num_threads, cache_size);
+}
@@ -0,0 +1,8 @@
+#ifndef FASTX_SERVE_HPP
+#define FASTX_SERVE_HPP
+
+
+int FastxServeMain(int argc, char **argv);
+
+
+#endif  // FASTX_SERVE_HPP
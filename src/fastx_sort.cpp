@@ -0,0 +1,615 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/thread_pool.h"
+#include "zlib.h"
+#include "batch_pipeline.hpp"
+#include "fastx_sort.hpp"
+#include "kseq_utils.hpp"
+#include "seq_reader.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+// compression level of the run files, fast rather than small
+const int FASTX_SORT_RUN_LEVEL = 1;
+
+// max number of run files merged at once, more are merged in rounds
+const size_t FASTX_SORT_MAX_MERGE = 256;
+
+
+enum class SortBy {kName, kLength, kSeq};
+
+
+struct SortOptions {
+    SortBy by = SortBy::kName;
+    // descending order
+    bool reverse = false;
+    int64_t max_memory = 0;
+    std::string tmp_dir;
+};
+
+
+/**
+ * @brief compare keys bytewise, ties are broken by input order so that the
+ * sort is stable whatever the number of threads.
+ */
+static inline
+bool SortKeyLess(const char *a, uint64_t a_len, uint64_t a_order,
+    const char *b, uint64_t b_len, uint64_t b_order, bool reverse)
+{
+    int c = std::memcmp(a, b, std::min(a_len, b_len));
+    if (c == 0 && a_len != b_len) c = a_len < b_len ? -1 : 1;
+    if (reverse) c = -c;
+    if (c != 0) return c < 0;
+    return a_order < b_order;
+}
+
+
+/**
+ * @brief records of a run in memory, the key of each record followed by the
+ * record formatted as fasta/q in one buffer.
+ */
+class SortChunk {
+public:
+    struct Entry {
+        // input order
+        uint64_t order;
+        uint64_t offset;
+        uint64_t key_len;
+        uint64_t record_len;
+    };
+
+    explicit SortChunk(const SortOptions &options): options_(options) {}
+
+    ~SortChunk() {
+        free(buffer_.s);
+    }
+
+    SortChunk(const SortChunk &) = delete;
+    SortChunk &operator=(const SortChunk &) = delete;
+
+    void add(const kseq_t *seq, uint64_t order) {
+        Entry entry;
+        entry.order = order;
+        entry.offset = buffer_.l;
+        int r = 0;
+        if (options_.by == SortBy::kName) {
+            r = kputsn(seq->name.s, seq->name.l, &buffer_);
+        } else if (options_.by == SortBy::kSeq) {
+            r = kputsn(seq->seq.s, seq->seq.l, &buffer_);
+        } else {
+            // big endian, compares bytewise as a number
+            char len[8];
+            uint64_t l = seq->seq.l;
+            for (int i = 7; i >= 0; --i, l >>= 8) len[i] = l & 0xff;
+            r = kputsn(len, 8, &buffer_);
+        }
+        entry.key_len = buffer_.l - entry.offset;
+        if (r < 0 || KstringAppendKseq(&buffer_, seq) < 0) {
+            std::cerr << "Error! Failed to buffer read: " << seq->name.s
+                << std::endl;
+            std::exit(1);
+        }
+        entry.record_len = buffer_.l - entry.offset - entry.key_len;
+        entries_.push_back(entry);
+    }
+
+    void sort() {
+        const char *s = buffer_.s;
+        bool reverse = options_.reverse;
+        std::sort(entries_.begin(), entries_.end(),
+            [s, reverse](const Entry &a, const Entry &b) {
+                return SortKeyLess(s + a.offset, a.key_len, a.order,
+                    s + b.offset, b.key_len, b.order, reverse);
+            });
+    }
+
+    void clear() {
+        buffer_.l = 0;
+        entries_.clear();
+    }
+
+    // memory of the records
+    size_t bytes() const {
+        return buffer_.l + entries_.size() * sizeof(Entry);
+    }
+
+    bool empty() const {
+        return entries_.empty();
+    }
+
+    const std::vector<Entry> &entries() const {
+        return entries_;
+    }
+
+    const char *data() const {
+        return buffer_.s;
+    }
+
+private:
+    const SortOptions &options_;
+    kstring_t buffer_ = {0, 0, NULL};
+    std::vector<Entry> entries_;
+};
+
+
+/**
+ * @brief header of a record in a run file, followed by key and record
+ */
+struct SortRunHeader {
+    uint64_t order;
+    uint64_t key_len;
+    uint64_t record_len;
+};
+
+
+static
+BGZF *SortOpenRun(const std::string &filename, const char *mode) {
+    BGZF *fp = bgzf_open(filename.c_str(), mode);
+    if (fp == NULL) {
+        std::cerr << "Error! Can not open run file " << filename << std::endl;
+        std::exit(1);
+    }
+    return fp;
+}
+
+
+static
+void SortWriteRunRecord(BGZF *fp, const std::string &filename,
+    uint64_t order, const char *key, uint64_t key_len, const char *record,
+    uint64_t record_len)
+{
+    SortRunHeader header{order, key_len, record_len};
+    BgzfWriteOutput(fp, reinterpret_cast<const char *>(&header),
+        sizeof(header), filename);
+    BgzfWriteOutput(fp, key, key_len, filename);
+    BgzfWriteOutput(fp, record, record_len, filename);
+}
+
+
+/**
+ * @brief sorted records to merge, from a chunk in memory or a run file
+ */
+class SortSource {
+public:
+    explicit SortSource(std::unique_ptr<SortChunk> chunk):
+        chunk_(std::move(chunk))
+    {
+        next();
+    }
+
+    explicit SortSource(const std::string &filename):
+        filename_(filename), fp_(SortOpenRun(filename, "r"))
+    {
+        next();
+    }
+
+    ~SortSource() {
+        if (fp_) {
+            bgzf_close(fp_);
+            std::remove(filename_.c_str());
+        }
+    }
+
+    SortSource(const SortSource &) = delete;
+    SortSource &operator=(const SortSource &) = delete;
+
+    // move to the next record, done() once there is no more
+    void next() {
+        if (chunk_) {
+            if (index_ == chunk_->entries().size()) {
+                done_ = true;
+                return;
+            }
+            const SortChunk::Entry &entry = chunk_->entries()[index_++];
+            order_ = entry.order;
+            key_ = chunk_->data() + entry.offset;
+            key_len_ = entry.key_len;
+            record_len_ = entry.record_len;
+            return;
+        }
+
+        SortRunHeader header;
+        ssize_t r = bgzf_read(fp_, &header, sizeof(header));
+        if (r == 0) {
+            done_ = true;
+            return;
+        }
+        buffer_.resize(header.key_len + header.record_len);
+        if (r != sizeof(header) || bgzf_read(fp_, &buffer_[0],
+            buffer_.size()) != static_cast<ssize_t>(buffer_.size()))
+        {
+            std::cerr << "Error! Truncated run file " << filename_
+                << std::endl;
+            std::exit(1);
+        }
+        order_ = header.order;
+        key_ = buffer_.data();
+        key_len_ = header.key_len;
+        record_len_ = header.record_len;
+    }
+
+    bool done() const {
+        return done_;
+    }
+
+    uint64_t order() const {
+        return order_;
+    }
+
+    const char *key() const {
+        return key_;
+    }
+
+    uint64_t key_len() const {
+        return key_len_;
+    }
+
+    const char *record() const {
+        return key_ + key_len_;
+    }
+
+    uint64_t record_len() const {
+        return record_len_;
+    }
+
+private:
+    std::unique_ptr<SortChunk> chunk_;
+    size_t index_ = 0;
+    std::string filename_;
+    BGZF *fp_ = nullptr;
+    std::string buffer_;
+
+    bool done_ = false;
+    uint64_t order_ = 0;
+    const char *key_ = nullptr;
+    uint64_t key_len_ = 0;
+    uint64_t record_len_ = 0;
+};
+
+
+/**
+ * @brief tournament tree of losers over sorted sources. Each internal node
+ * holds the loser of its match, node 0 the overall winner, so that taking
+ * the smallest record replays a single leaf to root path.
+ */
+class LoserTree {
+public:
+    LoserTree(std::vector<std::unique_ptr<SortSource>> &sources,
+        bool reverse): sources_(sources), reverse_(reverse),
+        k_(sources.size()), tree_(sources.size(), 0)
+    {
+        if (k_) tree_[0] = Build(1);
+    }
+
+    // source of the smallest record, nullptr if all are done
+    SortSource *top() const {
+        if (k_ == 0 || sources_[tree_[0]]->done()) return nullptr;
+        return sources_[tree_[0]].get();
+    }
+
+    // advance the top source and replay its path
+    void pop() {
+        size_t winner = tree_[0];
+        sources_[winner]->next();
+        for (size_t node = (winner + k_) / 2; node > 0; node /= 2) {
+            if (Less(tree_[node], winner)) std::swap(tree_[node], winner);
+        }
+        tree_[0] = winner;
+    }
+
+private:
+    bool Less(size_t a, size_t b) const {
+        const SortSource &x = *sources_[a];
+        const SortSource &y = *sources_[b];
+        if (x.done()) return false;
+        if (y.done()) return true;
+        return SortKeyLess(x.key(), x.key_len(), x.order(), y.key(),
+            y.key_len(), y.order(), reverse_);
+    }
+
+    // leaves are nodes k_ to 2k_-1, return the winner below node
+    size_t Build(size_t node) {
+        if (node >= k_) return node - k_;
+        size_t a = Build(2 * node);
+        size_t b = Build(2 * node + 1);
+        if (Less(b, a)) std::swap(a, b);
+        tree_[node] = b;
+        return a;
+    }
+
+    std::vector<std::unique_ptr<SortSource>> &sources_;
+    bool reverse_;
+    size_t k_;
+    std::vector<size_t> tree_;
+};
+
+
+/**
+ * @brief names of run files in tmp_dir, unique within this process
+ */
+class SortRunNames {
+public:
+    explicit SortRunNames(const std::string &tmp_dir):
+        prefix_(tmp_dir + "/fastx_sort." + std::to_string(getpid()) + ".")
+    {}
+
+    std::string next() {
+        return prefix_ + std::to_string(count_++);
+    }
+
+private:
+    std::string prefix_;
+    std::atomic<uint64_t> count_{0};
+};
+
+
+/**
+ * @brief sort a fasta/q file by name, length or sequence with memory bounded
+ * by max_memory. Workers take batches from SeqReader into their own chunk,
+ * each full chunk is sorted and spilled to a run file. The remaining chunks
+ * and the runs are merged with a loser tree through the output writer.
+ */
+int FastxSort(const std::string &input, const std::string &output,
+    const SortOptions &options, int compress_level, int threads)
+{
+    gzFile fp = input == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input.c_str(), "r");
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + input).c_str());
+        std::exit(1);
+    }
+
+    SortRunNames run_names(options.tmp_dir);
+    std::vector<std::string> runs;
+    std::vector<std::unique_ptr<SortSource>> sources;
+    {
+        SeqReader reader(fp);
+        std::mutex mutex;
+        size_t chunk_memory = options.max_memory / threads;
+
+        auto worker = [&]() {
+            std::unique_ptr<SortChunk> chunk(new SortChunk(options));
+            KseqArray *batch;
+            uint64_t id = 0;
+            while ((batch = reader.read_batch(&id)) != nullptr) {
+                for (int i = 0; i < batch->size(); ++i) {
+                    chunk->add(batch->get(i), (id << 32) | i);
+                }
+                reader.release(batch);
+                if (chunk->bytes() < chunk_memory) continue;
+
+                chunk->sort();
+                std::string filename = run_names.next();
+                std::string mode = "w" + std::to_string(FASTX_SORT_RUN_LEVEL);
+                BGZF *run = SortOpenRun(filename, mode.c_str());
+                for (auto &entry: chunk->entries()) {
+                    const char *key = chunk->data() + entry.offset;
+                    SortWriteRunRecord(run, filename, entry.order, key,
+                        entry.key_len, key + entry.key_len,
+                        entry.record_len);
+                }
+                if (bgzf_close(run) < 0) {
+                    std::cerr << "Error! Failed to close run file "
+                        << filename << std::endl;
+                    std::exit(1);
+                }
+                chunk->clear();
+                std::lock_guard<std::mutex> lock(mutex);
+                runs.push_back(filename);
+            }
+
+            if (chunk->empty()) return;
+            chunk->sort();
+            std::lock_guard<std::mutex> lock(mutex);
+            sources.emplace_back(new SortSource(std::move(chunk)));
+        };
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; ++i) {
+            workers.emplace_back(worker);
+        }
+        for (auto &w: workers) w.join();
+    }
+    gzclose(fp);
+
+    // too many runs to open at once, merge them into larger runs first
+    while (runs.size() > 1 &&
+        runs.size() + sources.size() > FASTX_SORT_MAX_MERGE)
+    {
+        std::vector<std::unique_ptr<SortSource>> group;
+        size_t n = std::min(runs.size(), FASTX_SORT_MAX_MERGE);
+        for (size_t i = 0; i < n; ++i) {
+            group.emplace_back(new SortSource(runs[i]));
+        }
+        runs.erase(runs.begin(), runs.begin() + n);
+
+        std::string filename = run_names.next();
+        std::string mode = "w" + std::to_string(FASTX_SORT_RUN_LEVEL);
+        BGZF *run = SortOpenRun(filename, mode.c_str());
+        LoserTree tree(group, options.reverse);
+        for (SortSource *s = tree.top(); s; tree.pop(), s = tree.top()) {
+            SortWriteRunRecord(run, filename, s->order(), s->key(),
+                s->key_len(), s->record(), s->record_len());
+        }
+        if (bgzf_close(run) < 0) {
+            std::cerr << "Error! Failed to close run file " << filename
+                << std::endl;
+            std::exit(1);
+        }
+        runs.push_back(filename);
+    }
+    for (auto &run: runs) sources.emplace_back(new SortSource(run));
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+
+    BGZF *outfp = BgzfOpenOutput(output, compress_level, pool);
+
+    {
+        LoserTree tree(sources, options.reverse);
+        for (SortSource *s = tree.top(); s; tree.pop(), s = tree.top()) {
+            BgzfWriteOutput(outfp, s->record(), s->record_len(), output);
+        }
+    }
+    sources.clear();
+
+    if (bgzf_close(outfp) < 0) {
+        std::cerr << "Error! Failed to close " << output << std::endl;
+        std::exit(1);
+    }
+    hts_tpool_destroy(pool);
+
+    return 0;
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx sort " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  sort sequences by name, length or sequence, in external "
+              << "memory for large files.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx sort [options] <file.fasta|file.fastq|->\n\n"
+            << "Options:\n"
+            << "  -o, --output, FILE          output file name [stdout]\n"
+            << "  -k, --by, STR               sort key, name, length or seq [name]\n"
+            << "  -r, --reverse               sort in descending order\n"
+            << "  -m, --max-memory, STR       memory of the records in memory(K/M/G), sorted\n"
+            << "                              runs are spilled to disk beyond it [4G]\n"
+            << "  -T, --tmp-dir, DIR          directory of the runs [$TMPDIR or /tmp]\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for sorting and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version."
+            << std::endl;
+}
+
+
+int FastxSortMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"output", required_argument, 0, 'o'},
+            {"by", required_argument, 0, 'k'},
+            {"reverse", no_argument, 0, 'r'},
+            {"max-memory", required_argument, 0, 'm'},
+            {"tmp-dir", required_argument, 0, 'T'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "o:k:rm:T:l:t:hV";
+
+    std::string output = "-";
+    std::string by = "name";
+    SortOptions options;
+    options.max_memory = KmgStrToInt("4G");
+    const char *tmp_dir = std::getenv("TMPDIR");
+    options.tmp_dir = tmp_dir ? tmp_dir : "/tmp";
+    int compress_level = 6;
+    int num_threads = 4;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'k':
+                by = optarg;
+                break;
+            case 'r':
+                options.reverse = true;
+                break;
+            case 'm':
+                options.max_memory = KmgStrToInt(optarg);
+                break;
+            case 'T':
+                options.tmp_dir = optarg;
+                break;
+            case 'l':
+                compress_level = SafeStrtol(optarg, 10);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (optind != argc - 1) {
+        std::cerr << "Error! Must set one input file" << std::endl;
+        std::exit(1);
+    }
+    std::string input = argv[optind];
+
+    if (by == "name") {
+        options.by = SortBy::kName;
+    } else if (by == "length") {
+        options.by = SortBy::kLength;
+    } else if (by == "seq") {
+        options.by = SortBy::kSeq;
+    } else {
+        std::cerr << "Error! Unknown sort key " << by << ", must be name, "
+            << "length or seq" << std::endl;
+        std::exit(1);
+    }
+
+    if (options.max_memory <= 0) {
+        std::cerr << "Error! -m(--max-memory) must be positive" << std::endl;
+        std::exit(1);
+    }
+
+    if (compress_level < 0) {
+        std::cerr << "Error! Compression level must be greater than or equal to"
+            << " 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    return FastxSort(input, output, options, compress_level, num_threads);
+}
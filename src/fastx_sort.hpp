@@ -0,0 +1,8 @@
+#ifndef FASTX_SORT_HPP
+#define FASTX_SORT_HPP
+
+
+int FastxSortMain(int argc, char **argv);
+
+
+#endif  // FASTX_SORT_HPP
@@ -1,161 +1,1297 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
 #include <iostream>
 #include <iomanip>
+#include <list>
 #include <sstream>
 #include <string>
 #include <cstdlib>
 #include <cstdio>
+#include <csignal>
 #include <zlib.h>
 #include <getopt.h>
+#include <fcntl.h>
+#include <map>
+#include <memory>
+#include <regex>
 #include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "utils.hpp"
 #include "kseq_utils.hpp"
 #include "htslib/bgzf.h"
 #include "seq_reader.hpp"
+#include "bgzf_closer.hpp"
 #include "version.hpp"
 #include "htslib/thread_pool.h"
 
+namespace fs = std::filesystem;
+
+
+/**
+ * @brief options of where the chunks of split by reads/bases go. By default
+ * chunks are written to BGZF files. Optionally chunks are written to named
+ * FIFOs, or piped to the stdin of a command spawned per chunk, so that the
+ * chunks are consumed while splitting without a round trip through disk.
+ */
+struct ChunkSinkOptions {
+    // command spawned per chunk by sh -c, {} is replaced by the chunk number
+    std::string exec;
+    // create the outputs as named FIFOs
+    bool fifo = false;
+    // write plain text instead of BGZF
+    bool uncompressed = false;
+    // max number of running commands
+    int max_jobs = 4;
+};
+
+
+/**
+ * @brief open the writer of each chunk according to ChunkSinkOptions. For
+ * --exec, paired chunks are interleaved into the stdin of one command.
+ */
+class ChunkSink {
+public:
+    ChunkSink(const ChunkSinkOptions &options, int compress_level,
+        hts_tpool *pool): options_(options), pool_(pool)
+    {
+        std::ostringstream mode_str;
+        mode_str << "w";
+        if (options_.uncompressed) {
+            mode_str << "u";
+        } else {
+            mode_str << compress_level;
+        }
+        mode_ = mode_str.str();
+
+        // a command exiting early must not kill fastx, write fails instead
+        if (!options_.exec.empty()) signal(SIGPIPE, SIG_IGN);
+    }
+
+    ~ChunkSink() {
+        wait();
+    }
+
+    bool interleaved() const {
+        return !options_.exec.empty();
+    }
+
+    BGZF *open(const std::string &filename, int64_t n) {
+        BGZF *fp = nullptr;
+        if (!options_.exec.empty()) {
+            fp = Spawn(n);
+        } else {
+            if (options_.fifo) MakeFifo(filename);
+            fp = bgzf_open(filename.c_str(), mode_.c_str());
+            if (fp == NULL) {
+                std::cerr << "Error! Can not open " << filename
+                    << " for writing" << std::endl;
+                std::exit(1);
+            }
+        }
+        if (!options_.uncompressed) bgzf_thread_pool(fp, pool_, 0);
+        return fp;
+    }
+
+    // wait for all commands to finish, the writers must be closed before
+    void wait() {
+        while (!children_.empty()) Reap();
+    }
+
+private:
+    static void MakeFifo(const std::string &filename) {
+        struct stat st;
+        if (stat(filename.c_str(), &st) == 0) {
+            if (S_ISFIFO(st.st_mode)) return;
+            unlink(filename.c_str());
+        }
+        if (mkfifo(filename.c_str(), 0644) != 0) {
+            std::perror(("Error! Can not create fifo " + filename).c_str());
+            std::exit(1);
+        }
+    }
+
+    BGZF *Spawn(int64_t n) {
+        while (static_cast<int>(children_.size()) >= options_.max_jobs) {
+            Reap();
+        }
+
+        std::string command = options_.exec;
+        std::string chunk = std::to_string(n);
+        size_t i = 0;
+        while ((i = command.find("{}", i)) != std::string::npos) {
+            command.replace(i, 2, chunk);
+            i += chunk.size();
+        }
+        std::string env = "FASTX_CHUNK=" + chunk;
+
+        int fds[2];
+        // close-on-exec so that later commands do not hold the write end
+        if (pipe2(fds, O_CLOEXEC) != 0) {
+            std::perror("Error! Can not create pipe");
+            std::exit(1);
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::perror("Error! Can not fork");
+            std::exit(1);
+        } else if (pid == 0) {
+            dup2(fds[0], STDIN_FILENO);
+            putenv(&env[0]);
+            execl("/bin/sh", "sh", "-c", command.c_str(), (char *)NULL);
+            _exit(127);
+        }
+
+        close(fds[0]);
+        children_.emplace(pid, command);
+
+        BGZF *fp = bgzf_dopen(fds[1], mode_.c_str());
+        if (fp == NULL) {
+            std::cerr << "Error! Can not open pipe to command: " << command
+                << std::endl;
+            std::exit(1);
+        }
+        return fp;
+    }
+
+    void Reap() {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            std::perror("Error! waitpid failed");
+            std::exit(1);
+        }
+        auto iter = children_.find(pid);
+        if (iter == children_.end()) return;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "Error! Command failed: " << iter->second
+                << std::endl;
+            std::exit(1);
+        }
+        children_.erase(iter);
+    }
+
+    ChunkSinkOptions options_;
+    std::string mode_;
+    hts_tpool *pool_;
+    std::map<pid_t, std::string> children_;
+};
+
 
 void FastxSplitReads(const std::string &ifilename, int64_t n_read_per_chunk,
     int64_t n_base_per_chunk, const std::string &prefix,
-    const std::string &suffix, int threads, int compress_level)
+    const std::string &suffix, int threads, int compress_level,
+    const ChunkSinkOptions &sink_options)
+{
+    bool split_by_base = false;
+    if (n_read_per_chunk <= 0) {
+        if (n_base_per_chunk > 0) {
+            split_by_base = true;
+        } else {
+            std::cerr << "Error! Must input a least one of "
+                << "bases(-b, --bases) or reads(-r, --reads)"
+                << std::endl;
+            std::exit(1);
+        }
+    }
+
+    gzFile fp = gzopen(ifilename.c_str(), "r");
+
+    kseq_t *read = kseq_init(fp);
+
+    int ret1, ret2;
+    int64_t read_count = 0;
+    int64_t base_count = 0;
+    bool open_new = false;
+    int64_t n = 0;
+
+    std::ostringstream ofilename;
+    ofilename << prefix << "." << n << "." << suffix;
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+
+    ChunkSink sink(sink_options, compress_level, pool);
+    BGZF* bgzfp = sink.open(ofilename.str(), n);
+    BgzfCloser closer;
+
+    while ((ret1 = kseq_read(read)) >= 0)
+    {
+        if (!open_new) {
+            ret2 = BgzfWriteKseq(bgzfp, read);
+            if (ret2 < 0) {
+                std::cerr << "Error! Failed to write read: "
+                    << read->name.s << " to " << ofilename.str() << std::endl;
+                std::exit(1);
+            }
+            if (split_by_base) {
+                base_count += read->seq.l;
+                if (base_count >= n_base_per_chunk) open_new = true;
+            } else {
+                ++read_count;
+                if (read_count >= n_read_per_chunk) open_new = true;
+            }
+        } else {
+            ++n;
+            // finalize the chunk in background while filling the next one
+            closer.close(bgzfp, ofilename.str());
+            ofilename.str("");   // clear
+            ofilename << prefix << "." << n << "." << suffix;
+            bgzfp = sink.open(ofilename.str(), n);
+
+            ret2 = BgzfWriteKseq(bgzfp, read);
+            if (ret2 < 0) {
+                std::cerr << "Error! Failed to write read: "
+                    << read->name.s << " to " << ofilename.str() << std::endl;
+                std::exit(1);
+            }
+
+            if (split_by_base) {
+                base_count = 0;
+                base_count += read->seq.l;
+                if (base_count < n_base_per_chunk) open_new = false;
+            } else {
+                read_count = 0;
+                ++read_count;
+                if (read_count < n_read_per_chunk) open_new = false;
+            }
+        }
+    }
+
+    if (ret1 == -2) {
+        std::cerr << "Error! Input fastq file quality is truncated "
+            << ifilename << std::endl;
+        std::exit(1);
+    } else if (ret1 == -3) {
+        std::cerr << "Error! Input fastq file stream error!"
+            << ifilename << std::endl;
+        std::exit(1);
+    }
+
+    closer.close(bgzfp, ofilename.str());
+    closer.wait();
+    sink.wait();
+    hts_tpool_destroy(pool);
+    kseq_destroy(read);
+    gzclose(fp);
+}
+
+/**
+ * @brief split paired end fastq/fasta by number of reads or bases. read1 and
+ * read2 are read in a single pass and written to the .R1./.R2. chunks
+ * together, so chunk boundaries always stay aligned between the mates. An
+ * interleaved input1(input2 empty) is split into interleaved chunks.
+ * 
+ * @param input1 first input fastq/fasta file path
+ * @param input2 second input fastq/fasta file path, empty if input1 is
+ * interleaved
+ * @param n_read_per_chunk number of read pairs per chunk
+ * @param n_base_per_chunk number of bases(read1 + read2) per chunk
+ * @param prefix output prefix
+ * @param suffix output suffix
+ * @param threads number of threads
+ * @param compress_level compress level
+ * @param sink_options where the chunks go
+ */
+void FastxSplitReadsPair(
+    const std::string &input1, const std::string &input2,
+    int64_t n_read_per_chunk, int64_t n_base_per_chunk,
+    const std::string &prefix, const std::string &suffix,
+    int threads, int compress_level, const ChunkSinkOptions &sink_options)
+{
+    bool split_by_base = false;
+    if (n_read_per_chunk <= 0) {
+        if (n_base_per_chunk > 0) {
+            split_by_base = true;
+        } else {
+            std::cerr << "Error! Must input a least one of "
+                << "bases(-b, --bases) or reads(-r, --reads)"
+                << std::endl;
+            std::exit(1);
+        }
+    }
+
+    gzFile fp1 = gzopen(input1.c_str(), "r");
+    if (fp1 == nullptr)
+    {
+        std::perror(("Error! Can not open " + input1).c_str());
+        std::exit(1);
+    }
+
+    gzFile fp2 = nullptr;
+    if (!input2.empty())
+    {
+        fp2 = gzopen(input2.c_str(), "r");
+        if (fp2 == nullptr)
+        {
+            std::perror(("Error! Can not open " + input2).c_str());
+            std::exit(1);
+        }
+    }
+
+    PairReader *reader = new PairReader(fp1, fp2);
+    // mates are interleaved if both go to one command or input1 is
+    // interleaved
+    const char *mate1 = reader->interleaved() ? "" : ".R1";
+
+    int64_t read_count = 0;
+    int64_t base_count = 0;
+    bool open_new = false;
+    int64_t n = 0;
+
+    std::ostringstream ofilename1;
+    ofilename1 << prefix << "." << n << mate1 << "." << suffix;
+    std::ostringstream ofilename2;
+    ofilename2 << prefix << "." << n << ".R2." << suffix;
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+
+    ChunkSink sink(sink_options, compress_level, pool);
+    bool one_output = sink.interleaved() || reader->interleaved();
+    BGZF* bgzfp1 = sink.open(ofilename1.str(), n);
+    BGZF* bgzfp2 = one_output ? bgzfp1 : sink.open(ofilename2.str(), n);
+    BgzfCloser closer;
+
+    int ret;
+    kseq_t *read1 = nullptr;
+    kseq_t *read2 = nullptr;
+    while (reader->read(&read1, &read2))
+    {
+        if (open_new) {
+            ++n;
+            // finalize the chunk in background while filling the next one
+            closer.close(bgzfp1, ofilename1.str());
+            if (bgzfp2 != bgzfp1) closer.close(bgzfp2, ofilename2.str());
+            ofilename1.str("");   // clear
+            ofilename2.str("");   // clear
+            ofilename1 << prefix << "." << n << mate1 << "." << suffix;
+            ofilename2 << prefix << "." << n << ".R2." << suffix;
+            
+            bgzfp1 = sink.open(ofilename1.str(), n);
+            bgzfp2 = one_output ? bgzfp1 : sink.open(ofilename2.str(), n);
+
+            read_count = 0;
+            base_count = 0;
+            open_new = false;
+        }
+
+        ret = BgzfWriteKseq(bgzfp1, read1);
+        if (ret < 0) {
+            std::cerr << "Error! Failed to write read1: "
+                << read1->name.s << " to " << ofilename1.str() << std::endl;
+            std::exit(1);
+        }
+        ret = BgzfWriteKseq(bgzfp2, read2);
+        if (ret < 0) {
+            std::cerr << "Error! Failed to write read2: "
+                << read2->name.s << " to " << ofilename2.str() << std::endl;
+            std::exit(1);
+        }
+
+        if (split_by_base) {
+            base_count += read1->seq.l;
+            base_count += read2->seq.l;
+            if (base_count >= n_base_per_chunk) open_new = true;
+        } else {
+            ++read_count;
+            if (read_count >= n_read_per_chunk) open_new = true;
+        }
+    }
+
+    closer.close(bgzfp1, ofilename1.str());
+    if (bgzfp2 != bgzfp1) closer.close(bgzfp2, ofilename2.str());
+    closer.wait();
+    sink.wait();
+    hts_tpool_destroy(pool);
+    // stop the reader threads before closing the inputs
+    delete reader;
+    gzclose(fp1);
+    if (fp2) gzclose(fp2);
+}
+
+
+// buffer size for copying raw bytes of a part
+const size_t FASTX_SPLIT_COPY_BUFFER_SIZE = 1 << 20;
+
+// number of leading records used to estimate bases of a gzip input
+const int64_t FASTX_SPLIT_ESTIMATE_READS = 100000;
+
+
+enum class InputType {
+    kUncompressed,
+    kBgzf,
+    kGzip,
+    kStream
+};
+
+
+static
+InputType DetectInputType(const std::string &filename)
+{
+    std::error_code ec;
+    if (!fs::is_regular_file(filename, ec)) return InputType::kStream;
+
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + filename).c_str());
+        std::exit(1);
+    }
+    unsigned char magic[2] = {0, 0};
+    size_t n = fread(magic, 1, 2, fp);
+    fclose(fp);
+
+    if (n < 2 || magic[0] != 0x1f || magic[1] != 0x8b) {
+        return InputType::kUncompressed;
+    }
+
+    return bgzf_is_bgzf(filename.c_str()) ? InputType::kBgzf : InputType::kGzip;
+}
+
+
+/**
+ * @brief reading position of a BGZF reader. Virtual offset for BGZF files,
+ * plain byte offset for uncompressed files.
+ */
+static
+int64_t BgzfPosition(BGZF *fp)
+{
+    int64_t voffset = bgzf_tell(fp);
+    if (fp->is_compressed) return voffset;
+    return (voffset >> 16) + (voffset & 0xFFFF);
+}
+
+
+static
+int BgzfSeekPosition(BGZF *fp, int64_t pos)
+{
+    if (fp->is_compressed) return bgzf_seek(fp, pos, SEEK_SET) < 0 ? -1 : 0;
+    return bgzf_useek(fp, pos, SEEK_SET);
+}
+
+
+/**
+ * @brief find the compressed offset of the first BGZF block starting at or
+ * after coffset. A candidate block header is accepted only if the block it
+ * describes is followed by another block header or the end of file.
+ * 
+ * @return int64_t compressed offset of the block, -1 if not found
+ */
+static
+int64_t BgzfNextBlockOffset(const std::string &filename, int64_t coffset)
+{
+    static const unsigned char kMagic[] = {
+        0x1f, 0x8b, 0x08, 0x04};
+
+    FILE *fp = fopen(filename.c_str(), "rb");
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + filename).c_str());
+        std::exit(1);
+    }
+    fseeko(fp, 0, SEEK_END);
+    int64_t file_size = ftello(fp);
+
+    auto is_block_start = [&](int64_t offset, int64_t &block_size) {
+        unsigned char header[18];
+        if (fseeko(fp, offset, SEEK_SET) != 0 ||
+            fread(header, 1, 18, fp) != 18) return false;
+        if (memcmp(header, kMagic, 4) != 0 || header[12] != 'B' ||
+            header[13] != 'C' || header[14] != 2 || header[15] != 0)
+        {
+            return false;
+        }
+        block_size = (header[16] | (header[17] << 8)) + 1;
+        return true;
+    };
+
+    std::vector<unsigned char> buffer(BGZF_MAX_BLOCK_SIZE * 2);
+    int64_t found = -1;
+    while (found < 0 && coffset < file_size) {
+        fseeko(fp, coffset, SEEK_SET);
+        size_t n = fread(buffer.data(), 1, buffer.size(), fp);
+        if (n < 4) break;
+        for (size_t i = 0; i + 4 <= n; ++i) {
+            if (memcmp(buffer.data() + i, kMagic, 4) != 0) continue;
+            int64_t block_size, next_size;
+            int64_t offset = coffset + i;
+            if (!is_block_start(offset, block_size)) continue;
+            if (offset + block_size == file_size ||
+                is_block_start(offset + block_size, next_size))
+            {
+                found = offset;
+                break;
+            }
+        }
+        coffset += n - 3;
+    }
+
+    fclose(fp);
+    return found;
+}
+
+
+/**
+ * @brief move a BGZF reader forward to the start of the next record.
+ * The line under the current position is skipped since it may be partial.
+ * FASTQ records are recognized as a '@' line followed by a '+' line two
+ * lines later(4-line FASTQ).
+ * 
+ * @return int64_t position of the record(see BgzfPosition), -1 if EOF
+ */
+static
+int64_t BgzfNextRecordStart(BGZF *fp, bool is_fastq)
+{
+    kstring_t line = {0, 0, NULL};
+    int64_t record_start = -1;
+
+    if (bgzf_getline(fp, '\n', &line) >= 0) {
+        // (position, first char) of the last lines
+        std::deque<std::pair<int64_t, char>> lines;
+        int ret;
+        while (true) {
+            int64_t pos = BgzfPosition(fp);
+            if ((ret = bgzf_getline(fp, '\n', &line)) < 0) break;
+            char first = line.l ? line.s[0] : '\0';
+            if (!is_fastq) {
+                if (first == '>') {
+                    record_start = pos;
+                    break;
+                }
+                continue;
+            }
+            lines.emplace_back(pos, first);
+            if (lines.size() == 3) {
+                if (lines[0].second == '@' && lines[2].second == '+') {
+                    record_start = lines[0].first;
+                    break;
+                }
+                lines.pop_front();
+            }
+        }
+
+        if (ret < -1) {
+            std::cerr << "Error! Failed to read input while searching for "
+                << "record boundaries." << std::endl;
+            std::exit(1);
+        }
+    }
+
+    free(line.s);
+    return record_start;
+}
+
+
+/**
+ * @brief copy the raw records in [start, end) of an uncompressed or BGZF
+ * input into the output. end < 0 means end of file.
+ */
+static
+void BgzfCopyRange(const std::string &input, int64_t start, int64_t end,
+    BGZF *out, const std::string &ofilename)
+{
+    BGZF *fp = bgzf_open(input.c_str(), "r");
+    if (fp == NULL) {
+        std::cerr << "Error! Can not open " << input << " for reading"
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (BgzfSeekPosition(fp, start) < 0) {
+        std::cerr << "Error! Can not seek to " << start << " of "
+            << input << std::endl;
+        std::exit(1);
+    }
+
+    std::vector<char> buffer(FASTX_SPLIT_COPY_BUFFER_SIZE);
+    while (true) {
+        int64_t want = buffer.size();
+        if (fp->is_compressed) {
+            // never read across the block holding the end position
+            if (fp->block_offset >= fp->block_length) {
+                if (end >= 0 && bgzf_tell(fp) >= end) break;
+                if (bgzf_read_block(fp) != 0) {
+                    std::cerr << "Error! Failed to read BGZF block of "
+                        << input << std::endl;
+                    std::exit(1);
+                }
+                if (fp->block_length == 0) break;  // EOF
+                continue;
+            }
+            want = fp->block_length - fp->block_offset;
+            if (end >= 0 && fp->block_address == (end >> 16)) {
+                want = std::min(want, (end & 0xFFFF) - fp->block_offset);
+                if (want <= 0) break;
+            }
+        } else if (end >= 0) {
+            want = std::min(want, end - BgzfPosition(fp));
+            if (want <= 0) break;
+        }
+
+        ssize_t n = bgzf_read(fp, buffer.data(), want);
+        if (n < 0) {
+            std::cerr << "Error! Failed to read " << input << std::endl;
+            std::exit(1);
+        }
+        if (n == 0) break;
+
+        if (bgzf_write(out, buffer.data(), n) < 0) {
+            std::cerr << "Error! Failed to write " << ofilename << std::endl;
+            std::exit(1);
+        }
+    }
+
+    bgzf_close(fp);
+}
+
+
+/**
+ * @brief split an uncompressed or BGZF input into parts of roughly equal
+ * size. Cut points are byte(virtual) offsets snapped to record boundaries,
+ * the parts are then copied to the outputs in parallel without parsing.
+ */
+void FastxSplitPartsByOffsets(const std::string &input, int64_t parts,
+    const std::string &prefix, const std::string &suffix, int threads,
+    int compress_level)
+{
+    bool is_fastq = IsFastq(input.c_str());
+    int64_t file_size = fs::file_size(input);
+
+    // boundaries[k] is the start position of part k, -1 means end of file
+    std::vector<int64_t> boundaries(parts + 1, -1);
+    boundaries[0] = 0;
+
+    BGZF *fp = bgzf_open(input.c_str(), "r");
+    if (fp == NULL) {
+        std::cerr << "Error! Can not open " << input << " for reading"
+            << std::endl;
+        std::exit(1);
+    }
+
+    for (int64_t k = 1; k < parts; ++k) {
+        if (boundaries[k-1] < 0) break;
+        int64_t approx = file_size / parts * k;
+        int64_t pos = approx;
+        if (fp->is_compressed) {
+            int64_t coffset = BgzfNextBlockOffset(input, approx);
+            if (coffset < 0) break;
+            pos = coffset << 16;
+        }
+
+        if (BgzfSeekPosition(fp, pos) < 0) {
+            std::cerr << "Error! Can not seek to " << pos << " of "
+                << input << std::endl;
+            std::exit(1);
+        }
+
+        int64_t record_start = BgzfNextRecordStart(fp, is_fastq);
+        if (record_start < 0) break;
+        // parts can only be empty when records are larger than parts
+        boundaries[k] = std::max(record_start, boundaries[k-1]);
+    }
+
+    bgzf_close(fp);
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+
+    std::ostringstream mode_str;
+    mode_str << "w" << compress_level;
+
+    std::atomic<int64_t> next_part(0);
+    auto worker = [&]() {
+        int64_t k;
+        while ((k = next_part++) < parts) {
+            std::ostringstream ofilename;
+            ofilename << prefix << "." << k << "." << suffix;
+            BGZF *out = bgzf_open(ofilename.str().c_str(),
+                mode_str.str().c_str());
+            if (out == NULL) {
+                std::cerr << "Error! Can not open " << ofilename.str()
+                    << " for writing" << std::endl;
+                std::exit(1);
+            }
+            bgzf_thread_pool(out, pool, 0);
+            if (boundaries[k] >= 0) {
+                BgzfCopyRange(input, boundaries[k], boundaries[k+1], out,
+                    ofilename.str());
+            }
+            if (bgzf_close(out) < 0) {
+                std::cerr << "Error! Failed to close " << ofilename.str()
+                    << std::endl;
+                std::exit(1);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    int64_t n_workers = std::min<int64_t>(threads, parts);
+    for (int64_t i = 0; i < n_workers; ++i) {
+        workers.emplace_back(worker);
+    }
+    for (auto &w: workers) w.join();
+
+    hts_tpool_destroy(pool);
+}
+
+
+/**
+ * @brief estimate the number of bases of a fasta/q file. The count sidecar
+ * is used if exists, otherwise the leading records of the file are counted
+ * and scaled by the compressed file size.
+ * 
+ * @return int64_t estimated bases, -1 if the size of input is unknown
+ */
+static
+int64_t EstimateBases(const std::string &filename)
+{
+    int64_t reads, bases;
+    if (LoadCountSidecar(filename, reads, bases)) return bases;
+
+    std::error_code ec;
+    if (!fs::is_regular_file(filename, ec)) return -1;
+    int64_t file_size = fs::file_size(filename);
+
+    gzFile fp = gzopen(filename.c_str(), "r");
+    if (fp == nullptr)
+    {
+        std::perror(("Error! Can not open " + filename).c_str());
+        std::exit(1);
+    }
+
+    kseq_t *read = kseq_init(fp);
+    int64_t ret;
+    reads = 0;
+    bases = 0;
+    while (reads < FASTX_SPLIT_ESTIMATE_READS && (ret = kseq_read(read)) >= 0)
+    {
+        ++reads;
+        bases += read->seq.l;
+    }
+
+    int64_t estimate = bases;
+    if (reads == FASTX_SPLIT_ESTIMATE_READS) {
+        int64_t consumed = gzoffset(fp);
+        if (consumed > 0) {
+            estimate = static_cast<int64_t>(
+                static_cast<double>(bases) * file_size / consumed);
+        }
+    }
+
+    kseq_destroy(read);
+    gzclose(fp);
+    return estimate;
+}
+
+
+/**
+ * @brief split single or paired inputs into parts of roughly equal bases in
+ * one streaming pass. Parts are cut by the (estimated) total bases, if the
+ * input size is unknown(e.g. stdin or pipe) records are dealt round-robin.
+ * 
+ * @param input2 second input file path, empty for single end inputs
+ * @param suffix output suffix, detected from the first record if empty
+ * @param interleaved input1 is interleaved pairs, which are kept together
+ * in interleaved parts
+ */
+void FastxSplitPartsStream(const std::string &input1,
+    const std::string &input2, int64_t parts, const std::string &prefix,
+    std::string suffix, int threads, int compress_level, bool interleaved)
+{
+    bool paired = !input2.empty() || interleaved;
+
+    int64_t total_bases = EstimateBases(input1);
+    if (!input2.empty() && total_bases >= 0) {
+        int64_t bases2 = EstimateBases(input2);
+        total_bases = bases2 < 0 ? -1 : total_bases + bases2;
+    }
+    bool round_robin = total_bases < 0;
+
+    gzFile fp1 = gzopen(input1.c_str(), "r");
+    if (fp1 == nullptr)
+    {
+        std::perror(("Error! Can not open " + input1).c_str());
+        std::exit(1);
+    }
+
+    gzFile fp2 = nullptr;
+    if (!input2.empty()) {
+        fp2 = gzopen(input2.c_str(), "r");
+        if (fp2 == nullptr)
+        {
+            std::perror(("Error! Can not open " + input2).c_str());
+            std::exit(1);
+        }
+    }
+
+    // mates are checked by PairReader
+    std::unique_ptr<SeqReader> reader;
+    std::unique_ptr<PairReader> pair_reader;
+    if (paired) {
+        pair_reader.reset(new PairReader(fp1, fp2));
+    } else {
+        reader.reset(new SeqReader(fp1));
+    }
+    kseq_t *read1 = nullptr;
+    kseq_t *read2 = nullptr;
+    auto next = [&]() {
+        if (pair_reader) return pair_reader->read(&read1, &read2);
+        return (read1 = reader->read()) != nullptr;
+    };
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+
+    std::ostringstream mode_str;
+    mode_str << "w" << compress_level;
+
+    // round-robin needs all parts open, otherwise one part at a time
+    int n_mates = input2.empty() ? 1 : 2;
+    std::vector<std::string> ofilenames(parts * n_mates);
+    std::vector<BGZF *> outputs(parts * n_mates, nullptr);
+    auto open_part = [&](int64_t k) {
+        for (int m = 0; m < n_mates; ++m) {
+            std::ostringstream ofilename;
+            ofilename << prefix << "." << k << ".";
+            if (n_mates == 2) ofilename << "R" << m + 1 << ".";
+            ofilename << suffix;
+            ofilenames[k*n_mates+m] = ofilename.str();
+            BGZF *out = bgzf_open(ofilename.str().c_str(),
+                mode_str.str().c_str());
+            if (out == NULL) {
+                std::cerr << "Error! Can not open " << ofilename.str()
+                    << " for writing" << std::endl;
+                std::exit(1);
+            }
+            bgzf_thread_pool(out, pool, 0);
+            outputs[k*n_mates+m] = out;
+        }
+    };
+    BgzfCloser closer;
+    auto close_part = [&](int64_t k) {
+        for (int m = 0; m < n_mates; ++m) {
+            closer.close(outputs[k*n_mates+m], ofilenames[k*n_mates+m]);
+            outputs[k*n_mates+m] = nullptr;
+        }
+    };
+
+    int64_t part = 0;
+    int64_t reads = 0;
+    int64_t bases = 0;
+    int64_t reads2 = 0;
+    int64_t bases2 = 0;
+    while (next()) {
+        if (reads == 0) {
+            if (suffix.empty()) {
+                suffix = read1->qual.l ? "fastq.gz" : "fasta.gz";
+            }
+            if (round_robin) {
+                for (int64_t k = 0; k < parts; ++k) open_part(k);
+            } else {
+                open_part(0);
+            }
+        }
+
+        int64_t k = part;
+        if (round_robin) {
+            k = reads % parts;
+        } else if (part < parts - 1 &&
+            bases >= total_bases / parts * (part + 1))
+        {
+            // switch to next part, the last part takes the remainder
+            close_part(part);
+            k = ++part;
+            open_part(part);
+        }
+
+        if (BgzfWriteKseq(outputs[k*n_mates], read1) < 0) {
+            std::cerr << "Error! Failed to write read: " << read1->name.s
+                << " to " << ofilenames[k*n_mates] << std::endl;
+            std::exit(1);
+        }
+        ++reads;
+        bases += read1->seq.l;
+
+        if (paired) {
+            int m = n_mates - 1;
+            if (BgzfWriteKseq(outputs[k*n_mates+m], read2) < 0) {
+                std::cerr << "Error! Failed to write read: " << read2->name.s
+                    << " to " << ofilenames[k*n_mates+m] << std::endl;
+                std::exit(1);
+            }
+            ++reads2;
+            bases2 += read2->seq.l;
+            bases += read2->seq.l;
+        }
+    }
+
+    // make sure all of the N outputs exist
+    if (suffix.empty()) suffix = "fasta.gz";
+    for (int64_t k = 0; k < parts; ++k) {
+        if (outputs[k*n_mates] == nullptr && (k > part || reads == 0)) {
+            open_part(k);
+        }
+        if (outputs[k*n_mates] != nullptr) close_part(k);
+    }
+
+    closer.wait();
+    hts_tpool_destroy(pool);
+    // stop the reader threads before closing the inputs
+    reader.reset();
+    pair_reader.reset();
+    gzclose(fp1);
+    if (fp2) gzclose(fp2);
+
+    // exact counts for the next run
+    std::error_code ec;
+    if (fs::is_regular_file(input1, ec)) {
+        if (interleaved) {
+            SaveCountSidecar(input1, reads * 2, bases);
+        } else {
+            SaveCountSidecar(input1, reads, bases - bases2);
+        }
+    }
+    if (!input2.empty() && fs::is_regular_file(input2, ec)) {
+        SaveCountSidecar(input2, reads2, bases2);
+    }
+}
+
+
+// flush the buffer of a key when it reaches this size(about one BGZF block)
+const size_t FASTX_SPLIT_KEY_BUFFER_SIZE = 64 * 1024;
+
+// flush all key buffers when the total buffered bytes reach this size
+const size_t FASTX_SPLIT_KEY_BUFFER_MEMORY = 256 * 1024 * 1024;
+
+
+enum class SplitKey {
+    kNone,
+    kBarcode,
+    kLane,
+    kTile,
+    kLengthBin,
+    kNameRegex
+};
+
+
+static
+SplitKey ParseSplitKey(const std::string &by)
+{
+    if (by == "barcode") return SplitKey::kBarcode;
+    if (by == "lane") return SplitKey::kLane;
+    if (by == "tile") return SplitKey::kTile;
+    if (by == "length-bin") return SplitKey::kLengthBin;
+    if (by == "name-regex") return SplitKey::kNameRegex;
+    std::cerr << "Error! Unrecognized split key " << by << ", must be one of "
+        << "barcode, lane, tile, length-bin or name-regex." << std::endl;
+    std::exit(1);
+}
+
+
+/**
+ * @brief get the index barcode of an Illumina read. Looks for a BC:Z: tag
+ * in the comment, then the last field of a CASAVA 1.8 comment
+ * (1:N:0:ACGTACGT), then the old style name suffix (name#ACGT/1).
+ */
+static
+std::string IlluminaBarcode(const kseq_t *read)
 {
-    bool split_by_base = false;
-    if (n_read_per_chunk <= 0) {
-        if (n_base_per_chunk > 0) {
-            split_by_base = true;
-        } else {
-            std::cerr << "Error! Must input a least one of "
-                << "bases(-b, --bases) or reads(-r, --reads)"
-                << std::endl;
-            std::exit(1);
-        }
+    std::string comment(read->comment.s ? read->comment.s : "",
+        read->comment.l);
+    size_t i = comment.find("BC:Z:");
+    if (i != std::string::npos) {
+        i += 5;
+        return comment.substr(i, comment.find_first_of(" \t", i) - i);
     }
 
-    gzFile fp = gzopen(ifilename.c_str(), "r");
+    std::string first = comment.substr(0, comment.find_first_of(" \t"));
+    if (std::count(first.begin(), first.end(), ':') == 3) {
+        return first.substr(first.rfind(':') + 1);
+    }
 
-    kseq_t *read = kseq_init(fp);
+    std::string name(read->name.s, read->name.l);
+    i = name.rfind('#');
+    if (i != std::string::npos) {
+        ++i;
+        return name.substr(i, name.find('/', i) - i);
+    }
 
-    int ret1, ret2;
-    int64_t read_count = 0;
-    int64_t base_count = 0;
-    bool open_new = false;
-    int64_t n = 0;
+    return "";
+}
 
-    std::ostringstream ofilename;
-    ofilename << prefix << "." << n << "." << suffix;
-    hts_tpool *pool = hts_tpool_init(threads);
-    if (pool == NULL) {
-        std::cerr << "Error! hts_tpool_init can not init thread pool "
-            << std::endl;
-        std::exit(1);
-    }
 
-    std::ostringstream mode_str;
-    mode_str << "w" << compress_level;
-    BGZF* bgzfp = bgzf_open(ofilename.str().c_str(), mode_str.str().c_str());
-    if (bgzfp == NULL) {
-        std::cerr << "Error! Can not open " << ofilename.str()
-            << " for writing" << std::endl;
-        std::exit(1);
+/**
+ * @brief get a colon separated field of an Illumina read name. CASAVA 1.8
+ * names have 7 fields(instrument:run:flowcell:lane:tile:x:y), old style
+ * names have 5 fields(instrument:lane:tile:x:y#index/1).
+ * 
+ * @param tile false for lane, true for tile
+ */
+static
+std::string IlluminaNameField(const kseq_t *read, bool tile)
+{
+    std::string name(read->name.s, read->name.l);
+    std::vector<std::string> fields;
+    size_t i = 0;
+    size_t j;
+    while ((j = name.find(':', i)) != std::string::npos) {
+        fields.push_back(name.substr(i, j - i));
+        i = j + 1;
     }
-    bgzf_thread_pool(bgzfp, pool, 0);
+    fields.push_back(name.substr(i));
 
-    while ((ret1 = kseq_read(read)) >= 0)
+    if (fields.size() >= 7) return fields[tile ? 4 : 3];
+    if (fields.size() == 5) return fields[tile ? 2 : 1];
+    return "";
+}
+
+
+/**
+ * @brief buffered writers of many keyed outputs. Records are appended to a
+ * per-key buffer, a buffer is written only when it is full, so that each
+ * write to the BGZF writer is a large batch. At most max_open writers are
+ * kept open, the least recently used writer is closed(in background) when
+ * another key needs one, it is reopened in append mode later.
+ */
+class KeyedBgzfWriter {
+public:
+    KeyedBgzfWriter(const std::string &prefix, const std::string &suffix,
+        int n_mates, int max_open, int compress_level, hts_tpool *pool):
+        prefix_(prefix), suffix_(suffix), n_mates_(n_mates),
+        max_open_(max_open), pool_(pool)
     {
-        if (!open_new) {
-            ret2 = BgzfWriteKseq(bgzfp, read);
-            if (ret2 < 0) {
-                std::cerr << "Error! Failed to write read: "
-                    << read->name.s << " to " << ofilename.str() << std::endl;
-                std::exit(1);
+        std::ostringstream mode_str;
+        mode_str << compress_level;
+        level_ = mode_str.str();
+    }
+
+    ~KeyedBgzfWriter() {
+        close();
+    }
+
+    int write(const std::string &key, const kseq_t *read, int mate = 0) {
+        auto iter = outputs_.find(key);
+        if (iter == outputs_.end()) {
+            iter = outputs_.emplace(key, Output()).first;
+            iter->second.lru = lru_.end();
+            for (int m = 0; m < n_mates_; ++m) {
+                std::ostringstream ofilename;
+                ofilename << prefix_ << "." << SafeKey(key) << ".";
+                if (n_mates_ == 2) ofilename << "R" << m + 1 << ".";
+                ofilename << suffix_;
+                iter->second.filenames.push_back(ofilename.str());
+                iter->second.fps.push_back(nullptr);
+                iter->second.buffers.push_back(kstring_t{0, 0, NULL});
             }
-            if (split_by_base) {
-                base_count += read->seq.l;
-                if (base_count >= n_base_per_chunk) open_new = true;
-            } else {
-                ++read_count;
-                if (read_count >= n_read_per_chunk) open_new = true;
+        }
+
+        Output &output = iter->second;
+        kstring_t *buffer = &output.buffers[mate];
+        size_t l = buffer->l;
+        if (KstringAppendKseq(buffer, read) < 0) return -1;
+        buffered_ += buffer->l - l;
+
+        if (buffer->l >= FASTX_SPLIT_KEY_BUFFER_SIZE) {
+            if (Flush(output) < 0) return -1;
+        }
+
+        if (buffered_ >= FASTX_SPLIT_KEY_BUFFER_MEMORY) {
+            for (auto &o: outputs_) {
+                if (Flush(o.second) < 0) return -1;
             }
-        } else {
-            ++n;
-            ofilename.str("");   // clear
-            bgzf_close(bgzfp);
-            ofilename << prefix << "." << n << "." << suffix;
-            bgzfp = bgzf_open(ofilename.str().c_str(), mode_str.str().c_str());
-            if (bgzfp == NULL) {
-                std::cerr << "Error! Can not open "
-                    << ofilename.str() << " for writing" << std::endl;
+        }
+
+        return 0;
+    }
+
+    // flush all buffers and close all writers
+    void close() {
+        for (auto &o: outputs_) {
+            if (Flush(o.second) < 0) {
+                std::cerr << "Error! Failed to write "
+                    << o.second.filenames[0] << std::endl;
                 std::exit(1);
             }
+        }
+        while (!lru_.empty()) Evict();
+        closer_.wait();
+        for (auto &o: outputs_) {
+            for (auto &b: o.second.buffers) free(b.s);
+        }
+        outputs_.clear();
+    }
 
-            bgzf_thread_pool(bgzfp, pool, 0);
+private:
+    struct Output {
+        std::vector<std::string> filenames;
+        std::vector<BGZF *> fps;
+        std::vector<kstring_t> buffers;
+        bool created = false;
+        std::list<Output *>::iterator lru;
+    };
 
-            ret2 = BgzfWriteKseq(bgzfp, read);
-            if (ret2 < 0) {
-                std::cerr << "Error! Failed to write read: "
-                    << read->name.s << " to " << ofilename.str() << std::endl;
-                std::exit(1);
+    static std::string SafeKey(const std::string &key) {
+        if (key.empty()) return "unknown";
+        std::string safe = key;
+        for (auto &c: safe) {
+            if (!isalnum(c) && c != '-' && c != '_' && c != '+') c = '_';
+        }
+        return safe;
+    }
+
+    int Flush(Output &output) {
+        bool empty = true;
+        for (auto &b: output.buffers) empty = empty && b.l == 0;
+        if (empty) return 0;
+
+        Open(output);
+        for (int m = 0; m < n_mates_; ++m) {
+            kstring_t *buffer = &output.buffers[m];
+            if (buffer->l == 0) continue;
+            if (bgzf_write(output.fps[m], buffer->s, buffer->l) < 0) {
+                return -1;
             }
+            buffered_ -= buffer->l;
+            buffer->l = 0;
+        }
+        return 0;
+    }
 
-            if (split_by_base) {
-                base_count = 0;
-                base_count += read->seq.l;
-                if (base_count < n_base_per_chunk) open_new = false;
-            } else {
-                read_count = 0;
-                ++read_count;
-                if (read_count < n_read_per_chunk) open_new = false;
+    void Open(Output &output) {
+        if (output.lru != lru_.end()) {
+            // most recently used goes to front
+            lru_.splice(lru_.begin(), lru_, output.lru);
+            return;
+        }
+
+        if (static_cast<int>(lru_.size()) >= max_open_) Evict();
+
+        // the writer of this key may still be closing in background
+        if (output.created) closer_.wait();
+
+        std::string mode = (output.created ? "a" : "w") + level_;
+        for (int m = 0; m < n_mates_; ++m) {
+            BGZF *fp = bgzf_open(output.filenames[m].c_str(), mode.c_str());
+            if (fp == NULL) {
+                std::cerr << "Error! Can not open " << output.filenames[m]
+                    << " for writing" << std::endl;
+                std::exit(1);
             }
+            bgzf_thread_pool(fp, pool_, 0);
+            output.fps[m] = fp;
         }
+        output.created = true;
+        lru_.push_front(&output);
+        output.lru = lru_.begin();
     }
 
-    if (ret1 == -2) {
-        std::cerr << "Error! Input fastq file quality is truncated "
-            << ifilename << std::endl;
-        std::exit(1);
-    } else if (ret1 == -3) {
-        std::cerr << "Error! Input fastq file stream error!"
-            << ifilename << std::endl;
-        std::exit(1);
+    void Evict() {
+        Output *output = lru_.back();
+        lru_.pop_back();
+        output->lru = lru_.end();
+        for (int m = 0; m < n_mates_; ++m) {
+            closer_.close(output->fps[m], output->filenames[m]);
+            output->fps[m] = nullptr;
+        }
     }
 
-    bgzf_close(bgzfp);
-    hts_tpool_destroy(pool);
-    kseq_destroy(read);
-    gzclose(fp);
-}
+    std::string prefix_;
+    std::string suffix_;
+    int n_mates_;
+    int max_open_;
+    std::string level_;
+    hts_tpool *pool_;
+    size_t buffered_ = 0;
+    std::unordered_map<std::string, Output> outputs_;
+    std::list<Output *> lru_;
+    BgzfCloser closer_;
+};
+
 
 /**
- * @brief split paired end fastq/fasta by number of bases
+ * @brief split single or paired inputs into one output per key, the key
+ * of a read pair is extracted from read1.
  * 
- * @param input1 first input fastq/fasta file path
- * @param input2 second input fastq/fasta file path
- * @param n_base_per_chunk number of bases per chunk
- * @param prefix output prefix
- * @param suffix output suffix
- * @param threads number of threads
- * @param compress_level compress level
+ * @param input2 second input file path, empty for single end inputs
+ * @param interleaved input1 is interleaved pairs, written interleaved
+ * @param by key type
+ * @param bin_size length bin size for SplitKey::kLengthBin
+ * @param regex name regex for SplitKey::kNameRegex, the first capture group
+ * (or the whole match if no group) is the key
+ * @param max_open max number of open output files
  */
-void FastxSplitReadsByBasesPair(
-    const std::string &input1, const std::string &input2,
-    int64_t n_base_per_chunk, const std::string &prefix,
-    const std::string &suffix, int threads, int compress_level)
+void FastxSplitByKey(const std::string &input1, const std::string &input2,
+    SplitKey by, int64_t bin_size, const std::string &regex, int max_open,
+    const std::string &prefix, const std::string &suffix, int threads,
+    int compress_level, bool interleaved)
 {
-    gzFile fp1 = gzopen(input1.c_str(), "r");
-    gzFile fp2 = gzopen(input2.c_str(), "r");
+    bool paired = !input2.empty() || interleaved;
+
+    std::regex name_regex;
+    if (by == SplitKey::kNameRegex) {
+        try {
+            name_regex = std::regex(regex, std::regex::optimize);
+        } catch (const std::regex_error &e) {
+            std::cerr << "Error! Invalid name regex " << regex << ": "
+                << e.what() << std::endl;
+            std::exit(1);
+        }
+    }
 
-    SeqReader reader1 = SeqReader(fp1);
-    SeqReader reader2 = SeqReader(fp2);
+    gzFile fp1 = gzopen(input1.c_str(), "r");
+    if (fp1 == nullptr)
+    {
+        std::perror(("Error! Can not open " + input1).c_str());
+        std::exit(1);
+    }
 
-    int64_t base_count = 0;
-    bool open_new = false;
-    int64_t n = 0;
+    gzFile fp2 = nullptr;
+    if (!input2.empty()) {
+        fp2 = gzopen(input2.c_str(), "r");
+        if (fp2 == nullptr)
+        {
+            std::perror(("Error! Can not open " + input2).c_str());
+            std::exit(1);
+        }
+    }
 
-    std::ostringstream ofilename1;
-    ofilename1 << prefix << "." << n << ".R1." << suffix;
-    std::ostringstream ofilename2;
-    ofilename2 << prefix << "." << n << ".R2." << suffix;
+    // mates are checked by PairReader
+    std::unique_ptr<SeqReader> reader;
+    std::unique_ptr<PairReader> pair_reader;
+    if (paired) {
+        pair_reader.reset(new PairReader(fp1, fp2));
+    } else {
+        reader.reset(new SeqReader(fp1));
+    }
+    kseq_t *read1 = nullptr;
+    kseq_t *read2 = nullptr;
+    auto next = [&]() {
+        if (pair_reader) return pair_reader->read(&read1, &read2);
+        return (read1 = reader->read()) != nullptr;
+    };
 
     hts_tpool *pool = hts_tpool_init(threads);
     if (pool == NULL) {
@@ -164,109 +1300,71 @@ void FastxSplitReadsByBasesPair(
         std::exit(1);
     }
 
-    std::ostringstream mode_str;
-    mode_str << "w" << compress_level;
-    BGZF* bgzfp1 = bgzf_open(ofilename1.str().c_str(), mode_str.str().c_str());
-    if (bgzfp1 == NULL) {
-        std::cerr << "Error! Can not open "
-            << ofilename1.str() << " for writing" << std::endl;
-        std::exit(1);
-    }
-
-    BGZF* bgzfp2 = bgzf_open(ofilename2.str().c_str(), mode_str.str().c_str());
-    if (bgzfp2 == NULL) {
-        std::cerr << "Error! Can not open "
-            << ofilename2.str() << " for writing" << std::endl;
-        std::exit(1);
-    }
-
-
-    bgzf_thread_pool(bgzfp1, pool, 0);
-    bgzf_thread_pool(bgzfp2, pool, 0);
+    int n_mates = input2.empty() ? 1 : 2;
+    KeyedBgzfWriter *writer = new KeyedBgzfWriter(prefix, suffix,
+        n_mates, max_open, compress_level, pool);
 
-    int ret;
-    kseq_t *read1 = nullptr;
-    kseq_t *read2 = nullptr;
-    while ((read1 = reader1.read()) != nullptr &&
-        (read2 = reader2.read()) != nullptr)
-    {
-        if (!open_new) {
-            ret = BgzfWriteKseq(bgzfp1, read1);
-            if (ret < 0) {
-                std::cerr << "Error! Failed to write read1: "
-                    << read1->name.s << " to " << ofilename1.str() << std::endl;
-                std::exit(1);
-            }
-            ret = BgzfWriteKseq(bgzfp2, read2);
-            if (ret < 0) {
-                std::cerr << "Error! Failed to write read2: "
-                    << read2->name.s << " to " << ofilename2.str() << std::endl;
-                std::exit(1);
-            }
-            base_count += read1->seq.l;
-            base_count += read2->seq.l;
-            if (base_count >= n_base_per_chunk) {
-                open_new = true;
-            }
-        } else {
-            ++n;
-            ofilename1.str("");   // clear
-            ofilename2.str("");   // clear
-            bgzf_close(bgzfp1);
-            bgzf_close(bgzfp2);
-            ofilename1 << prefix << "." << n << ".R1." << suffix;
-            ofilename2 << prefix << "." << n << ".R2." << suffix;
-            
-            bgzfp1 = bgzf_open(ofilename1.str().c_str(),
-                mode_str.str().c_str());
-            if (bgzfp1 == NULL) {
-                std::cerr << "Error! Can not open "
-                    << ofilename1.str() << " for writing" << std::endl;
-                std::exit(1);
+    std::string key;
+    std::cmatch match;
+    while (next()) {
+        switch (by) {
+            case SplitKey::kBarcode:
+                key = IlluminaBarcode(read1);
+                break;
+            case SplitKey::kLane:
+                key = IlluminaNameField(read1, false);
+                break;
+            case SplitKey::kTile:
+                key = IlluminaNameField(read1, true);
+                break;
+            case SplitKey::kLengthBin: {
+                int64_t bin = read1->seq.l / bin_size * bin_size;
+                key = std::to_string(bin) + "-" +
+                    std::to_string(bin + bin_size - 1);
+                break;
             }
-
-            bgzfp2 = bgzf_open(ofilename2.str().c_str(),
-                mode_str.str().c_str());
-            if (bgzfp2 == NULL) {
-                std::cerr << "Error! Can not open "
-                    << ofilename2.str() << " for writing" << std::endl;
-                std::exit(1);
+            case SplitKey::kNameRegex: {
+                const char *name = read1->name.s;
+                if (std::regex_search(name, name + read1->name.l, match,
+                    name_regex))
+                {
+                    key = match.size() > 1 ? match[1].str() : match[0].str();
+                } else {
+                    key = "";
+                }
+                break;
             }
-            
-            bgzf_thread_pool(bgzfp1, pool, 0);
-            bgzf_thread_pool(bgzfp2, pool, 0);
+            case SplitKey::kNone:
+                break;
+        }
 
-            ret = BgzfWriteKseq(bgzfp1, read1);
-            if (ret < 0) {
-                std::cerr << "Error! Failed to write read1: "
-                    << read1->name.s << " to " << ofilename1.str() << std::endl;
-                std::exit(1);
-            }
-            ret = BgzfWriteKseq(bgzfp2, read2);
-            if (ret < 0) {
-                std::cerr << "Error! Failed to write read2: "
-                    << read2->name.s << " to " << ofilename2.str() << std::endl;
-                std::exit(1);
-            }
-            
-            base_count = 0;
-            base_count += read1->seq.l;
-            base_count += read2->seq.l;
-            if (base_count < n_base_per_chunk) {
-                open_new = false;
-            }
+        if (writer->write(key, read1, 0) < 0) {
+            std::cerr << "Error! Failed to write read: " << read1->name.s
+                << std::endl;
+            std::exit(1);
+        }
+        if (paired && writer->write(key, read2, n_mates - 1) < 0) {
+            std::cerr << "Error! Failed to write read: " << read2->name.s
+                << std::endl;
+            std::exit(1);
         }
     }
 
-
-    bgzf_close(bgzfp1);
-    bgzf_close(bgzfp2);
+    // close all writers before the pool
+    delete writer;
     hts_tpool_destroy(pool);
+    // stop the reader threads before closing the inputs
+    reader.reset();
+    pair_reader.reset();
     gzclose(fp1);
-    gzclose(fp2);
+    if (fp2) gzclose(fp2);
 }
 
 
+// long only options
+const int FASTX_SPLIT_OPT_INTERLEAVED = 256;
+
+
 static
 void Usage() {
     std::cerr << "fastx split " << FASTX_VERSION << std::endl;
@@ -277,9 +1375,31 @@ void Usage() {
             << "Options:\n"
             << "  -i, --in1, FILE             input fasta/fastq file name for read1.\n"
             << "  -I, --in2, FILE             input fasta/fastq file name for read2(optional).\n"
+            << "      --interleaved           input1 is interleaved pairs, which are split into\n"
+            << "                              interleaved outputs.\n"
             << "  -p, --prefix, STR           output fasta/fastq file name prefix.\n"
             << "  -b, --bases, STR            put this value of bases per output file(K/M/G).\n"
             << "  -n, --reads, STR            put this value of reads per output file(K/M/G).\n"
+            << "  -P, --parts, INT            split into this number of output files with\n"
+            << "                              roughly equal bases, no prior count needed.\n"
+            << "                              uncompressed/BGZF inputs are cut at record\n"
+            << "                              boundaries and copied in parallel, gzip inputs\n"
+            << "                              use <input>.count or a size estimate, unknown\n"
+            << "                              size inputs(e.g. pipes) are dealt round-robin.\n"
+            << "  -k, --by, STR               put reads of the same key into one output file,\n"
+            << "                              key is one of barcode, lane, tile(of Illumina\n"
+            << "                              reads), length-bin or name-regex.\n"
+            << "  -L, --bin-size, INT         length bin size for --by length-bin.[100]\n"
+            << "  -e, --regex, STR            name regex for --by name-regex, the first\n"
+            << "                              capture group(or whole match) is the key.\n"
+            << "  -m, --max-open, INT         max number of open output files for --by.[64]\n"
+            << "  -x, --exec, STR             pipe each chunk of -n/-b to the stdin of this\n"
+            << "                              command(run by sh -c) instead of a file, {} and\n"
+            << "                              $FASTX_CHUNK are the chunk number. paired\n"
+            << "                              chunks are interleaved.\n"
+            << "  -j, --jobs, INT             max number of running commands of --exec.[4]\n"
+            << "  -f, --fifo                  create the chunks of -n/-b as named FIFOs.\n"
+            << "  -u, --uncompressed          write the chunks of -n/-b uncompressed.\n"
             << "  -l, --level, INT            compression level(0 to 9, or 11).[6]\n"
             << "  -t, --thread, INT           number of threads.[4]\n"
             << "  -h, --help                  print this message and exit.\n"
@@ -302,22 +1422,40 @@ int FastxSplitMain(int argc, char **argv)
             {"prefix", required_argument, 0, 'p'},
             {"bases", required_argument, 0, 'b'},
             {"reads", required_argument, 0, 'n'},
+            {"parts", required_argument, 0, 'P'},
+            {"by", required_argument, 0, 'k'},
+            {"bin-size", required_argument, 0, 'L'},
+            {"regex", required_argument, 0, 'e'},
+            {"max-open", required_argument, 0, 'm'},
+            {"exec", required_argument, 0, 'x'},
+            {"jobs", required_argument, 0, 'j'},
+            {"fifo", no_argument, 0, 'f'},
+            {"uncompressed", no_argument, 0, 'u'},
             {"level", required_argument, 0, 'l'},
             {"thread", required_argument, 0, 't'},
             {"help", no_argument, 0, 'h'},
-            {"version", no_argument, 0, 'V'}
+            {"version", no_argument, 0, 'V'},
+            {"interleaved", no_argument, 0, FASTX_SPLIT_OPT_INTERLEAVED},
+            {0, 0, 0, 0}
     };
 
     int c, long_idx;
-    const char *opt_str = "i:I:p:b:n:l:t:hV";
+    const char *opt_str = "i:I:p:b:n:P:k:L:e:m:x:j:ful:t:hV";
 
     std::string input1 = "";
     std::string input2 = "";
     std::string prefix = "";
     int64_t bases = -1;
     int64_t reads = -1;
+    int64_t parts = -1;
+    SplitKey by = SplitKey::kNone;
+    int64_t bin_size = 100;
+    std::string regex;
+    int max_open = 64;
+    ChunkSinkOptions sink_options;
     int compress_level = 6;
     int num_threads = 4;
+    bool interleaved = false;
 
     while ((c = getopt_long(
         argc, argv, opt_str, long_options, &long_idx)) != -1)
@@ -350,12 +1488,66 @@ int FastxSplitMain(int argc, char **argv)
                     std::exit(1);
                 }
                 break;
+            case 'P':
+                parts = SafeStrtol(optarg, 10);
+                if (parts <= 0)
+                {
+                    std::cerr << "Error! input parts must be positive!"
+                        << std::endl;
+                    std::exit(1);
+                }
+                break;
+            case 'k':
+                by = ParseSplitKey(optarg);
+                break;
+            case 'L':
+                bin_size = KmgStrToInt(optarg);
+                if (bin_size <= 0)
+                {
+                    std::cerr << "Error! input bin size must be positive!"
+                        << std::endl;
+                    std::exit(1);
+                }
+                break;
+            case 'e':
+                regex = optarg;
+                break;
+            case 'm':
+                max_open = SafeStrtol(optarg, 10);
+                if (max_open <= 0)
+                {
+                    std::cerr << "Error! max open files must be positive!"
+                        << std::endl;
+                    std::exit(1);
+                }
+                break;
+            case 'x':
+                sink_options.exec = optarg;
+                break;
+            case 'j':
+                sink_options.max_jobs = SafeStrtol(optarg, 10);
+                if (sink_options.max_jobs <= 0)
+                {
+                    std::cerr << "Error! number of jobs must be positive!"
+                        << std::endl;
+                    std::exit(1);
+                }
+                break;
+            case 'f':
+                sink_options.fifo = true;
+                break;
+            case 'u':
+                sink_options.uncompressed = true;
+                break;
             case 'l':
                 compress_level = SafeStrtol(optarg, 10);
                 break;
             case 't':
                 num_threads = SafeStrtol(optarg, 10);
                 break;
+            case FASTX_SPLIT_OPT_INTERLEAVED:
+                interleaved = true;
+                break;
             case 'h':
                 Usage();
                 return 0;
@@ -380,20 +1572,49 @@ int FastxSplitMain(int argc, char **argv)
         std::exit(1);
     }
 
-    if (bases <= 0 && reads <= 0)
+    if (interleaved && !input2.empty()) {
+        std::cerr << "Error! -I(--in2) can not be used with --interleaved."
+            << std::endl;
+        std::exit(1);
+    }
+
+    bool split_by_key = by != SplitKey::kNone;
+    if (bases <= 0 && reads <= 0 && parts <= 0 && !split_by_key)
     {
         std::cerr << "Error! Must input a least one of "
-            << "bases(-b, --bases) or reads(-r, --reads)"
-            << std::endl;
+            << "bases(-b, --bases), reads(-r, --reads), parts(-P, --parts) "
+            << "or key(-k, --by)" << std::endl;
+        std::exit(1);
+    }
+
+    if ((bases > 0) + (reads > 0) + (parts > 0) + split_by_key > 1) {
+        std::cerr << "Error! bases(-b, --bases), reads(-r, --reads), "
+            << "parts(-P, --parts) and key(-k, --by) are conflict with "
+            << "each other." << std::endl;
         std::exit(1);
     }
 
-    if (bases > 0 && reads > 0) {
-        std::cerr << "Error! bases(-b, --bases) is conflict with "
+    bool to_sink = !sink_options.exec.empty() || sink_options.fifo ||
+        sink_options.uncompressed;
+    if (to_sink && (parts > 0 || split_by_key)) {
+        std::cerr << "Error! -x(--exec), -f(--fifo) and -u(--uncompressed) "
+            << "can only be used with bases(-b, --bases) or "
             << "reads(-r, --reads)." << std::endl;
         std::exit(1);
     }
 
+    if (!sink_options.exec.empty() && sink_options.fifo) {
+        std::cerr << "Error! -x(--exec) is conflict with -f(--fifo)."
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (by == SplitKey::kNameRegex && regex.empty()) {
+        std::cerr << "Error! Must set the name regex using -e(--regex) for "
+            << "--by name-regex." << std::endl;
+        std::exit(1);
+    }
+
     if (compress_level < 0) {
         std::cerr << "Error! Compression level must be greater than or equal to"
             << " 0" << std::endl;
@@ -408,13 +1629,44 @@ int FastxSplitMain(int argc, char **argv)
     
     if (input2.empty()) {
         // single end reads
+        InputType input_type = DetectInputType(input1);
+        if (parts > 0 && input_type == InputType::kStream) {
+            // do not consume the stream for format detection
+            FastxSplitPartsStream(input1, "", parts, prefix, "",
+                num_threads, compress_level, interleaved);
+            return 0;
+        }
+
         bool input1_is_fq = IsFastq(input1.c_str());
         std::string input1_suffix = "fastq.gz";
         if (!input1_is_fq) {
             input1_suffix = "fasta.gz";
         }
-        FastxSplitReads(input1, reads, bases, prefix, input1_suffix,
-            num_threads, compress_level);
+        if (sink_options.uncompressed) {
+            input1_suffix = input1_is_fq ? "fastq" : "fasta";
+        }
+        if (split_by_key) {
+            FastxSplitByKey(input1, "", by, bin_size, regex, max_open,
+                prefix, input1_suffix, num_threads, compress_level,
+                interleaved);
+        } else if (parts > 0) {
+            // offsets may cut between the mates of interleaved pairs
+            if (!interleaved && (input_type == InputType::kUncompressed ||
+                input_type == InputType::kBgzf))
+            {
+                FastxSplitPartsByOffsets(input1, parts, prefix,
+                    input1_suffix, num_threads, compress_level);
+            } else {
+                FastxSplitPartsStream(input1, "", parts, prefix,
+                    input1_suffix, num_threads, compress_level, interleaved);
+            }
+        } else if (interleaved) {
+            FastxSplitReadsPair(input1, "", reads, bases, prefix,
+                input1_suffix, num_threads, compress_level, sink_options);
+        } else {
+            FastxSplitReads(input1, reads, bases, prefix, input1_suffix,
+                num_threads, compress_level, sink_options);
+        }
     } else {
         // paired end reads
         bool input1_is_fq = IsFastq(input1.c_str());
@@ -434,14 +1686,20 @@ int FastxSplitMain(int argc, char **argv)
             std::exit(1);
         }
 
-        if (reads > 0) {
-            FastxSplitReads(input1, reads, bases, prefix, "R1."+input1_suffix,
-                num_threads, compress_level);
-            FastxSplitReads(input2, reads, bases, prefix, "R2."+input2_suffix,
-                num_threads, compress_level);
+        if (sink_options.uncompressed) {
+            input1_suffix = input1_is_fq ? "fastq" : "fasta";
+        }
+
+        if (split_by_key) {
+            FastxSplitByKey(input1, input2, by, bin_size, regex, max_open,
+                prefix, input1_suffix, num_threads, compress_level, false);
+        } else if (parts > 0) {
+            // mates can not be cut by offsets independently
+            FastxSplitPartsStream(input1, input2, parts, prefix,
+                input1_suffix, num_threads, compress_level, false);
         } else {
-            FastxSplitReadsByBasesPair(input1, input2, bases, prefix,
-                input1_suffix, num_threads, compress_level);
+            FastxSplitReadsPair(input1, input2, reads, bases, prefix,
+                input1_suffix, num_threads, compress_level, sink_options);
         }
     }
 
@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "zlib.h"
+#include "composition.hpp"
+#include "fastx_stats.hpp"
+#include "kseq_utils.hpp"
+#include "seq_reader.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+// max phred quality of phred+33 characters('~')
+const int FASTX_STATS_MAX_QUAL = 93;
+
+// positions below this have their own quality histogram, later positions of
+// long reads are binned
+const size_t FASTX_STATS_EXACT_POSITIONS = 1024;
+
+// position bins per doubling of position after FASTX_STATS_EXACT_POSITIONS
+const size_t FASTX_STATS_BINS_PER_OCTAVE = 128;
+
+
+/**
+ * @brief quality histogram bin of a 0-based position. Bins after
+ * FASTX_STATS_EXACT_POSITIONS double in width with each doubling of position,
+ * so the histogram of a read grows with the log of its length.
+ */
+static
+size_t PositionBin(size_t pos) {
+    if (pos < FASTX_STATS_EXACT_POSITIONS) return pos;
+    int octave = 63 - __builtin_clzll(pos / FASTX_STATS_EXACT_POSITIONS);
+    size_t octave_start = FASTX_STATS_EXACT_POSITIONS << octave;
+    size_t width = octave_start / FASTX_STATS_BINS_PER_OCTAVE;
+    return FASTX_STATS_EXACT_POSITIONS + octave * FASTX_STATS_BINS_PER_OCTAVE +
+        (pos - octave_start) / width;
+}
+
+
+/**
+ * @brief 0-based closed range of positions in a bin of PositionBin
+ */
+static
+void PositionBinRange(size_t bin, size_t *first, size_t *last) {
+    if (bin < FASTX_STATS_EXACT_POSITIONS) {
+        *first = *last = bin;
+        return;
+    }
+    size_t octave = (bin - FASTX_STATS_EXACT_POSITIONS) /
+        FASTX_STATS_BINS_PER_OCTAVE;
+    size_t k = (bin - FASTX_STATS_EXACT_POSITIONS) %
+        FASTX_STATS_BINS_PER_OCTAVE;
+    size_t octave_start = FASTX_STATS_EXACT_POSITIONS << octave;
+    size_t width = octave_start / FASTX_STATS_BINS_PER_OCTAVE;
+    *first = octave_start + k * width;
+    *last = *first + width - 1;
+}
+
+
+/**
+ * @brief statistics of reads, each worker fills its own and they are merged
+ * at the end.
+ */
+struct SeqStats {
+    uint64_t reads = 0;
+    uint64_t bases = 0;
+    int64_t min_len = std::numeric_limits<int64_t>::max();
+    int64_t max_len = 0;
+    // number of reads by length, for N50/N90
+    std::unordered_map<int64_t, uint64_t> lengths;
+    BaseCounts base_counts;
+    QualCounts qual_counts;
+    // bases with quality
+    uint64_t qual_bases = 0;
+    bool has_qual = false;
+    // per position quality histogram, PositionBin(position) *
+    // (FASTX_STATS_MAX_QUAL + 1) + quality, filled only if requested
+    std::vector<uint64_t> qual_hist;
+
+    void add(const kseq_t *seq, bool with_qual_hist) {
+        int64_t len = seq->seq.l;
+        ++reads;
+        bases += len;
+        min_len = std::min(min_len, len);
+        max_len = std::max(max_len, len);
+        ++lengths[len];
+        CountBases(seq->seq.s, seq->seq.l, &base_counts);
+
+        if (!seq->is_fastq) return;
+        has_qual = true;
+        qual_bases += seq->qual.l;
+        CountQuals(seq->qual.s, seq->qual.l, &qual_counts);
+
+        if (!with_qual_hist || seq->qual.l == 0) return;
+        const size_t stride = FASTX_STATS_MAX_QUAL + 1;
+        size_t n_bins = PositionBin(seq->qual.l - 1) + 1;
+        if (qual_hist.size() < n_bins * stride) {
+            qual_hist.resize(n_bins * stride, 0);
+        }
+        size_t i = 0;
+        for (size_t bin = 0; bin < n_bins; ++bin) {
+            size_t first, last;
+            PositionBinRange(bin, &first, &last);
+            size_t end = std::min(last + 1, seq->qual.l);
+            uint64_t *hist = &qual_hist[bin * stride];
+            for (; i < end; ++i) {
+                int q = std::min(std::max(seq->qual.s[i] - 33, 0),
+                    FASTX_STATS_MAX_QUAL);
+                ++hist[q];
+            }
+        }
+    }
+
+    void merge(const SeqStats &other) {
+        reads += other.reads;
+        bases += other.bases;
+        min_len = std::min(min_len, other.min_len);
+        max_len = std::max(max_len, other.max_len);
+        for (auto &l: other.lengths) lengths[l.first] += l.second;
+        base_counts.a += other.base_counts.a;
+        base_counts.c += other.base_counts.c;
+        base_counts.g += other.base_counts.g;
+        base_counts.t += other.base_counts.t;
+        base_counts.n += other.base_counts.n;
+        qual_counts.q20 += other.qual_counts.q20;
+        qual_counts.q30 += other.qual_counts.q30;
+        qual_counts.sum += other.qual_counts.sum;
+        qual_bases += other.qual_bases;
+        has_qual = has_qual || other.has_qual;
+        if (qual_hist.size() < other.qual_hist.size()) {
+            qual_hist.resize(other.qual_hist.size(), 0);
+        }
+        for (size_t i = 0; i < other.qual_hist.size(); ++i) {
+            qual_hist[i] += other.qual_hist[i];
+        }
+    }
+
+    /**
+     * @brief length L such that reads of length >= L hold at least fraction
+     * of all bases(N50 for 0.5)
+     */
+    int64_t nx(double fraction) const {
+        std::vector<std::pair<int64_t, uint64_t>> sorted(lengths.begin(),
+            lengths.end());
+        std::sort(sorted.begin(), sorted.end(),
+            [](const std::pair<int64_t, uint64_t> &a,
+                const std::pair<int64_t, uint64_t> &b)
+            {
+                return a.first > b.first;
+            });
+        uint64_t sum = 0;
+        for (auto &l: sorted) {
+            sum += l.first * l.second;
+            if (sum >= fraction * bases) return l.first;
+        }
+        return 0;
+    }
+};
+
+
+/**
+ * @brief compute statistics of a fasta/q file. Batches of reads from
+ * SeqReader are counted by a pool of workers.
+ *
+ * @param input input file name, - for stdin
+ * @param with_qual_hist fill per position quality histogram
+ */
+SeqStats FastxStats(const std::string &input, int threads,
+    bool with_qual_hist)
+{
+    gzFile fp = input == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input.c_str(), "r");
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + input).c_str());
+        std::exit(1);
+    }
+
+    SeqStats total;
+    {
+        SeqReader reader(fp);
+        std::mutex mutex;
+        auto worker = [&]() {
+            SeqStats stats;
+            KseqArray *batch;
+            while ((batch = reader.read_batch()) != nullptr) {
+                for (int i = 0; i < batch->size(); ++i) {
+                    stats.add(batch->get(i), with_qual_hist);
+                }
+                reader.release(batch);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            total.merge(stats);
+        };
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; ++i) {
+            workers.emplace_back(worker);
+        }
+        for (auto &w: workers) w.join();
+    }
+    gzclose(fp);
+
+    if (total.reads == 0) total.min_len = 0;
+    return total;
+}
+
+
+static
+std::string JsonEscape(const std::string &str) {
+    std::string escaped;
+    for (char c: str) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+
+/**
+ * @brief percentage with 2 decimals, NA(null in json) if there is no base
+ */
+static
+std::string Percent(uint64_t count, uint64_t total, bool json) {
+    if (total == 0) return json ? "null" : "NA";
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(2)
+        << 100.0 * count / total;
+    return stream.str();
+}
+
+
+static
+void WriteStats(std::ostream &out, const std::vector<std::string> &inputs,
+    const std::vector<SeqStats> &stats, bool json)
+{
+    const char *keys[] = {"file", "reads", "bases", "min_len", "max_len",
+        "mean_len", "N50", "N90", "GC(%)", "N(%)", "Q20(%)", "Q30(%)"};
+    const size_t n_keys = sizeof(keys) / sizeof(keys[0]);
+
+    if (json) out << "[\n";
+    else {
+        for (size_t k = 0; k < n_keys; ++k) {
+            out << (k ? "\t" : "") << keys[k];
+        }
+        out << "\n";
+    }
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const SeqStats &s = stats[i];
+        std::ostringstream mean;
+        mean << std::fixed << std::setprecision(2)
+            << (s.reads ? static_cast<double>(s.bases) / s.reads : 0.0);
+        uint64_t qual_bases = s.has_qual ? s.qual_bases : 0;
+        std::string values[] = {
+            json ? "\"" + JsonEscape(inputs[i]) + "\"" : inputs[i],
+            std::to_string(s.reads),
+            std::to_string(s.bases),
+            std::to_string(s.min_len),
+            std::to_string(s.max_len),
+            mean.str(),
+            std::to_string(s.nx(0.5)),
+            std::to_string(s.nx(0.9)),
+            Percent(s.base_counts.g + s.base_counts.c, s.bases, json),
+            Percent(s.base_counts.n, s.bases, json),
+            Percent(s.qual_counts.q20, qual_bases, json),
+            Percent(s.qual_counts.q30, qual_bases, json)};
+
+        if (json) {
+            out << "  {";
+            for (size_t k = 0; k < n_keys; ++k) {
+                out << (k ? ", " : "") << "\"" << keys[k] << "\": "
+                    << values[k];
+            }
+            out << (i + 1 < inputs.size() ? "},\n" : "}\n");
+        } else {
+            for (size_t k = 0; k < n_keys; ++k) {
+                out << (k ? "\t" : "") << values[k];
+            }
+            out << "\n";
+        }
+    }
+
+    if (json) out << "]\n";
+}
+
+
+/**
+ * @brief write per position quality histograms, one line per nonzero count:
+ * file, position(1-based, first-last for binned positions), quality, count
+ */
+static
+void WriteQualHist(const std::string &filename,
+    const std::vector<std::string> &inputs, const std::vector<SeqStats> &stats)
+{
+    std::ofstream out(filename);
+    if (!out) {
+        std::perror(("Error! Can not open " + filename).c_str());
+        std::exit(1);
+    }
+
+    out << "file\tposition\tquality\tcount\n";
+    const size_t stride = FASTX_STATS_MAX_QUAL + 1;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const std::vector<uint64_t> &hist = stats[i].qual_hist;
+        for (size_t k = 0; k < hist.size(); ++k) {
+            if (hist[k] == 0) continue;
+            size_t first, last;
+            PositionBinRange(k / stride, &first, &last);
+            out << inputs[i] << "\t" << first + 1;
+            if (last > first) out << "-" << last + 1;
+            out << "\t" << k % stride << "\t" << hist[k] << "\n";
+        }
+    }
+
+    if (!out) {
+        std::cerr << "Error! Failed to write " << filename << std::endl;
+        std::exit(1);
+    }
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx stats " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  statistics of fasta/fastq files.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx stats [options] <file.fasta|file.fastq|-> [...]\n\n"
+            << "Options:\n"
+            << "  -o, --output, FILE          output file name [stdout]\n"
+            << "  -j, --json                  output json instead of tsv\n"
+            << "  -q, --qual-hist, FILE       write per position quality histograms(tsv) to FILE,\n"
+            << "                              positions after 1024 are binned\n"
+            << "  -t, --thread, INT           number of threads for counting [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version."
+            << std::endl;
+}
+
+
+int FastxStatsMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"output", required_argument, 0, 'o'},
+            {"json", no_argument, 0, 'j'},
+            {"qual-hist", required_argument, 0, 'q'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "o:jq:t:hV";
+
+    std::string output = "-";
+    std::string qual_hist;
+    bool json = false;
+    int num_threads = 4;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'j':
+                json = true;
+                break;
+            case 'q':
+                qual_hist = optarg;
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    std::vector<std::string> inputs(argv + optind, argv + argc);
+    if (inputs.empty()) {
+        std::cerr << "Error! Missing input file" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    std::vector<SeqStats> stats;
+    for (auto &input: inputs) {
+        stats.push_back(FastxStats(input, num_threads, !qual_hist.empty()));
+    }
+
+    if (output == "-") {
+        WriteStats(std::cout, inputs, stats, json);
+    } else {
+        std::ofstream out(output);
+        if (!out) {
+            std::perror(("Error! Can not open " + output).c_str());
+            std::exit(1);
+        }
+        WriteStats(out, inputs, stats, json);
+    }
+
+    if (!qual_hist.empty()) WriteQualHist(qual_hist, inputs, stats);
+
+    return 0;
+}
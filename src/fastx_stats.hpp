@@ -0,0 +1,8 @@
+#ifndef FASTX_STATS_HPP
+#define FASTX_STATS_HPP
+
+
+int FastxStatsMain(int argc, char **argv);
+
+
+#endif  // FASTX_STATS_HPP
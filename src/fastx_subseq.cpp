@@ -1,216 +1,686 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
-#include <fstream>
+#include <cstring>
+#include <charconv>
+#include <deque>
+#include <iterator>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <stdio.h>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include <iostream>
 #include <sstream>
 #include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include "faidx_utils.hpp"
 #include "fastx_subseq.hpp"
+#include "kseq_utils.hpp"
+#include "name_set.hpp"
+#include "revcomp.hpp"
+#include "seq_reader.hpp"
+#include "two_bit.hpp"
 #include "htslib/bgzf.h"
-#include "htslib/faidx.h"
-#include "htslib/khash.h"
 #include "htslib/thread_pool.h"
 #include "version.hpp"
 #include "utils.hpp"
 
 
-// copy from faidx.c of htslib, expose hidden struct faidx_t
-typedef struct {
-    int id; // faidx_t->name[id] is for this struct.
-    uint32_t line_len, line_blen;
-    uint64_t len;
-    uint64_t seq_offset;
-    uint64_t qual_offset;
-} faidx1_t;
-KHASH_MAP_INIT_STR(s, faidx1_t)
-
-// copy from faidx.c of htslib, expose hidden struct faidx_t
-struct faidx_t {
-    BGZF *bgzf;
-    int n, m;
-    char **name;
-    khash_t(s) *hash;
-    enum fai_format_options format;
-};
+const int64_t FASTX_POS_MAX = std::numeric_limits<int64_t>::max();
 
+// intervals closer than this are fetched by one read(about one BGZF block)
+const int64_t FASTX_SUBSEQ_MERGE_GAP = BGZF_BLOCK_SIZE;
 
-const int64_t FASTX_POS_MAX = std::numeric_limits<int64_t>::max();
+// max size of a merged fetch, larger intervals are fetched alone
+const int64_t FASTX_SUBSEQ_MAX_MERGED_FETCH = 4 * 1024 * 1024;
 
-#ifdef FASTX_MAX_NAME_LINE
-const int64_t FASTX_MAX_NAME_LINE_LEN = FASTX_MAX_NAME_LINE;
-#else
-const int64_t FASTX_MAX_NAME_LINE_LEN = 4096;
-#endif
+// fetched groups buffered per thread ahead of the writer
+const size_t FASTX_SUBSEQ_GROUPS_PER_THREAD = 64;
 
+// name lists of at least this size get a bloom filter in -n mode
+const size_t FASTX_SUBSEQ_BLOOM_MIN_NAMES = 1 << 20;
 
-static
-std::vector<std::string> SplitString(std::string str, char delimiter) {
-    std::vector<std::string> result;
-    size_t i = 0;
-    size_t j = 0;
-    while ((j = str.find(delimiter, i)) != std::string::npos) {
-        result.push_back(str.substr(i, j-i));
-        i = j + 1;
-    }
-    if (i < str.size()) result.push_back(str.substr(i));
-    return result;
-}
+// intervals larger than FASTX_SUBSEQ_MAX_MERGED_FETCH are streamed to the
+// output in windows of this size
+const int64_t FASTX_SUBSEQ_STREAM_WINDOW = 1024 * 1024;
 
+/**
+ * @brief regions to extract, stored as struct of arrays so that tens of
+ * millions of regions stay compact. Sequence names are interned, each
+ * region only keeps the id of its name.
+ */
+class Intervals {
+public:
+    /**
+     * @brief parse and add a region, which can be a bed line(name, 0-based
+     * start, end, and strand in the 6th column), name:start-end(1-based) or
+     * a sequence name.
+     */
+    void add(const char *begin, const char *end) {
+        const char *tab = static_cast<const char *>(
+            std::memchr(begin, '\t', end - begin));
+        const char *colon = static_cast<const char *>(
+            std::memchr(begin, ':', end - begin));
 
-struct Interval {
-    Interval(std::string name_, int64_t start_, int64_t end_):
-        name(std::move(name_)), start(start_), end(end_) {}
-    
-    explicit Interval(const std::string &region) {
-        if (region.find('\t') != std::string::npos) {
-            size_t i = 0;
-            i = region.find('\t', i);
-            name = region.substr(0, i);
-            ++i;
-            size_t j = 0;
-            j = region.find('\t', i);
-            if (j == std::string::npos) {
-                std::cerr << "Error! Malformed bed line "
-                    << region << std::endl;
-                std::exit(1);
-            }
-            start = SafeStrtol(region.substr(i, j-i).c_str(), 10);
-            i = j + 1;
-            j = region.find('\t', i);
-            if (j == std::string::npos) {
-                end = SafeStrtol(region.substr(i).c_str(), 10) - 1;
-            } else {
-                end = SafeStrtol(region.substr(i, j-i).c_str(), 10) - 1;
-            }
-        } else if (region.find(':') != std::string::npos) {
-            size_t i = 0;
-            i = region.find(':', i);
-            name = region.substr(0, i);
-            ++i;
-            size_t j = 0;
-            j = region.find('-', i);
-            if (j == std::string::npos) {
-                std::cerr << "Error! Malformed bed line "
-                    << region << std::endl;
-                std::exit(1);
+        int32_t name_id;
+        int64_t start;
+        int64_t stop;
+        bool reverse = false;
+        if (tab) {
+            // name, start, end, name, score, strand
+            const char *fields[6];
+            const char *field_ends[6];
+            int n = 0;
+            const char *p = begin;
+            while (n < 6) {
+                const char *q = static_cast<const char *>(
+                    std::memchr(p, '\t', end - p));
+                fields[n] = p;
+                field_ends[n] = q ? q : end;
+                ++n;
+                if (q == nullptr) break;
+                p = q + 1;
             }
-            start = SafeStrtol(region.substr(i, j-i).c_str(), 10) - 1;
-            i = j + 1;
-            end = SafeStrtol(region.substr(i).c_str(), 10) - 1;
+            if (n < 3) Malformed(begin, end);
+            name_id = Intern(fields[0], field_ends[0] - fields[0]);
+            start = ParsePos(fields[1], field_ends[1], begin, end);
+            stop = ParsePos(fields[2], field_ends[2], begin, end) - 1;
+            reverse = n == 6 && field_ends[5] - fields[5] == 1 &&
+                fields[5][0] == '-';
+        } else if (colon) {
+            const char *dash = static_cast<const char *>(
+                std::memchr(colon, '-', end - colon));
+            if (dash == nullptr) Malformed(begin, end);
+            name_id = Intern(begin, colon - begin);
+            start = ParsePos(colon + 1, dash, begin, end) - 1;
+            stop = ParsePos(dash + 1, end, begin, end) - 1;
         } else {
-            name = region;
+            name_id = Intern(begin, end - begin);
             start = 0;
-            end = FASTX_POS_MAX;
+            stop = FASTX_POS_MAX;
+        }
+
+        name_ids_.push_back(name_id);
+        starts_.push_back(start);
+        ends_.push_back(stop);
+        reverse_.push_back(reverse);
+    }
+
+    /**
+     * @brief load regions from a file, one region per line. The file is
+     * mapped and parsed in place, empty lines are skipped.
+     */
+    void load(const std::string &filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::perror(("Error! Can not open " + filename).c_str());
+            std::exit(1);
         }
+
+        struct stat st;
+        void *mapped = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+
+        const char *data = nullptr;
+        size_t size = 0;
+        std::string buffer;
+        if (mapped != MAP_FAILED) {
+            madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+            data = static_cast<const char *>(mapped);
+            size = st.st_size;
+        } else {
+            // pipes and other files which can not be mapped
+            char chunk[65536];
+            ssize_t n;
+            while ((n = ::read(fd, chunk, sizeof(chunk))) > 0) {
+                buffer.append(chunk, n);
+            }
+            data = buffer.data();
+            size = buffer.size();
+        }
+        close(fd);
+
+        const char *p = data;
+        const char *data_end = data + size;
+        while (p < data_end) {
+            const char *line_end = static_cast<const char *>(
+                std::memchr(p, '\n', data_end - p));
+            const char *next = line_end ? line_end + 1 : data_end;
+            if (line_end == nullptr) line_end = data_end;
+            if (line_end > p && line_end[-1] == '\r') --line_end;
+            if (line_end > p) add(p, line_end);
+            p = next;
+        }
+
+        if (mapped != MAP_FAILED) munmap(mapped, st.st_size);
+    }
+
+    size_t size() const {
+        return starts_.size();
+    }
+
+    const std::string &name(size_t i) const {
+        return names_[name_ids_[i]];
+    }
+
+    int32_t name_id(size_t i) const {
+        return name_ids_[i];
     }
 
-    std::string name;
     // 0-based start position
-    int64_t start;
+    int64_t start(size_t i) const {
+        return starts_[i];
+    }
+
     // 0-based end position
-    int64_t end;
+    int64_t end(size_t i) const {
+        return ends_[i];
+    }
+
+    // minus strand, sequence is reverse complemented
+    bool reverse(size_t i) const {
+        return reverse_[i];
+    }
+
+    // unique sequence names, indexed by name id
+    const std::vector<std::string> &names() const {
+        return names_;
+    }
+
+    // all regions are whole sequences given by name
+    bool is_name_list() const {
+        for (int64_t e: ends_) {
+            if (e != FASTX_POS_MAX) return false;
+        }
+        return true;
+    }
+
+private:
+    int32_t Intern(const char *name, size_t len) {
+        // regions are usually grouped by sequence
+        if (last_id_ >= 0 && names_[last_id_].size() == len &&
+            std::memcmp(names_[last_id_].data(), name, len) == 0)
+        {
+            return last_id_;
+        }
+
+        std::string key(name, len);
+        auto iter = name_index_.find(key);
+        if (iter == name_index_.end()) {
+            iter = name_index_.emplace(key, names_.size()).first;
+            names_.push_back(std::move(key));
+        }
+        last_id_ = iter->second;
+        return last_id_;
+    }
+
+    static int64_t ParsePos(const char *begin, const char *end,
+        const char *line, const char *line_end)
+    {
+        int64_t pos = 0;
+        auto result = std::from_chars(begin, end, pos);
+        if (result.ec != std::errc() || result.ptr != end) {
+            Malformed(line, line_end);
+        }
+        return pos;
+    }
+
+    [[noreturn]] static void Malformed(const char *line, const char *end) {
+        std::cerr << "Error! Malformed region " << std::string(line, end)
+            << std::endl;
+        std::exit(1);
+    }
+
+    std::vector<std::string> names_;
+    std::unordered_map<std::string, int32_t> name_index_;
+    int32_t last_id_ = -1;
+    std::vector<int32_t> name_ids_;
+    std::vector<int64_t> starts_;
+    std::vector<int64_t> ends_;
+    std::vector<bool> reverse_;
 };
 
 
 /**
- * @brief get the name line(include name and comment)
+ * @brief get the name line(include name and comment). The .fai gives the
+ * offset where the previous record ends and where the sequence of this
+ * record starts, the name line is the last line in between, so it is read
+ * directly whatever its length.
  * 
  * @param fai faidx
  * @param name target sequence name
+ * @param map mapping of uncompressed input, read from fai->bgzf if NULL
  * @return std::string name line
  */
-std::string FaiGetNameLine(const faidx_t *fai, const char *name) {
-    khiter_t iter;
-
-    iter = kh_get(s, fai->hash, name);
-
+std::string FaiGetNameLine(const faidx_t *fai, const char *name,
+    const FaiMmap *map = nullptr)
+{
+    khiter_t iter = kh_get(s, fai->hash, name);
     if (iter == kh_end(fai->hash)) {
         std::cerr << "[FaiGetNameLine] Error! The sequence "
             << name << " was not found!" << std::endl;
         std::exit(1);
     }
 
-    faidx1_t val = kh_value(fai->hash, iter);
-    int64_t offset = val.seq_offset;
-    int ret;
-
-    int64_t offset1 = offset - FASTX_MAX_NAME_LINE_LEN;
-    offset1 = offset1 >= 0 ? offset1 : 0;
-    ret = bgzf_useek(fai->bgzf, offset1, SEEK_SET);
-
-    if (ret < 0) {
+    const faidx1_t &val = kh_value(fai->hash, iter);
+    uint64_t start;
+    uint64_t end;
+    if (!FaiNameLineRange(fai, val, &start, &end)) {
         std::cerr << "[FaiGetNameLine] Error! Failed to get name line! "
-            << "bgzf_useek cab not seek to " << offset1
-            << ". name=" << name << std::endl;
+            << "Invalid offsets in fai index. name=" << name << std::endl;
         std::exit(1);
     }
 
-    std::vector<int> new_line_indices;
-    char c;
-    int i = 0;
-    while ((c=bgzf_getc(fai->bgzf)) >= 0) {
-        if (c == '\n') {
-            new_line_indices.push_back(i);
+    std::string buffer;
+    if (map) {
+        if (!map->read(start, end, buffer)) {
+            std::cerr << "[FaiGetNameLine] Error! Failed to get name line! "
+                << "Offset " << end << " is out of file. name=" << name
+                << std::endl;
+            std::exit(1);
         }
-        ++i;
-        if (i >= offset - offset1) {
-            // search to the position before offset
-            break;
+    } else {
+        if (bgzf_useek(fai->bgzf, start, SEEK_SET) < 0) {
+            std::cerr << "[FaiGetNameLine] Error! Failed to get name line! "
+                << "bgzf_useek can not seek to " << start
+                << ". name=" << name << std::endl;
+            std::exit(1);
+        }
+
+        buffer.resize(end - start);
+        ssize_t n = bgzf_read(fai->bgzf, &buffer[0], buffer.size());
+        if (n != static_cast<ssize_t>(buffer.size())) {
+            std::cerr << "[FaiGetNameLine] Error! Failed to get name line! "
+                << "Can not read " << buffer.size() << " bytes at " << start
+                << ". name=" << name << std::endl;
+            std::exit(1);
         }
     }
 
-    if (new_line_indices.empty()) {
+    if (!FaiTrimNameLine(buffer)) {
         std::cerr << "[FaiGetNameLine] Error! Failed to get name line! "
-            << "New line seperator was not found!"
+            << "Name line was not found before the sequence."
             << " name=" << name << std::endl;
         std::exit(1);
     }
 
-    char name_line[FASTX_MAX_NAME_LINE_LEN];
-    if (new_line_indices.size() >= 2 || offset1 == 0) {
-        int64_t start;
-        if (new_line_indices.size() >= 2) {
-            start = new_line_indices[new_line_indices.size()-2] + 1;
-        } else {
-            start = 0;
+    return buffer;
+}
+
+
+struct SubseqOptions {
+    // output in file order instead of input order
+    bool sorted_output = false;
+    // wrap sequence lines, 0 means no wrap
+    int64_t line_width = 0;
+};
+
+
+/**
+ * @brief intervals fetched by one read of the input. Intervals of the same
+ * sequence which overlap or are close to each other(likely in the same
+ * BGZF block) are merged into one fetch. A group is a view of FetchPlan, it
+ * does not own its members.
+ */
+struct FetchGroup {
+    const char *name;
+    // 0-based closed range of the merged fetch
+    int64_t start;
+    int64_t end;
+    // indices of member intervals, in file order
+    const size_t *members;
+    size_t size;
+    // huge interval streamed by the writer instead of fetched
+    bool stream;
+};
+
+
+/**
+ * @brief fetches of the intervals as flat arrays, so that the plan takes one
+ * index per interval and one offset per group. Group k holds the intervals
+ * order[group_begin[k]] to order[group_begin[k + 1] - 1].
+ */
+struct FetchPlan {
+    // interval indices sorted in file order
+    std::vector<size_t> order;
+    std::vector<size_t> group_begin;
+    // fai key and length of the sequences by name id of intervals
+    std::vector<const char *> seq_names;
+    std::vector<int64_t> seq_lens;
+
+    size_t groups() const {
+        return group_begin.size() - 1;
+    }
+
+    // 0-based start of interval i, clamped to its sequence
+    int64_t start(const Intervals &intervals, size_t i) const {
+        return std::max<int64_t>(intervals.start(i), 0);
+    }
+
+    // 0-based end of interval i, clamped to its sequence
+    int64_t end(const Intervals &intervals, size_t i) const {
+        return std::min<int64_t>(intervals.end(i),
+            seq_lens[intervals.name_id(i)] - 1);
+    }
+
+    // an interval larger than a merged fetch is never merged, so its group
+    // is streamed
+    bool stream(const Intervals &intervals, size_t i) const {
+        return end(intervals, i) - start(intervals, i) + 1 >
+            FASTX_SUBSEQ_MAX_MERGED_FETCH;
+    }
+
+    FetchGroup group(const Intervals &intervals, size_t k) const {
+        const size_t *members = order.data() + group_begin[k];
+        size_t size = group_begin[k + 1] - group_begin[k];
+        FetchGroup g{seq_names[intervals.name_id(members[0])],
+            start(intervals, members[0]), end(intervals, members[0]),
+            members, size, false};
+        for (size_t m = 1; m < size; ++m) {
+            g.end = std::max(g.end, end(intervals, members[m]));
         }
-        start += offset1;
+        g.stream = size == 1 && stream(intervals, members[0]);
+        return g;
+    }
+};
 
-        ret = bgzf_useek(fai->bgzf, start, SEEK_SET);
-        if (ret < 0) {
-            std::cerr << "[FaiGetNameLine] Error! Failed to get name line! "
-                << "bgzf_useek can not seek to start (" << start
-                << ") of name line. name=" << name << std::endl;
+
+/**
+ * @brief plan the fetches of intervals. Intervals are sorted by the file
+ * offset of their sequences and start positions, so that the input is read
+ * in one forward sweep, then merged into groups.
+ */
+FetchPlan PlanFetches(const faidx_t *fai, const Intervals &intervals)
+{
+    FetchPlan plan;
+
+    // names are looked up in fai once, not once per interval
+    std::vector<uint64_t> seq_offsets;
+    seq_offsets.reserve(intervals.names().size());
+    for (auto &name: intervals.names()) {
+        khiter_t iter = kh_get(s, fai->hash, name.c_str());
+        if (iter == kh_end(fai->hash)) {
+            std::cerr << "[FastxSubseq] Error! Can not fetch "
+                "sequence of " << name << ", the sequence was "
+                << "not found!" << std::endl;
             std::exit(1);
         }
+        const faidx1_t &val = kh_value(fai->hash, iter);
+        plan.seq_names.push_back(kh_key(fai->hash, iter));
+        plan.seq_lens.push_back(static_cast<int64_t>(val.len));
+        seq_offsets.push_back(val.seq_offset);
+    }
+
+    // intervals are bucketed by sequence in file order, then each bucket is
+    // sorted by start(intervals of the same start stay in input order)
+    size_t n_names = seq_offsets.size();
+    std::vector<int32_t> names_by_offset(n_names);
+    for (size_t k = 0; k < n_names; ++k) names_by_offset[k] = k;
+    std::sort(names_by_offset.begin(), names_by_offset.end(),
+        [&](int32_t a, int32_t b) {return seq_offsets[a] < seq_offsets[b];});
+    std::vector<size_t> bucket_begin(n_names + 1, 0);
+    std::vector<size_t> bucket_of(n_names);
+    for (size_t k = 0; k < n_names; ++k) bucket_of[names_by_offset[k]] = k;
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        ++bucket_begin[bucket_of[intervals.name_id(i)] + 1];
+    }
+    for (size_t k = 0; k < n_names; ++k) {
+        bucket_begin[k + 1] += bucket_begin[k];
+    }
+
+    plan.order.resize(intervals.size());
+    std::vector<size_t> cursor(bucket_begin.begin(), bucket_begin.end() - 1);
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        plan.order[cursor[bucket_of[intervals.name_id(i)]]++] = i;
+    }
+    for (size_t k = 0; k < n_names; ++k) {
+        std::stable_sort(plan.order.begin() + bucket_begin[k],
+            plan.order.begin() + bucket_begin[k + 1],
+            [&](size_t a, size_t b) {
+                return intervals.start(a) < intervals.start(b);
+            });
+    }
+
+    int32_t last_name = -1;
+    int64_t last_start = 0;
+    int64_t last_end = 0;
+    for (size_t m = 0; m < plan.order.size(); ++m) {
+        size_t i = plan.order[m];
+        int32_t name = intervals.name_id(i);
+        int64_t start = plan.start(intervals, i);
+        int64_t end = plan.end(intervals, i);
+        if (!plan.group_begin.empty() && name == last_name &&
+            start <= last_end + FASTX_SUBSEQ_MERGE_GAP &&
+            std::max(last_end, end) - last_start <
+                FASTX_SUBSEQ_MAX_MERGED_FETCH)
+        {
+            last_end = std::max(last_end, end);
+            continue;
+        }
+        plan.group_begin.push_back(m);
+        last_name = name;
+        last_start = start;
+        last_end = end;
+    }
+    plan.group_begin.push_back(plan.order.size());
+
+    return plan;
+}
+
+
+/**
+ * @brief append sequence to out, a new line is inserted every line_width
+ * bases(no wrap if line_width is 0).
+ * 
+ * @param column number of bases in the current line, updated
+ */
+static
+void AppendWrapped(std::string &out, const char *seq, int64_t len,
+    int64_t line_width, int64_t &column)
+{
+    if (line_width <= 0) {
+        out.append(seq, len);
+        column += len;
+        return;
+    }
+
+    while (len > 0) {
+        int64_t n = std::min(len, line_width - column);
+        out.append(seq, n);
+        seq += n;
+        len -= n;
+        column += n;
+        if (column == line_width) {
+            out += '\n';
+            column = 0;
+        }
+    }
+}
+
+
+/**
+ * @brief end the sequence lines of a record written by AppendWrapped, an
+ * empty sequence still gets its(empty) line.
+ */
+static
+void AppendLastNewline(std::string &out, int64_t line_width, int64_t column,
+    int64_t seq_len)
+{
+    if (line_width <= 0 || column > 0 || seq_len == 0) {
+        out += '\n';
+    }
+}
+
+
+static
+std::string NameLine(const faidx_t *fai, const FaiMmap *map,
+    const Intervals &intervals, size_t i, bool input_name_list)
+{
+    std::string name_line;
+    if (!input_name_list) {
+        std::ostringstream new_name_stream;
+        new_name_stream << (fai->format == FAI_FASTQ ? "@" : ">")
+            << intervals.name(i)
+            << ":" << intervals.start(i) + 1
+            << "-" << intervals.end(i) + 1
+            << (intervals.reverse(i) ? "/rc" : "");
+        name_line = new_name_stream.str();
+    } else {
+        name_line = FaiGetNameLine(fai, intervals.name(i).c_str(), map);
+    }
+    name_line += '\n';
+    return name_line;
+}
+
+
+/**
+ * @brief fetch sequence(or quality of fastq) of name in 0-based closed range
+ * [start, end] from the mapping if given, exit on failure.
+ */
+static
+char *FaiFetch(const faidx_t *fai, const FaiMmap *map, const char *name,
+    int64_t start, int64_t end, bool qual, int64_t *target_len)
+{
+    char *seq = nullptr;
+    if (map) {
+        khiter_t iter = kh_get(s, fai->hash, name);
+        seq = map->fetch(kh_value(fai->hash, iter), qual, start, end,
+            target_len);
+    } else {
+        seq = qual ?
+            faidx_fetch_qual64(fai, name, start, end, target_len) :
+            faidx_fetch_seq64(fai, name, start, end, target_len);
+    }
+    if (*target_len < 0 || seq == nullptr) {
+        std::cerr << "[FastxSubseq] Error! Can not fetch "
+            << (qual ? "quality" : "sequence") << " of " << name << ":"
+            << start << "-" << end << std::endl;
+        free(seq);
+        std::exit(1);
+    }
+    return seq;
+}
+
+
+/**
+ * @brief fetch the merged range of a group and format the record of each
+ * member interval, quality is fetched along with sequence for fastq. Only the
+ * name line is formatted for a streamed group.
+ * 
+ * @param records (interval index, record) of members, in group order
+ */
+void FetchGroupRecords(const faidx_t *fai, const FaiMmap *map,
+    const FetchGroup &group,
+    const Intervals &intervals, bool input_name_list,
+    const SubseqOptions &options,
+    std::vector<std::pair<size_t, std::string>> &records)
+{
+    if (group.stream) {
+        size_t i = group.members[0];
+        records.emplace_back(i,
+            NameLine(fai, map, intervals, i, input_name_list));
+        return;
+    }
+
+    bool is_fastq = fai->format == FAI_FASTQ;
+    int64_t target_len = 0;
+    int64_t qual_len = 0;
+    char *seq = nullptr;
+    char *qual = nullptr;
+    if (group.start <= group.end) {
+        seq = FaiFetch(fai, map, group.name, group.start, group.end, false,
+            &target_len);
+        if (is_fastq) {
+            qual = FaiFetch(fai, map, group.name, group.start, group.end,
+                true, &qual_len);
+            if (qual_len != target_len) {
+                std::cerr << "[FastxSubseq] Error! Length of quality is not "
+                    << "equal to sequence for " << group.name << std::endl;
+                std::exit(1);
+            }
+        }
+    }
 
-        i = 0;
-        while ((c=bgzf_getc(fai->bgzf)) >= 0) {
-            if (c != '\n' && c != '\r') {
-                name_line[i++] = c;
+    for (size_t m = 0; m < group.size; ++m) {
+        size_t i = group.members[m];
+        bool reverse = intervals.reverse(i);
+        std::string record = NameLine(fai, map, intervals, i,
+            input_name_list);
+
+        int64_t start = std::max<int64_t>(intervals.start(i), 0) -
+            group.start;
+        int64_t end = std::min<int64_t>(intervals.end(i) - group.start,
+            target_len - 1);
+        int64_t seq_len = 0;
+        int64_t column = 0;
+        if (seq != nullptr && start <= end) {
+            seq_len = end - start + 1;
+            if (reverse) {
+                std::string rc(seq + start, seq_len);
+                ReverseComplement(&rc[0], rc.size());
+                AppendWrapped(record, rc.data(), seq_len, options.line_width,
+                    column);
             } else {
-                break;
+                AppendWrapped(record, seq + start, seq_len,
+                    options.line_width, column);
             }
         }
+        AppendLastNewline(record, options.line_width, column, seq_len);
+
+        if (is_fastq) {
+            record += "+\n";
+            if (reverse && seq_len) {
+                record.append(std::reverse_iterator<char *>(
+                    qual + start + seq_len),
+                    std::reverse_iterator<char *>(qual + start));
+            } else if (seq_len) {
+                record.append(qual + start, seq_len);
+            }
+            record += '\n';
+        }
+
+        records.emplace_back(i, std::move(record));
     }
 
-    name_line[i] = '\0';
+    free(seq);
+    free(qual);
+}
+
 
-    return name_line;
+static
+void BgzfWriteRecord(BGZF *outfp, const std::string &record)
+{
+    if (bgzf_write(outfp, record.data(), record.size()) < 0) {
+        std::cerr << "[FastxSubseq] Error! failed to write record "
+            << record.substr(0, record.find('\n')) << std::endl;
+        std::exit(1);
+    }
 }
 
 
-int FastxSubseq(const faidx_t *fai, const std::vector<Interval> &intervals,
-    bool input_name_list, const std::string &output,
-    int compress_level, int threads)
+/**
+ * @brief open output, gzip(BGZF) compressed if the file name ends with .gz
+ * 
+ * @param pool thread pool created for compression, NULL if uncompressed
+ */
+static
+BGZF *SubseqOpenOutput(const std::string &output, int compress_level,
+    int threads, hts_tpool **pool)
 {
     BGZF *outfp = NULL;
-    hts_tpool *pool = NULL;
 
     if (output == "-") {
         outfp = bgzf_open(output.c_str(), "wu");
@@ -234,13 +704,13 @@ int FastxSubseq(const faidx_t *fai, const std::vector<Interval> &intervals,
             std::exit(1);
         }
         
-        pool = hts_tpool_init(threads);
-        if (pool == NULL) {
+        *pool = hts_tpool_init(threads);
+        if (*pool == NULL) {
             std::cerr << "Error! hts_tpool_init can not init thread pool "
                 << std::endl;
             std::exit(1);
         }
-        bgzf_thread_pool(outfp, pool, 0);
+        bgzf_thread_pool(outfp, *pool, 0);
     } else {
         outfp = bgzf_open(output.c_str(), "wu");
 
@@ -252,66 +722,350 @@ int FastxSubseq(const faidx_t *fai, const std::vector<Interval> &intervals,
         }
     }
 
-    int ret;
+    return outfp;
+}
 
-    for (auto &interval: intervals) {
+
+/**
+ * @brief write the sequence(or quality) of a huge interval in windows, so
+ * that memory usage does not depend on the interval length. Windows are
+ * written backwards and reverse complemented(reversed for quality) if
+ * reverse is set.
+ */
+static
+void BgzfStreamSeq(const faidx_t *fai, const FaiMmap *map,
+    const FetchGroup &group, bool qual, bool reverse,
+    const SubseqOptions &options, BGZF *outfp)
+{
+    std::string buffer;
+    int64_t column = 0;
+    int64_t seq_len = 0;
+    int64_t n_windows = group.start <= group.end ?
+        (group.end - group.start) / FASTX_SUBSEQ_STREAM_WINDOW + 1 : 0;
+    for (int64_t k = 0; k < n_windows; ++k) {
+        int64_t w = reverse ? n_windows - 1 - k : k;
+        int64_t start = group.start + w * FASTX_SUBSEQ_STREAM_WINDOW;
+        int64_t end = std::min(start + FASTX_SUBSEQ_STREAM_WINDOW - 1,
+            group.end);
         int64_t target_len = 0;
-        char *seq = faidx_fetch_seq64(fai, interval.name.c_str(),
-            interval.start, interval.end, &target_len);
-        if (target_len < 0 || seq == nullptr) {
-            std::cerr << "[FastxSubseq] Error! Can not fetch "
-                "sequence of " << interval.name.c_str();
-            if (!input_name_list) {
-                std::cerr << ":" << interval.start << "-"
-                    << interval.end;
+        char *seq = FaiFetch(fai, map, group.name, start, end, qual,
+            &target_len);
+        if (reverse && qual) {
+            std::reverse(seq, seq + target_len);
+        } else if (reverse) {
+            ReverseComplement(seq, target_len);
+        }
+
+        buffer.clear();
+        AppendWrapped(buffer, seq, target_len, options.line_width, column);
+        seq_len += target_len;
+        free(seq);
+        BgzfWriteRecord(outfp, buffer);
+    }
+
+    buffer.clear();
+    AppendLastNewline(buffer, options.line_width, column, seq_len);
+    BgzfWriteRecord(outfp, buffer);
+}
+
+
+int FastxSubseq(const std::string &input, const faidx_t *fai,
+    const Intervals &intervals, bool input_name_list,
+    const SubseqOptions &options, const std::string &output,
+    int compress_level, int threads)
+{
+    bool sorted_output = options.sorted_output;
+
+    hts_tpool *pool = NULL;
+    BGZF *outfp = SubseqOpenOutput(output, compress_level, threads, &pool);
+
+    FetchPlan plan = PlanFetches(fai, intervals);
+    size_t n_groups = plan.groups();
+
+    // uncompressed input is fetched from a mapping shared by all threads
+    std::unique_ptr<FaiMmap> input_map;
+    if (!fai->bgzf->is_compressed) {
+        input_map.reset(new FaiMmap(input));
+        if (!input_map->ok()) input_map.reset();
+    }
+    const FaiMmap *map = input_map.get();
+
+    // streamed intervals are written by this thread with fai
+    auto write_record = [&](size_t i, const std::string &record) {
+        BgzfWriteRecord(outfp, record);
+        if (!plan.stream(intervals, i)) return;
+        FetchGroup group{plan.seq_names[intervals.name_id(i)],
+            plan.start(intervals, i), plan.end(intervals, i), nullptr, 1,
+            true};
+        bool reverse = intervals.reverse(i);
+        BgzfStreamSeq(fai, map, group, false, reverse, options, outfp);
+        if (fai->format == FAI_FASTQ) {
+            BgzfWriteRecord(outfp, "+\n");
+            BgzfStreamSeq(fai, map, group, true, reverse, options, outfp);
+        }
+    };
+
+    // records are produced in file order, reassembled into input order.
+    // Only the intervals from next to the last arrived record are kept,
+    // waiting[k] is the record of interval next + k(empty until it arrives,
+    // a record always has its name line).
+    std::deque<std::string> waiting;
+    size_t next = 0;
+
+    auto write_records = [&](
+        std::vector<std::pair<size_t, std::string>> &records)
+    {
+        for (auto &record: records) {
+            if (sorted_output) {
+                write_record(record.first, record.second);
+                continue;
+            }
+            size_t k = record.first - next;
+            if (k >= waiting.size()) waiting.resize(k + 1);
+            waiting[k].swap(record.second);
+            while (!waiting.empty() && !waiting.front().empty()) {
+                write_record(next++, waiting.front());
+                waiting.pop_front();
             }
-            std::cerr << std::endl;
-            free(seq);
-            std::exit(1);
         }
+    };
 
-        std::string new_name;
-        if (!input_name_list) {
-            std::ostringstream new_name_stream;
-            new_name_stream << ">"
-                << interval.name.c_str()
-                << ":" << interval.start + 1
-                << "-" << interval.end + 1;
-            new_name = new_name_stream.str();
-        } else {
-            new_name = FaiGetNameLine(fai, interval.name.c_str());
+    std::vector<std::pair<size_t, std::string>> records;
+    if (threads < 2 || n_groups < 2) {
+        for (size_t k = 0; k < n_groups; ++k) {
+            records.clear();
+            FetchGroupRecords(fai, map, plan.group(intervals, k), intervals,
+                input_name_list, options, records);
+            write_records(records);
         }
+    } else {
+        // workers fetch groups with their own faidx handles, results are
+        // written in group order. Workers stay at most window groups ahead
+        // of the writer, so group k is kept in slot k % window until
+        // written.
+        size_t window = static_cast<size_t>(threads) *
+            FASTX_SUBSEQ_GROUPS_PER_THREAD;
+        std::vector<std::vector<std::pair<size_t, std::string>>> results(
+            window);
+        std::vector<bool> done(window, false);
+        size_t written = 0;
+        std::atomic<size_t> next_group(0);
+        std::mutex mutex;
+        std::condition_variable worker_cv;
+        std::condition_variable writer_cv;
 
-        ret = bgzf_write(outfp, new_name.c_str(), new_name.size());
-        if (ret < 0 || ret < (int)new_name.size()) {
-            std::cerr << "[FastxSubseq] Error! failed to write fasta name line "
-                << new_name << std::endl;
-            std::exit(1);
+        auto worker = [&]() {
+            // with the mapping fai is shared, only its hash is read
+            const faidx_t *worker_fai = fai;
+            faidx_t *loaded_fai = nullptr;
+            if (map == nullptr) {
+                loaded_fai = fai_load_format(input.c_str(), fai->format);
+                if (loaded_fai == nullptr) {
+                    std::cerr << "[FastxSubseq] Error! Fail to load fai index"
+                        << " for fasta " << input << std::endl;
+                    std::exit(1);
+                }
+                worker_fai = loaded_fai;
+            }
+
+            std::vector<std::pair<size_t, std::string>> worker_records;
+            size_t k;
+            while ((k = next_group++) < n_groups) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    worker_cv.wait(lock, [&]{return k < written + window;});
+                }
+
+                worker_records.clear();
+                FetchGroupRecords(worker_fai, map, plan.group(intervals, k),
+                    intervals, input_name_list, options, worker_records);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    results[k % window].swap(worker_records);
+                    done[k % window] = true;
+                }
+                writer_cv.notify_one();
+            }
+
+            if (loaded_fai) fai_destroy(loaded_fai);
+        };
+
+        std::vector<std::thread> workers;
+        size_t n_workers = std::min<size_t>(threads, n_groups);
+        for (size_t i = 0; i < n_workers; ++i) {
+            workers.emplace_back(worker);
         }
 
-        ret = bgzf_write(outfp, "\n", 1);
-        if (ret < 0) {
-            std::cerr << "[FastxSubseq] Error! failed to write new line"
-                << std::endl;
-            std::exit(1);
+        for (size_t k = 0; k < n_groups; ++k) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                writer_cv.wait(lock, [&]{
+                    return static_cast<bool>(done[k % window]);});
+                records.clear();
+                records.swap(results[k % window]);
+                done[k % window] = false;
+            }
+            write_records(records);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                written = k + 1;
+            }
+            worker_cv.notify_all();
         }
 
-        ret = bgzf_write(outfp, seq, target_len);
-        if (ret < 0) {
-            std::cerr << "[FastxSubseq] Error! failed to write fasta seq for "
-                << "name=" << interval.name << std::endl;
+        for (auto &w: workers) w.join();
+    }
+
+    if (outfp) bgzf_close(outfp);
+    if (pool) hts_tpool_destroy(pool);
+
+    return 0;
+}
+
+
+/**
+ * @brief extract records of a name list without index, by streaming the
+ * input(plain, gzip or stdin). Records are output in input order.
+ * 
+ * @param early_exit stop reading once all names were found
+ */
+int FastxSubseqScan(const std::string &input,
+    const Intervals &intervals, bool early_exit,
+    const std::string &output, int compress_level, int threads)
+{
+    NameSet names;
+    for (auto &name: intervals.names()) {
+        names.insert(name.c_str(), name.size());
+    }
+    if (names.size() >= FASTX_SUBSEQ_BLOOM_MIN_NAMES) {
+        names.build_bloom();
+    }
+
+    gzFile fp = input == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input.c_str(), "r");
+    if (fp == nullptr) {
+        std::perror(("Error! Can not open " + input).c_str());
+        std::exit(1);
+    }
+
+    hts_tpool *pool = NULL;
+    BGZF *outfp = SubseqOpenOutput(output, compress_level, threads, &pool);
+
+    std::vector<bool> found(names.size(), false);
+    size_t n_found = 0;
+    {
+        SeqReader reader(fp);
+        kseq_t *seq;
+        while ((seq = reader.read()) != nullptr) {
+            int64_t i = names.find(seq->name.s, seq->name.l);
+            if (i < 0) continue;
+
+            if (BgzfWriteKseq(outfp, seq) < 0) {
+                std::cerr << "[FastxSubseqScan] Error! Failed to write read: "
+                    << seq->name.s << std::endl;
+                std::exit(1);
+            }
+
+            if (!found[i]) {
+                found[i] = true;
+                ++n_found;
+                if (early_exit && n_found == names.size()) break;
+            }
+        }
+    }
+
+    if (outfp) bgzf_close(outfp);
+    if (pool) hts_tpool_destroy(pool);
+    gzclose(fp);
+
+    if (n_found < names.size()) {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (found[i]) continue;
+            std::cerr << "[FastxSubseqScan] Error! " << names.size() - n_found
+                << " names were not found in " << input << ", e.g. "
+                << names.name(i) << std::endl;
             std::exit(1);
         }
+    }
 
-        ret = bgzf_write(outfp, "\n", 1);
-        if (ret < 0) {
-            std::cerr << "[FastxSubseq] Error! failed to write new line"
-                << std::endl;
+    return 0;
+}
+
+
+/**
+ * @brief extract regions from a .2bit file written by fastx pack. Bases are
+ * unpacked straight from the mapping, there is no index to load and no block
+ * to decompress, so regions are simply fetched in input order. Long regions
+ * are fetched in windows.
+ */
+int FastxSubseqTwoBit(const std::string &input, const Intervals &intervals,
+    bool input_name_list, const SubseqOptions &options,
+    const std::string &output, int compress_level, int threads)
+{
+    TwoBitReader reader(input);
+    std::vector<int64_t> lengths;
+    lengths.reserve(intervals.names().size());
+    for (auto &name: intervals.names()) {
+        int64_t len = reader.length(name);
+        if (len < 0) {
+            std::cerr << "[FastxSubseq] Error! Can not fetch "
+                "sequence of " << name << ", the sequence was "
+                << "not found!" << std::endl;
             std::exit(1);
         }
+        lengths.push_back(len);
+    }
+
+    hts_tpool *pool = NULL;
+    BGZF *outfp = SubseqOpenOutput(output, compress_level, threads, &pool);
+
+    std::string out;
+    std::string seq;
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        const std::string &name = intervals.name(i);
+        bool reverse = intervals.reverse(i);
+        out += '>';
+        out += name;
+        if (!input_name_list) {
+            out += ':' + std::to_string(intervals.start(i) + 1) + '-' +
+                std::to_string(intervals.end(i) + 1) + (reverse ? "/rc" : "");
+        }
+        out += '\n';
+
+        int64_t start = std::max<int64_t>(intervals.start(i), 0);
+        int64_t end = std::min<int64_t>(intervals.end(i),
+            lengths[intervals.name_id(i)] - 1);
+        int64_t n_windows = start <= end ?
+            (end - start) / FASTX_SUBSEQ_STREAM_WINDOW + 1 : 0;
+        int64_t column = 0;
+        int64_t seq_len = 0;
+        for (int64_t k = 0; k < n_windows; ++k) {
+            int64_t w = reverse ? n_windows - 1 - k : k;
+            int64_t window_start = start + w * FASTX_SUBSEQ_STREAM_WINDOW;
+            int64_t window_end = std::min(
+                window_start + FASTX_SUBSEQ_STREAM_WINDOW - 1, end);
+            reader.fetch(name, window_start, window_end, seq);
+            if (reverse) ReverseComplement(&seq[0], seq.size());
+            AppendWrapped(out, seq.data(), seq.size(), options.line_width,
+                column);
+            seq_len += seq.size();
+            if (static_cast<int64_t>(out.size()) >=
+                FASTX_SUBSEQ_STREAM_WINDOW)
+            {
+                BgzfWriteRecord(outfp, out);
+                out.clear();
+            }
+        }
+        AppendLastNewline(out, options.line_width, column, seq_len);
 
-        free(seq);        
+        // small records are written in batches
+        if (static_cast<int64_t>(out.size()) >= FASTX_SUBSEQ_STREAM_WINDOW) {
+            BgzfWriteRecord(outfp, out);
+            out.clear();
+        }
     }
+    if (!out.empty()) BgzfWriteRecord(outfp, out);
 
     if (outfp) bgzf_close(outfp);
     if (pool) hts_tpool_destroy(pool);
@@ -324,16 +1078,21 @@ static
 void Usage() {
     std::cerr << "fastx subseq " << FASTX_VERSION << std::endl;
     std::cerr << std::endl;
-    std::cerr << "  extract subsequences of fasta/fastq.\n"
+    std::cerr << "  extract subsequences of fasta/fastq, or 2bit written by "
+              << "fastx pack.\n"
               << std::endl;
     std::cerr
-            << "Usage: fastx subseq [options] <file.fasta>\n\n"
+            << "Usage: fastx subseq [options] <file.fasta|file.fastq|file.2bit>\n\n"
             << "Options:\n"
             << "  -o, --output, FILE          output file name [stdout]\n"
             << "  -r, --region, STR           comma-separated list of regions\n"
             << "  -R, --region-file, FILE     regions list in file(can be bed file or target name list)\n"
+            << "  -s, --sorted                output in file order instead of input order\n"
+            << "  -w, --line-width, INT       wrap sequence lines to INT bases, 0 for no wrap, fasta only [0]\n"
+            << "  -n, --no-index              stream the input without index(name list only, input can be gzip or -)\n"
+            << "  -e, --early-exit            stop reading once all names were found, valid with -n\n"
             << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
-            << "  -t, --thread, INT           number of threads for compression, valid if output file type is gzip [4]\n"
+            << "  -t, --thread, INT           number of threads for fetching regions and compression [4]\n"
             << "  -h, --help                  print this message and exit.\n"
             << "  -V, --version               print version."
             << std::endl;
@@ -352,19 +1111,27 @@ int FastxSubseqMain(int argc, char **argv)
             {"output", required_argument, 0, 'o'},
             {"region", required_argument, 0, 'r'},
             {"region-file", required_argument, 0, 'R'},
+            {"sorted", no_argument, 0, 's'},
+            {"line-width", required_argument, 0, 'w'},
+            {"no-index", no_argument, 0, 'n'},
+            {"early-exit", no_argument, 0, 'e'},
             {"level", required_argument, 0, 'l'},
             {"thread", required_argument, 0, 't'},
             {"help", no_argument, 0, 'h'},
-            {"version", no_argument, 0, 'V'}
+            {"version", no_argument, 0, 'V'},
+            {0, 0, 0, 0}
     };
 
     int c, long_idx;
-    const char *opt_str = "o:r:R:l:t:hV";
+    const char *opt_str = "o:r:R:sw:nel:t:hV";
 
     std::string input;
     std::string output = "-";
     std::string region;
     std::string region_file;
+    SubseqOptions options;
+    bool no_index = false;
+    bool early_exit = false;
     int compress_level = 6;
     int num_threads = 4;
 
@@ -381,6 +1148,18 @@ int FastxSubseqMain(int argc, char **argv)
             case 'R':
                 region_file = optarg;
                 break;
+            case 's':
+                options.sorted_output = true;
+                break;
+            case 'w':
+                options.line_width = SafeStrtol(optarg, 10);
+                break;
+            case 'n':
+                no_index = true;
+                break;
+            case 'e':
+                early_exit = true;
+                break;
             case 'l':
                 compress_level = SafeStrtol(optarg, 10);
                 break;
@@ -424,41 +1203,76 @@ int FastxSubseqMain(int argc, char **argv)
         std::exit(1);
     }
 
+    if (options.line_width < 0) {
+        std::cerr << "Error! Line width -w(--line-width) must be greater than"
+            << " or equal to 0" << std::endl;
+        std::exit(1);
+    }
+
     if (num_threads < 1) {
         std::cerr << "Error! Number of threads -t(--threads) must greater"
             << " than 0" << std::endl;
         std::exit(1);
     }
 
-    std::vector<Interval> intervals;
+    Intervals intervals;
     if (!region.empty()) {
-        std::vector<std::string> regions = SplitString(region, ',');
-        for (auto &r: regions) {
-            intervals.emplace_back(r);
+        size_t i = 0;
+        size_t j;
+        while ((j = region.find(',', i)) != std::string::npos) {
+            intervals.add(region.data() + i, region.data() + j);
+            i = j + 1;
+        }
+        if (i < region.size()) {
+            intervals.add(region.data() + i, region.data() + region.size());
         }
     } else {
-        std::ifstream instream(region_file);
-        std::string line;
-        while (std::getline(instream, line)) {
-            intervals.emplace_back(line);
+        intervals.load(region_file);
+    }
+
+    bool is_name_list = intervals.is_name_list();
+
+    if (IsTwoBit(input)) {
+        if (no_index) {
+            std::cerr << "Error! -n(--no-index) is not valid for 2bit input"
+                << std::endl;
+            std::exit(1);
         }
+        return FastxSubseqTwoBit(input, intervals, is_name_list, options,
+            output, compress_level, num_threads);
     }
 
-    bool is_name_list = true;
-    for (auto &i: intervals) {
-        if (i.end != FASTX_POS_MAX) {
-            is_name_list = false;
+    if (no_index) {
+        if (!is_name_list) {
+            std::cerr << "Error! -n(--no-index) only works with a name list"
+                << std::endl;
+            std::exit(1);
+        }
+        if (options.line_width > 0 || options.sorted_output) {
+            std::cerr << "Error! -w(--line-width) and -s(--sorted) need index"
+                << ", they are conflict with -n(--no-index)" << std::endl;
+            std::exit(1);
         }
+        return FastxSubseqScan(input, intervals, early_exit, output,
+            compress_level, num_threads);
+    }
+
+    bool is_fastq = IsFastq(input.c_str());
+    if (is_fastq && options.line_width > 0) {
+        std::cerr << "Error! -w(--line-width) is only valid for fasta input"
+            << std::endl;
+        std::exit(1);
     }
 
-    faidx_t *fai = fai_load(input.c_str());
+    faidx_t *fai = fai_load_format(input.c_str(),
+        is_fastq ? FAI_FASTQ : FAI_FASTA);
     if (fai == nullptr) {
         std::cerr << "Error! Fail to load fai index for fasta " << input
             << std::endl;
         std::exit(1);
     }
 
-    FastxSubseq(fai, intervals, is_name_list, output,
+    FastxSubseq(input, fai, intervals, is_name_list, options, output,
         compress_level, num_threads);
 
     fai_destroy(fai);
@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <unistd.h>
+
+#include "htslib/bgzf.h"
+#include "htslib/thread_pool.h"
+#include "zlib.h"
+#include "batch_pipeline.hpp"
+#include "fastx_trim.hpp"
+#include "kseq_utils.hpp"
+#include "seq_reader.hpp"
+#include "trim.hpp"
+#include "utils.hpp"
+#include "version.hpp"
+
+
+// long only options
+const int FASTX_TRIM_OPT_INTERLEAVED = 256;
+
+
+struct TrimOptions {
+    // 3' and 5' adapters of read1 and read2
+    std::string adapter1;
+    std::string adapter2;
+    std::string front1;
+    std::string front2;
+    double error_rate = 0.1;
+    int min_overlap = 3;
+    int window = 4;
+    // min mean quality of windows, 0 for no quality trimming
+    int min_qual = 0;
+    // min length of poly-G and poly-A tails to trim, 0 for none
+    int poly_g = 0;
+    int poly_a = 0;
+    int64_t min_len = 0;
+};
+
+
+/**
+ * @brief range [begin, end) of a record kept after trimming, in order: 5'
+ * adapter, 3' adapter, poly-G and poly-A tails, then low quality windows.
+ */
+static
+void TrimRange(const kseq_t *seq, const std::string &adapter,
+    const std::string &front, const TrimOptions &options, size_t *begin,
+    size_t *end)
+{
+    const char *s = seq->seq.s;
+    size_t b = FindAdapter5(s, seq->seq.l, front, options.error_rate,
+        options.min_overlap);
+    size_t e = b + FindAdapter3(s + b, seq->seq.l - b, adapter,
+        options.error_rate, options.min_overlap);
+    if (options.poly_g) {
+        e = b + PolyTailStart(s + b, e - b, 'G', options.poly_g);
+    }
+    if (options.poly_a) {
+        e = b + PolyTailStart(s + b, e - b, 'A', options.poly_a);
+    }
+    if (options.min_qual && seq->qual.l) {
+        e = b + QualityWindowCut(seq->qual.s + b, e - b, options.window,
+            options.min_qual);
+    }
+    *begin = b;
+    *end = e;
+}
+
+
+/**
+ * @brief trim single or paired fasta/q in one streaming pass. Workers take
+ * batches from SeqReader(PairReader for pairs), trim them and format the kept
+ * ranges straight from the read buffers, this thread writes the batches in
+ * input order. Mates shorter than min_len after trimming are dropped
+ * together.
+ *
+ * @param input2 read2 input, empty for single end or interleaved input1
+ * @param interleaved input1 is interleaved pairs, written interleaved to
+ * output1
+ */
+int FastxTrim(const std::string &input1, const std::string &input2,
+    const std::string &output1, const std::string &output2, bool interleaved,
+    const TrimOptions &options, int compress_level, int threads)
+{
+    bool paired = !input2.empty() || interleaved;
+
+    gzFile fp1 = input1 == "-" ?
+        gzdopen(STDIN_FILENO, "r") : gzopen(input1.c_str(), "r");
+    if (fp1 == nullptr) {
+        std::perror(("Error! Can not open " + input1).c_str());
+        std::exit(1);
+    }
+    gzFile fp2 = nullptr;
+    if (!input2.empty()) {
+        fp2 = gzopen(input2.c_str(), "r");
+        if (fp2 == nullptr) {
+            std::perror(("Error! Can not open " + input2).c_str());
+            std::exit(1);
+        }
+    }
+
+    hts_tpool *pool = hts_tpool_init(threads);
+    if (pool == NULL) {
+        std::cerr << "Error! hts_tpool_init can not init thread pool "
+            << std::endl;
+        std::exit(1);
+    }
+    BGZF *outfp1 = BgzfOpenOutput(output1, compress_level, pool);
+    BGZF *outfp2 = !input2.empty() ?
+        BgzfOpenOutput(output2, compress_level, pool) : nullptr;
+
+    {
+        // mates are checked by PairReader
+        std::unique_ptr<SeqReader> reader(
+            paired ? nullptr : new SeqReader(fp1));
+        std::unique_ptr<PairReader> pair_reader(
+            paired ? new PairReader(fp1, fp2) : nullptr);
+
+        struct Result {
+            kstring_t out1 = {0, 0, NULL};
+            kstring_t out2 = {0, 0, NULL};
+        };
+
+        struct Batch {
+            KseqArray *reads = nullptr;
+            PairReader::Batch pairs;
+        };
+
+        auto take = [&](Batch *batch, uint64_t *id) {
+            return paired ? pair_reader->read_batch(&batch->pairs, id) :
+                (batch->reads = reader->read_batch(id)) != nullptr;
+        };
+
+        auto process = [&](Batch *batch, uint64_t, Result *result) {
+            // mates of interleaved input are written together
+            kstring_t *out2 = interleaved ? &result->out1 : &result->out2;
+            int size = paired ? batch->pairs.size() : batch->reads->size();
+            for (int i = 0; i < size; ++i) {
+                kseq_t *read1 = paired ?
+                    batch->pairs.read1(i) : batch->reads->get(i);
+                kseq_t *read2 = paired ? batch->pairs.read2(i) : nullptr;
+                size_t begin1, end1;
+                size_t begin2 = 0, end2 = 0;
+                TrimRange(read1, options.adapter1, options.front1,
+                    options, &begin1, &end1);
+                if (paired) {
+                    TrimRange(read2, options.adapter2, options.front2,
+                        options, &begin2, &end2);
+                }
+                if (static_cast<int64_t>(end1 - begin1) < options.min_len) {
+                    continue;
+                }
+                if (paired &&
+                    static_cast<int64_t>(end2 - begin2) < options.min_len)
+                {
+                    continue;
+                }
+
+                if (KstringAppendKseqRange(&result->out1, read1, begin1,
+                        end1) < 0 ||
+                    (paired && KstringAppendKseqRange(out2, read2, begin2,
+                        end2) < 0))
+                {
+                    std::cerr << "Error! Failed to buffer read: "
+                        << read1->name.s << std::endl;
+                    std::exit(1);
+                }
+            }
+            if (paired) {
+                pair_reader->release(&batch->pairs);
+            } else {
+                reader->release(batch->reads);
+            }
+        };
+
+        auto write = [&](Result &result) {
+            BgzfWriteOutput(outfp1, result.out1, output1);
+            if (outfp2) BgzfWriteOutput(outfp2, result.out2, output2);
+            free(result.out1.s);
+            free(result.out2.s);
+        };
+
+        RunBatchPipeline<Batch, Result>(threads, take, process, write);
+    }
+
+    if (bgzf_close(outfp1) < 0 || (outfp2 && bgzf_close(outfp2) < 0)) {
+        std::cerr << "Error! Failed to close output" << std::endl;
+        std::exit(1);
+    }
+    hts_tpool_destroy(pool);
+    gzclose(fp1);
+    if (fp2) gzclose(fp2);
+
+    return 0;
+}
+
+
+static
+void Usage() {
+    std::cerr << "fastx trim " << FASTX_VERSION << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "  trim adapters, poly-G/poly-A tails and low quality 3' "
+              << "ends of reads.\n"
+              << std::endl;
+    std::cerr
+            << "Usage: fastx trim [options] -i <in1> [-I <in2>] [-o <out1>] [-O <out2>]\n\n"
+            << "Options:\n"
+            << "  -i, --in1, FILE             input fasta/fastq file name for read1, - for stdin.\n"
+            << "  -I, --in2, FILE             input fasta/fastq file name for read2.\n"
+            << "  -o, --out1, FILE            output file name for read1 [stdout]\n"
+            << "  -O, --out2, FILE            output file name for read2.\n"
+            << "      --interleaved           input1 is interleaved pairs, written interleaved to output1.\n"
+            << "  -a, --adapter, STR          3' adapter of read1, removed with the bases after it\n"
+            << "  -A, --adapter2, STR         3' adapter of read2\n"
+            << "  -g, --front, STR            5' adapter of read1, removed with the bases before it\n"
+            << "  -G, --front2, STR           5' adapter of read2\n"
+            << "  -e, --error-rate, FLOAT     max mismatches per base of adapter overlap [0.1]\n"
+            << "  -k, --min-overlap, INT      min overlap of an adapter at the read end [3]\n"
+            << "  -q, --quality, INT          cut the 3' end from the first window with mean\n"
+            << "                              quality below INT, 0 for no quality trimming [0]\n"
+            << "  -w, --window, INT           window size of quality trimming(1 to 256) [4]\n"
+            << "  -p, --poly-g, INT           trim poly-G tails of at least INT bases, 0 for none [0]\n"
+            << "  -P, --poly-a, INT           trim poly-A tails of at least INT bases, 0 for none [0]\n"
+            << "  -m, --min-len, INT          drop reads(pairs) shorter than INT after trimming [0]\n"
+            << "  -l, --level, INT            compression level(0 to 9, or 11), valid if output file type is gzip [6]\n"
+            << "  -t, --thread, INT           number of threads for trimming and compression [4]\n"
+            << "  -h, --help                  print this message and exit.\n"
+            << "  -V, --version               print version.\n\n"
+            << "  Adapters are aligned without gaps. Poly tails allow one mismatch per 8\n"
+            << "  bases."
+            << std::endl;
+}
+
+
+int FastxTrimMain(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Usage();
+        return 0;
+    }
+
+    static const struct option long_options[] = {
+            {"in1", required_argument, 0, 'i'},
+            {"in2", required_argument, 0, 'I'},
+            {"out1", required_argument, 0, 'o'},
+            {"out2", required_argument, 0, 'O'},
+            {"adapter", required_argument, 0, 'a'},
+            {"adapter2", required_argument, 0, 'A'},
+            {"front", required_argument, 0, 'g'},
+            {"front2", required_argument, 0, 'G'},
+            {"error-rate", required_argument, 0, 'e'},
+            {"min-overlap", required_argument, 0, 'k'},
+            {"quality", required_argument, 0, 'q'},
+            {"window", required_argument, 0, 'w'},
+            {"poly-g", required_argument, 0, 'p'},
+            {"poly-a", required_argument, 0, 'P'},
+            {"min-len", required_argument, 0, 'm'},
+            {"level", required_argument, 0, 'l'},
+            {"thread", required_argument, 0, 't'},
+            {"help", no_argument, 0, 'h'},
+            {"version", no_argument, 0, 'V'},
+            {"interleaved", no_argument, 0, FASTX_TRIM_OPT_INTERLEAVED},
+            {0, 0, 0, 0}
+    };
+
+    int c, long_idx;
+    const char *opt_str = "i:I:o:O:a:A:g:G:e:k:q:w:p:P:m:l:t:hV";
+
+    std::string input1;
+    std::string input2;
+    std::string output1 = "-";
+    std::string output2;
+    TrimOptions options;
+    int compress_level = 6;
+    int num_threads = 4;
+    bool interleaved = false;
+
+    while ((c = getopt_long(
+        argc, argv, opt_str, long_options, &long_idx)) != -1)
+    {
+        switch (c) {
+            case 'i':
+                input1 = optarg;
+                break;
+            case 'I':
+                input2 = optarg;
+                break;
+            case 'o':
+                output1 = optarg;
+                break;
+            case 'O':
+                output2 = optarg;
+                break;
+            case 'a':
+                options.adapter1 = optarg;
+                break;
+            case 'A':
+                options.adapter2 = optarg;
+                break;
+            case 'g':
+                options.front1 = optarg;
+                break;
+            case 'G':
+                options.front2 = optarg;
+                break;
+            case 'e':
+                options.error_rate = SafeStrtod(optarg);
+                break;
+            case 'k':
+                options.min_overlap = SafeStrtol(optarg, 10);
+                break;
+            case 'q':
+                options.min_qual = SafeStrtol(optarg, 10);
+                break;
+            case 'w':
+                options.window = SafeStrtol(optarg, 10);
+                break;
+            case 'p':
+                options.poly_g = SafeStrtol(optarg, 10);
+                break;
+            case 'P':
+                options.poly_a = SafeStrtol(optarg, 10);
+                break;
+            case 'm':
+                options.min_len = SafeStrtol(optarg, 10);
+                break;
+            case 'l':
+                compress_level = SafeStrtol(optarg, 10);
+                break;
+            case 't':
+                num_threads = SafeStrtol(optarg, 10);
+                break;
+            case FASTX_TRIM_OPT_INTERLEAVED:
+                interleaved = true;
+                break;
+            case 'h':
+                Usage();
+                return 0;
+            case 'V':
+                std::cerr << FASTX_VERSION << std::endl;
+                return 0;
+            default:
+                Usage();
+                return 1;
+        }
+    }
+
+    if (input1.empty()) {
+        std::cerr << "Error! Must set at least one input fasta/fastq file "
+            << "using -i(--in1)." << std::endl;
+        std::exit(1);
+    }
+
+    if (interleaved && (!input2.empty() || !output2.empty())) {
+        std::cerr << "Error! -I(--in2) and -O(--out2) can not be used with "
+            << "--interleaved." << std::endl;
+        std::exit(1);
+    }
+
+    if (!input2.empty() && output2.empty()) {
+        std::cerr << "Error! Must set at the second output fasta/fastq file "
+            << "using -O(--out2) When inputting 2 fasta/fastq files."
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (input2.empty() && !output2.empty()) {
+        std::cerr << "Error! -O(--out2) needs the second input file "
+            << "-I(--in2)." << std::endl;
+        std::exit(1);
+    }
+
+    if (input2 == "-") {
+        std::cerr << "Error! Only read1 can be read from stdin" << std::endl;
+        std::exit(1);
+    }
+
+    if (input2.empty() && !interleaved &&
+        (!options.adapter2.empty() || !options.front2.empty()))
+    {
+        std::cerr << "Error! -A(--adapter2) and -G(--front2) need the second "
+            << "input file -I(--in2) or --interleaved." << std::endl;
+        std::exit(1);
+    }
+
+    if (options.error_rate < 0 || options.error_rate >= 1) {
+        std::cerr << "Error! -e(--error-rate) must be in [0, 1)" << std::endl;
+        std::exit(1);
+    }
+
+    if (options.min_overlap < 1) {
+        std::cerr << "Error! -k(--min-overlap) must be greater than 0"
+            << std::endl;
+        std::exit(1);
+    }
+
+    if (options.window < 1 || options.window > TRIM_MAX_WINDOW) {
+        std::cerr << "Error! -w(--window) must be in [1, " << TRIM_MAX_WINDOW
+            << "]" << std::endl;
+        std::exit(1);
+    }
+
+    if (options.min_qual < 0 || options.min_qual > 93) {
+        std::cerr << "Error! -q(--quality) must be in [0, 93]" << std::endl;
+        std::exit(1);
+    }
+
+    if (options.poly_g < 0 || options.poly_a < 0) {
+        std::cerr << "Error! -p(--poly-g) and -P(--poly-a) must be greater "
+            << "than or equal to 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (compress_level < 0) {
+        std::cerr << "Error! Compression level must be greater than or equal to"
+            << " 0" << std::endl;
+        std::exit(1);
+    }
+
+    if (num_threads < 1) {
+        std::cerr << "Error! Number of threads -t(--threads) must greater"
+            << " than 0" << std::endl;
+        std::exit(1);
+    }
+
+    return FastxTrim(input1, input2, output1, output2, interleaved,
+        options, compress_level, num_threads);
+}
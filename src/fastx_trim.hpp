@@ -0,0 +1,8 @@
+#ifndef FASTX_TRIM_CMD_HPP
+#define FASTX_TRIM_CMD_HPP
+
+
+int FastxTrimMain(int argc, char **argv);
+
+
+#endif  // FASTX_TRIM_CMD_HPP
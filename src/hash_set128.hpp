@@ -0,0 +1,190 @@
+#ifndef FASTX_HASH_SET128_HPP
+#define FASTX_HASH_SET128_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+
+const double HASH_SET128_MAX_LOAD = 0.75;
+
+
+struct Hash128 {
+    uint64_t lo;
+    uint64_t hi;
+
+    bool operator==(const Hash128 &other) const {
+        return lo == other.lo && hi == other.hi;
+    }
+};
+
+
+static inline
+uint64_t Rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+
+static inline
+uint64_t Fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+
+/**
+ * @brief 128-bit MurmurHash3(x64 variant) of data. Chain hashes of several
+ * keys by passing the previous hash as seed.
+ */
+inline
+Hash128 MurmurHash128(const void *data, size_t len, Hash128 seed = {0, 0}) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    const size_t n_blocks = len / 16;
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = seed.lo;
+    uint64_t h2 = seed.hi;
+
+    for (size_t i = 0; i < n_blocks; ++i) {
+        uint64_t k1;
+        uint64_t k2;
+        std::memcpy(&k1, p + i * 16, 8);
+        std::memcpy(&k2, p + i * 16 + 8, 8);
+
+        k1 *= c1; k1 = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = Rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = Rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    const uint8_t *tail = p + n_blocks * 16;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    switch (len & 15) {
+        case 15: k2 ^= static_cast<uint64_t>(tail[14]) << 48; // fall through
+        case 14: k2 ^= static_cast<uint64_t>(tail[13]) << 40; // fall through
+        case 13: k2 ^= static_cast<uint64_t>(tail[12]) << 32; // fall through
+        case 12: k2 ^= static_cast<uint64_t>(tail[11]) << 24; // fall through
+        case 11: k2 ^= static_cast<uint64_t>(tail[10]) << 16; // fall through
+        case 10: k2 ^= static_cast<uint64_t>(tail[9]) << 8;   // fall through
+        case 9:
+            k2 ^= static_cast<uint64_t>(tail[8]);
+            k2 *= c2; k2 = Rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+            // fall through
+        case 8: k1 ^= static_cast<uint64_t>(tail[7]) << 56;   // fall through
+        case 7: k1 ^= static_cast<uint64_t>(tail[6]) << 48;   // fall through
+        case 6: k1 ^= static_cast<uint64_t>(tail[5]) << 40;   // fall through
+        case 5: k1 ^= static_cast<uint64_t>(tail[4]) << 32;   // fall through
+        case 4: k1 ^= static_cast<uint64_t>(tail[3]) << 24;   // fall through
+        case 3: k1 ^= static_cast<uint64_t>(tail[2]) << 16;   // fall through
+        case 2: k1 ^= static_cast<uint64_t>(tail[1]) << 8;    // fall through
+        case 1:
+            k1 ^= static_cast<uint64_t>(tail[0]);
+            k1 *= c1; k1 = Rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= len;
+    h2 ^= len;
+    h1 += h2;
+    h2 += h1;
+    h1 = Fmix64(h1);
+    h2 = Fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    return Hash128{h1, h2};
+}
+
+
+/**
+ * @brief compact set of 128-bit hashes, an open addressing table(linear
+ * probing) of the hashes themselves, 16 bytes per slot and nothing else.
+ * The all zero hash marks empty slots and is stored as {0, 1}.
+ */
+class HashSet128 {
+public:
+    HashSet128(): slots_(16, Hash128{0, 0}), mask_(15) {}
+
+    /**
+     * @brief insert a hash
+     *
+     * @return true if the hash is new, false if already in the set
+     */
+    bool insert(Hash128 hash) {
+        if (hash.lo == 0 && hash.hi == 0) hash.hi = 1;
+        if (will_grow()) Rehash(slots_.size() * 2);
+
+        size_t i = hash.lo & mask_;
+        while (!Empty(slots_[i])) {
+            if (slots_[i] == hash) return false;
+            i = (i + 1) & mask_;
+        }
+        slots_[i] = hash;
+        ++size_;
+        return true;
+    }
+
+    // the next insert doubles the table
+    bool will_grow() const {
+        return size_ + 1 > slots_.size() * HASH_SET128_MAX_LOAD;
+    }
+
+    // make room for n hashes without growing
+    void reserve(size_t n) {
+        size_t capacity = slots_.size();
+        while (n > capacity * HASH_SET128_MAX_LOAD) capacity *= 2;
+        if (capacity > slots_.size()) Rehash(capacity);
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    // memory of the table
+    size_t bytes() const {
+        return slots_.size() * sizeof(Hash128);
+    }
+
+    template <typename Func>
+    void for_each(Func func) const {
+        for (const Hash128 &slot: slots_) {
+            if (!Empty(slot)) func(slot);
+        }
+    }
+
+    void clear() {
+        std::vector<Hash128>(16, Hash128{0, 0}).swap(slots_);
+        mask_ = 15;
+        size_ = 0;
+    }
+
+private:
+    static bool Empty(const Hash128 &slot) {
+        return slot.lo == 0 && slot.hi == 0;
+    }
+
+    void Rehash(size_t capacity) {
+        std::vector<Hash128> slots(capacity, Hash128{0, 0});
+        size_t mask = capacity - 1;
+        for (const Hash128 &slot: slots_) {
+            if (Empty(slot)) continue;
+            size_t i = slot.lo & mask;
+            while (!Empty(slots[i])) i = (i + 1) & mask;
+            slots[i] = slot;
+        }
+        slots_.swap(slots);
+        mask_ = mask;
+    }
+
+    std::vector<Hash128> slots_;
+    size_t mask_;
+    size_t size_ = 0;
+};
+
+
+#endif  // FASTX_HASH_SET128_HPP
@@ -1,11 +1,20 @@
+#include <algorithm>
 #include <climits>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <thread>
 #include <iostream>
 #include <sstream>
 #include <cmath>
+#include <filesystem>
+#include <fstream>
 #include "kseq_utils.hpp"
+#include "qual_map.hpp"
+
+namespace fs = std::filesystem;
+
+const char *FASTX_COUNT_SIDECAR_SUFFIX = ".count";
 
 void FastxCount(const std::string &filename, int64_t &reads, int64_t &bases)
 {
@@ -66,6 +75,37 @@ void FastxCountPair(const std::string &ifilename1,
 }
 
 
+bool LoadCountSidecar(const std::string &filename, int64_t &reads,
+    int64_t &bases)
+{
+    std::string sidecar = filename + FASTX_COUNT_SIDECAR_SUFFIX;
+    std::error_code ec;
+    if (!fs::is_regular_file(sidecar, ec)) return false;
+    if (fs::last_write_time(sidecar, ec) < fs::last_write_time(filename, ec)
+        || ec)
+    {
+        return false;
+    }
+
+    std::ifstream instream(sidecar);
+    if (!(instream >> reads >> bases) || reads < 0 || bases < 0) {
+        return false;
+    }
+
+    return true;
+}
+
+
+void SaveCountSidecar(const std::string &filename, int64_t reads,
+    int64_t bases)
+{
+    std::ofstream outstream(filename + FASTX_COUNT_SIDECAR_SUFFIX);
+    if (outstream) {
+        outstream << reads << "\t" << bases << "\n";
+    }
+}
+
+
 std::string kseqToStr(const kseq_t *seq) {
     std::ostringstream seq_str;
     seq_str << (seq->qual.l ? "@" : ">");
@@ -116,6 +156,90 @@ int BgzfWriteKseq(BGZF *fp, const kseq_t *seq) {
 }
 
 
+int KstringAppendKseq(kstring_t *str, const kseq_t *seq) {
+    return KstringAppendKseqRange(str, seq, 0, seq->seq.l);
+}
+
+
+int KstringAppendKseqRange(kstring_t *str, const kseq_t *seq, size_t begin,
+    size_t end)
+{
+    static const KseqFormat format;
+    return KstringAppendKseqFormat(str, seq, begin, end, format);
+}
+
+
+int KstringAppendKseqFormat(kstring_t *str, const kseq_t *seq, size_t begin,
+    size_t end, const KseqFormat &format)
+{
+    bool fastq = format.type == KseqOutputType::kKeep ?
+        seq->qual.l > 0 : format.type == KseqOutputType::kFastq;
+    size_t n = end - begin;
+    int64_t width = fastq ? 0 : format.line_width;
+    const char *name = format.name ? format.name : seq->name.s;
+    size_t name_len = format.name ? format.name_len : seq->name.l;
+    size_t comment_len = format.strip_comment ? 0 : seq->comment.l;
+
+    size_t len = 1 + name_len + 1 + n + 1;
+    if (comment_len) len += 1 + comment_len;
+    if (width > 0 && n > 0) len += (n - 1) / width;
+    if (fastq) len += 2 + n + 1;
+    if (ks_resize(str, str->l + len + 1) < 0) return -1;
+
+    char *p = str->s + str->l;
+    *p++ = fastq ? '@' : '>';
+    memcpy(p, name, name_len);
+    p += name_len;
+    if (comment_len) {
+        *p++ = ' ';
+        memcpy(p, seq->comment.s, comment_len);
+        p += comment_len;
+    }
+    *p++ = '\n';
+    if (width > 0) {
+        for (size_t i = 0; i < n; i += width) {
+            if (i) *p++ = '\n';
+            size_t m = std::min<size_t>(width, n - i);
+            memcpy(p, seq->seq.s + begin + i, m);
+            p += m;
+        }
+    } else {
+        memcpy(p, seq->seq.s + begin, n);
+        p += n;
+    }
+    *p++ = '\n';
+    if (fastq) {
+        *p++ = '+';
+        *p++ = '\n';
+        if (seq->qual.l) {
+            memcpy(p, seq->qual.s + begin, n);
+            if (format.qual_map) format.qual_map->apply(p, n);
+        } else {
+            memset(p, format.fake_qual + 33, n);
+        }
+        p += n;
+        *p++ = '\n';
+    }
+    *p = '\0';
+    str->l += len;
+    return 0;
+}
+
+
+bool IsMatePair(const kseq_t *read1, const kseq_t *read2)
+{
+    size_t l1 = read1->name.l;
+    size_t l2 = read2->name.l;
+    if (l1 >= 2 && read1->name.s[l1-2] == '/' && read1->name.s[l1-1] == '1') {
+        l1 -= 2;
+    }
+    if (l2 >= 2 && read2->name.s[l2-2] == '/' && read2->name.s[l2-1] == '2') {
+        l2 -= 2;
+    }
+    return l1 == l2 && memcmp(read1->name.s, read2->name.s, l1) == 0;
+}
+
+
 bool IsFastq(const char *path)
 {
     gzFile fp = gzopen(path, "r");
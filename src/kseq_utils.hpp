@@ -17,12 +17,96 @@ void FastxCount(const std::string &filename, int64_t &reads, int64_t &bases);
 void FastxCountPair(const std::string &ifilename1,
     const std::string &ifilename2, int64_t &reads, int64_t &bases);
 
+/**
+ * @brief load reads and bases of a fasta/q file from its count sidecar
+ * (<filename>.count, one line of "reads<TAB>bases"). A sidecar older than
+ * the input file is ignored.
+ * 
+ * @param filename input fasta/q file path
+ * @param reads number of reads
+ * @param bases number of bases
+ * @return true if a valid sidecar was found
+ */
+bool LoadCountSidecar(const std::string &filename, int64_t &reads,
+    int64_t &bases);
+
+/**
+ * @brief save reads and bases of a fasta/q file to its count sidecar, fail
+ * silently if the sidecar can not be written(e.g. read-only directory).
+ */
+void SaveCountSidecar(const std::string &filename, int64_t reads,
+    int64_t bases);
+
 
 std::string kseqToStr(const kseq_t *seq);
 
 
 int BgzfWriteKseq(BGZF *fp, const kseq_t *seq);
 
+/**
+ * @brief append a fasta/q record to the end of str, same format as
+ * BgzfWriteKseq. Used to buffer records before writing in batch.
+ * 
+ * @return int 0 on success, -1 on failure
+ */
+int KstringAppendKseq(kstring_t *str, const kseq_t *seq);
+
+/**
+ * @brief append the record with only bases [begin, end) of the sequence and
+ * quality, read in place from seq. A fastq record stays fastq when empty.
+ * 
+ * @return int 0 on success, -1 on failure
+ */
+int KstringAppendKseqRange(kstring_t *str, const kseq_t *seq, size_t begin,
+    size_t end);
+
+
+class QualMap;
+
+enum class KseqOutputType {
+    // same as the input record
+    kKeep,
+    kFasta,
+    kFastq
+};
+
+/**
+ * @brief how KstringAppendKseqFormat writes a record, the defaults write it
+ * as KstringAppendKseq does
+ */
+struct KseqFormat {
+    // replaces the name of the record if not NULL
+    const char *name = nullptr;
+    size_t name_len = 0;
+    bool strip_comment = false;
+    KseqOutputType type = KseqOutputType::kKeep;
+    // quality of records without quality written as fastq
+    int fake_qual = 40;
+    // applied to the written quality, NULL for none
+    const QualMap *qual_map = nullptr;
+    // wrap sequence lines of fasta records, 0 for no wrap
+    int64_t line_width = 0;
+};
+
+/**
+ * @brief append the record with only bases [begin, end), converted to the
+ * format. seq is not changed.
+ *
+ * @return int 0 on success, -1 on failure
+ */
+int KstringAppendKseqFormat(kstring_t *str, const kseq_t *seq, size_t begin,
+    size_t end, const KseqFormat &format);
+
+/**
+ * @brief check whether two records are mates of a read pair, the names must
+ * be equal after removing the trailing /1 and /2 of read1 and read2.
+ * 
+ * @param read1 record from the read1 file
+ * @param read2 record from the read2 file
+ * @return true if the names of the records match
+ */
+bool IsMatePair(const kseq_t *read1, const kseq_t *read2);
+
 /**
  * @brief detect if the input file is a fasta/fastq
  * 
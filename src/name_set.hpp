@@ -0,0 +1,164 @@
+#ifndef FASTX_NAME_SET_HPP
+#define FASTX_NAME_SET_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+const double NAME_SET_MAX_LOAD = 0.5;
+
+// bits of the bloom filter per name, set by build_bloom
+const int NAME_SET_BLOOM_BITS_PER_NAME = 8;
+
+
+/**
+ * @brief compact set of sequence names for streaming lookups.
+ *
+ * Names are stored back to back in one arena, the open addressing table
+ * (linear probing) only holds 32-bit name indices, so a set of millions of
+ * names costs the names plus a few words per name. Indices are assigned
+ * in insertion order and can be used to mark found names.
+ *
+ * For huge sets the table does not fit in cache and most lookups(reads not
+ * in the set) would miss it. build_bloom puts a blocked bloom filter in
+ * front of the table, which answers most negative lookups from one word.
+ */
+class NameSet {
+public:
+    NameSet(): slots_(16, 0), mask_(15) {}
+
+    /**
+     * @brief insert a name
+     *
+     * @return true if the name is new, false if already in the set
+     */
+    bool insert(const char *name, size_t len) {
+        if ((size() + 1) > slots_.size() * NAME_SET_MAX_LOAD) {
+            Rehash(slots_.size() * 2);
+        }
+
+        uint64_t hash = Hash(name, len);
+        size_t i = hash & mask_;
+        while (slots_[i]) {
+            if (Equal(slots_[i] - 1, name, len)) return false;
+            i = (i + 1) & mask_;
+        }
+
+        slots_[i] = static_cast<uint32_t>(size() + 1);
+        offsets_.push_back(arena_.size());
+        hashes_.push_back(hash);
+        arena_.append(name, len);
+        arena_.push_back('\0');
+        if (!bloom_.empty()) BloomAdd(hash);
+        return true;
+    }
+
+    /**
+     * @brief find a name
+     *
+     * @return int64_t index of the name(in insertion order), -1 if not found
+     */
+    int64_t find(const char *name, size_t len) const {
+        uint64_t hash = Hash(name, len);
+        if (!bloom_.empty() && !BloomMayContain(hash)) return -1;
+
+        size_t i = hash & mask_;
+        while (slots_[i]) {
+            if (hashes_[slots_[i] - 1] == hash &&
+                Equal(slots_[i] - 1, name, len))
+            {
+                return slots_[i] - 1;
+            }
+            i = (i + 1) & mask_;
+        }
+        return -1;
+    }
+
+    // name of index i, as a C-string
+    const char *name(size_t i) const {
+        return arena_.data() + offsets_[i];
+    }
+
+    size_t size() const {
+        return offsets_.size();
+    }
+
+    /**
+     * @brief build a bloom filter of the names, checked before the table by
+     * find. Names inserted later are added to the filter as well.
+     */
+    void build_bloom(int bits_per_name = NAME_SET_BLOOM_BITS_PER_NAME) {
+        size_t n_words = 1;
+        while (n_words * 64 < size() * bits_per_name) n_words <<= 1;
+        bloom_.assign(n_words, 0);
+        for (uint64_t hash: hashes_) BloomAdd(hash);
+    }
+
+private:
+    static uint64_t Hash(const char *s, size_t len) {
+        // FNV-1a with a murmur3 finalizer to spread the bits
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < len; ++i) {
+            h ^= static_cast<unsigned char>(s[i]);
+            h *= 1099511628211ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    bool Equal(size_t i, const char *name, size_t len) const {
+        const char *s = arena_.data() + offsets_[i];
+        size_t s_len = (i + 1 < offsets_.size() ?
+            offsets_[i+1] : arena_.size()) - offsets_[i] - 1;
+        return s_len == len && std::memcmp(s, name, len) == 0;
+    }
+
+    void Rehash(size_t n_slots) {
+        slots_.assign(n_slots, 0);
+        mask_ = n_slots - 1;
+        for (size_t k = 0; k < hashes_.size(); ++k) {
+            size_t i = hashes_[k] & mask_;
+            while (slots_[i]) i = (i + 1) & mask_;
+            slots_[i] = static_cast<uint32_t>(k + 1);
+        }
+    }
+
+    // the table probes with the low bits of the hash, the filter takes its
+    // word from the mixed hash and its 4 bits from the middle bits
+    uint64_t BloomMask(uint64_t hash) const {
+        return (1ULL << ((hash >> 26) & 63)) | (1ULL << ((hash >> 32) & 63)) |
+            (1ULL << ((hash >> 38) & 63)) | (1ULL << ((hash >> 44) & 63));
+    }
+
+    size_t BloomWord(uint64_t hash) const {
+        return ((hash * 0x9e3779b97f4a7c15ULL) >> 32) & (bloom_.size() - 1);
+    }
+
+    void BloomAdd(uint64_t hash) {
+        bloom_[BloomWord(hash)] |= BloomMask(hash);
+    }
+
+    bool BloomMayContain(uint64_t hash) const {
+        uint64_t mask = BloomMask(hash);
+        return (bloom_[BloomWord(hash)] & mask) == mask;
+    }
+
+    std::string arena_;
+    std::vector<size_t> offsets_;
+    std::vector<uint64_t> hashes_;
+    // name index + 1, 0 for empty slot
+    std::vector<uint32_t> slots_;
+    size_t mask_;
+    std::vector<uint64_t> bloom_;
+};
+
+
+#endif  // FASTX_NAME_SET_HPP
@@ -0,0 +1,146 @@
+#include "qual_map.hpp"
+#include "utils.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FASTX_QUAL_MAP_X86 1
+#endif
+
+
+// max phred score of a printable phred+33 character('~')
+const int QUAL_MAP_MAX_QUAL = 93;
+
+
+static
+void MapBytesScalar(char *s, size_t n, const uint8_t *table) {
+    for (size_t i = 0; i < n; ++i) {
+        s[i] = table[static_cast<uint8_t>(s[i])];
+    }
+}
+
+
+#ifdef FASTX_QUAL_MAP_X86
+
+/*
+ * The table is 16 rows of 16 entries, a row is looked up by the low nibble
+ * with pshufb and selected where the high nibble equals its row number.
+ */
+
+__attribute__((target("ssse3")))
+static
+void MapBytesSsse3(char *s, size_t n, const uint8_t *table) {
+    __m128i rows[16];
+    for (int k = 0; k < 16; ++k) {
+        rows[k] = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(table + 16 * k));
+    }
+    const __m128i low_mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+        __m128i low = _mm_and_si128(x, low_mask);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(x, 4), low_mask);
+        __m128i y = _mm_setzero_si128();
+        for (int k = 0; k < 16; ++k) {
+            __m128i row = _mm_cmpeq_epi8(high, _mm_set1_epi8(k));
+            y = _mm_or_si128(y,
+                _mm_and_si128(row, _mm_shuffle_epi8(rows[k], low)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(s + i), y);
+    }
+    MapBytesScalar(s + i, n - i, table);
+}
+
+
+__attribute__((target("avx2")))
+static
+void MapBytesAvx2(char *s, size_t n, const uint8_t *table) {
+    // pshufb looks up within 128-bit lanes, both lanes hold the row
+    __m256i rows[16];
+    for (int k = 0; k < 16; ++k) {
+        rows[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(table + 16 * k)));
+    }
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(s + i));
+        __m256i low = _mm256_and_si256(x, low_mask);
+        __m256i high = _mm256_and_si256(_mm256_srli_epi16(x, 4), low_mask);
+        __m256i y = _mm256_setzero_si256();
+        for (int k = 0; k < 16; ++k) {
+            __m256i row = _mm256_cmpeq_epi8(high, _mm256_set1_epi8(k));
+            y = _mm256_or_si256(y,
+                _mm256_and_si256(row, _mm256_shuffle_epi8(rows[k], low)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(s + i), y);
+    }
+    MapBytesSsse3(s + i, n - i, table);
+}
+
+#endif  // FASTX_QUAL_MAP_X86
+
+
+void MapBytes(char *s, size_t n, const uint8_t *table) {
+    typedef void (*Kernel)(char *, size_t, const uint8_t *);
+    static const Kernel kernel = [] {
+#ifdef FASTX_QUAL_MAP_X86
+        __builtin_cpu_init();
+        if (SimdLimit() >= SimdLevel::kAvx2 &&
+            __builtin_cpu_supports("avx2"))
+        {
+            return &MapBytesAvx2;
+        }
+        if (SimdLimit() >= SimdLevel::kSse &&
+            __builtin_cpu_supports("ssse3"))
+        {
+            return &MapBytesSsse3;
+        }
+#endif
+        return &MapBytesScalar;
+    }();
+    kernel(s, n, table);
+}
+
+
+static
+int BinQual(int q, QualBinning binning) {
+    switch (binning) {
+        case QualBinning::kIllumina8:
+            // 0-2 are kept, 2 marks no calls
+            if (q <= 2) return q;
+            if (q <= 9) return 6;
+            if (q <= 19) return 15;
+            if (q <= 24) return 22;
+            if (q <= 29) return 27;
+            if (q <= 34) return 33;
+            if (q <= 39) return 37;
+            return 40;
+        case QualBinning::kNovaSeq4:
+            if (q <= 2) return q;
+            if (q <= 14) return 12;
+            if (q <= 30) return 23;
+            return 37;
+        case QualBinning::kNone:
+            break;
+    }
+    return q;
+}
+
+
+QualMap::QualMap(bool phred64, QualBinning binning): identity_(true) {
+    int offset = phred64 ? 64 : 33;
+    for (int c = 0; c < 256; ++c) {
+        // only quality characters are mapped
+        if (c < 33 || c > 126) {
+            table_[c] = c;
+            continue;
+        }
+        int q = c - offset;
+        if (q < 0) q = 0;
+        if (q > QUAL_MAP_MAX_QUAL) q = QUAL_MAP_MAX_QUAL;
+        table_[c] = BinQual(q, binning) + 33;
+        if (table_[c] != c) identity_ = false;
+    }
+}
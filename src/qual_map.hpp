@@ -0,0 +1,50 @@
+#ifndef FASTX_QUAL_MAP_HPP
+#define FASTX_QUAL_MAP_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+enum class QualBinning {
+    kNone,
+    // Illumina 8-level: 3-9 -> 6, 10-19 -> 15, 20-24 -> 22, 25-29 -> 27,
+    // 30-34 -> 33, 35-39 -> 37, >= 40 -> 40
+    kIllumina8,
+    // NovaSeq 4-level: 3-14 -> 12, 15-30 -> 23, >= 31 -> 37
+    kNovaSeq4
+};
+
+
+/**
+ * @brief apply a 256-entry byte map to s in place. Uses AVX2 or SSSE3 if the
+ * cpu supports them(checked at runtime).
+ */
+void MapBytes(char *s, size_t n, const uint8_t *table);
+
+
+/**
+ * @brief 256-entry map of quality characters to phred+33, optionally from
+ * phred+64 and binned. Qualities below the offset of the input become 0,
+ * qualities above 93 become 93.
+ */
+class QualMap {
+public:
+    QualMap(bool phred64, QualBinning binning);
+
+    // true if the map changes nothing, apply() can be skipped
+    bool identity() const {
+        return identity_;
+    }
+
+    void apply(char *qual, size_t n) const {
+        MapBytes(qual, n, table_);
+    }
+
+private:
+    uint8_t table_[256];
+    bool identity_;
+};
+
+
+#endif  // FASTX_QUAL_MAP_HPP
@@ -0,0 +1,199 @@
+#include <cstdint>
+#include <cstring>
+#include "revcomp.hpp"
+#include "utils.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FASTX_REVCOMP_X86 1
+#endif
+
+
+/**
+ * @brief complements of letters indexed by the low 5 bits of ASCII(A/a is
+ * 1, Z/z is 26), letters without complement map to themselves.
+ */
+static const char COMPLEMENT_LETTERS[33] =
+    // @ABCDEFGHIJKLMNO
+      "@TVGHEFCDIJMLKNO"
+    // PQRSTUVWXYZ[\]^_
+      "PQYSAABWXRZ[\\]^_";
+
+
+static
+const char *ComplementTable() {
+    static char table[256];
+    static bool initialized = [] {
+        for (int c = 0; c < 256; ++c) {
+            table[c] = static_cast<char>(c);
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+                table[c] = static_cast<char>(
+                    (c & 0xE0) | (COMPLEMENT_LETTERS[c & 0x1F] & 0x1F));
+            }
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+
+
+char ComplementBase(char c) {
+    return ComplementTable()[static_cast<unsigned char>(c)];
+}
+
+
+/**
+ * @brief reverse complement of the middle part left by the vector kernels,
+ * i and j are the first and past the last position.
+ */
+static
+void ReverseComplementScalar(char *seq, size_t i, size_t j) {
+    const char *table = ComplementTable();
+    while (i + 1 < j) {
+        --j;
+        char c = table[static_cast<unsigned char>(seq[i])];
+        seq[i] = table[static_cast<unsigned char>(seq[j])];
+        seq[j] = c;
+        ++i;
+    }
+    if (i + 1 == j) {
+        seq[i] = table[static_cast<unsigned char>(seq[i])];
+    }
+}
+
+
+#ifdef FASTX_REVCOMP_X86
+
+/*
+ * Complement in vector: letters keep their case bits(0xE0) and get the low
+ * 5 bits of their complement from two 16 entry shuffle tables(low 5 bits
+ * 0-15 and 16-31), other bytes are kept.
+ */
+
+__attribute__((target("ssse3")))
+static inline
+__m128i ComplementSsse3(__m128i x) {
+    const __m128i lut_lo = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(COMPLEMENT_LETTERS));
+    const __m128i lut_hi = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(COMPLEMENT_LETTERS + 16));
+    __m128i idx = _mm_and_si128(x, _mm_set1_epi8(0x0F));
+    __m128i use_hi = _mm_cmpeq_epi8(
+        _mm_and_si128(x, _mm_set1_epi8(0x10)), _mm_set1_epi8(0x10));
+    __m128i comp = _mm_or_si128(
+        _mm_andnot_si128(use_hi, _mm_shuffle_epi8(lut_lo, idx)),
+        _mm_and_si128(use_hi, _mm_shuffle_epi8(lut_hi, idx)));
+    comp = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi8(char(0xE0))),
+        _mm_and_si128(comp, _mm_set1_epi8(0x1F)));
+
+    // letters: (x | 0x20) in 'a'..'z'
+    __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+    __m128i is_letter = _mm_and_si128(
+        _mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+        _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    return _mm_or_si128(_mm_and_si128(is_letter, comp),
+        _mm_andnot_si128(is_letter, x));
+}
+
+
+__attribute__((target("ssse3")))
+static
+void ReverseComplementSsse3(char *seq, size_t len) {
+    const __m128i reverse = _mm_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t i = 0;
+    size_t j = len;
+    while (j - i >= 32) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i *>(seq + i));
+        __m128i b = _mm_loadu_si128(
+            reinterpret_cast<__m128i *>(seq + j - 16));
+        a = _mm_shuffle_epi8(ComplementSsse3(a), reverse);
+        b = _mm_shuffle_epi8(ComplementSsse3(b), reverse);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(seq + i), b);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(seq + j - 16), a);
+        i += 16;
+        j -= 16;
+    }
+    ReverseComplementScalar(seq, i, j);
+}
+
+
+__attribute__((target("avx2")))
+static inline
+__m256i ComplementAvx2(__m256i x) {
+    const __m256i lut_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(COMPLEMENT_LETTERS)));
+    const __m256i lut_hi = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(COMPLEMENT_LETTERS + 16)));
+    __m256i idx = _mm256_and_si256(x, _mm256_set1_epi8(0x0F));
+    __m256i use_hi = _mm256_cmpeq_epi8(
+        _mm256_and_si256(x, _mm256_set1_epi8(0x10)), _mm256_set1_epi8(0x10));
+    __m256i comp = _mm256_blendv_epi8(_mm256_shuffle_epi8(lut_lo, idx),
+        _mm256_shuffle_epi8(lut_hi, idx), use_hi);
+    comp = _mm256_or_si256(
+        _mm256_and_si256(x, _mm256_set1_epi8(char(0xE0))),
+        _mm256_and_si256(comp, _mm256_set1_epi8(0x1F)));
+
+    __m256i lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+    __m256i is_letter = _mm256_and_si256(
+        _mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+        _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    return _mm256_blendv_epi8(x, comp, is_letter);
+}
+
+
+__attribute__((target("avx2")))
+static
+void ReverseComplementAvx2(char *seq, size_t len) {
+    const __m256i reverse = _mm256_setr_epi8(
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+        15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    size_t i = 0;
+    size_t j = len;
+    while (j - i >= 64) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i *>(seq + i));
+        __m256i b = _mm256_loadu_si256(
+            reinterpret_cast<__m256i *>(seq + j - 32));
+        // reverse bytes in each 128-bit lane, then swap the lanes
+        a = _mm256_permute4x64_epi64(
+            _mm256_shuffle_epi8(ComplementAvx2(a), reverse), 0x4E);
+        b = _mm256_permute4x64_epi64(
+            _mm256_shuffle_epi8(ComplementAvx2(b), reverse), 0x4E);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(seq + i), b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(seq + j - 32), a);
+        i += 32;
+        j -= 32;
+    }
+    ReverseComplementSsse3(seq + i, j - i);
+}
+
+#endif  // FASTX_REVCOMP_X86
+
+
+static
+void ReverseComplementDefault(char *seq, size_t len) {
+    ReverseComplementScalar(seq, 0, len);
+}
+
+
+void ReverseComplement(char *seq, size_t len) {
+    typedef void (*Kernel)(char *, size_t);
+    static const Kernel kernel = [] {
+#ifdef FASTX_REVCOMP_X86
+        __builtin_cpu_init();
+        if (SimdLimit() >= SimdLevel::kAvx2 &&
+            __builtin_cpu_supports("avx2"))
+        {
+            return &ReverseComplementAvx2;
+        }
+        if (SimdLimit() >= SimdLevel::kSse &&
+            __builtin_cpu_supports("ssse3"))
+        {
+            return &ReverseComplementSsse3;
+        }
+#endif
+        return &ReverseComplementDefault;
+    }();
+    kernel(seq, len);
+}
@@ -0,0 +1,26 @@
+#ifndef FASTX_REVCOMP_HPP
+#define FASTX_REVCOMP_HPP
+
+
+#include <cstddef>
+
+
+/**
+ * @brief complement of a base, IUPAC codes are complemented(R<->Y, K<->M,
+ * B<->V, D<->H, S, W and N are unchanged, U to A) and case is kept. Other
+ * characters are returned as is.
+ */
+char ComplementBase(char c);
+
+
+/**
+ * @brief reverse complement a sequence in place. Uses AVX2 or SSSE3 if the
+ * cpu supports them(checked at runtime), otherwise a lookup table.
+ *
+ * @param seq sequence
+ * @param len length of sequence
+ */
+void ReverseComplement(char *seq, size_t len);
+
+
+#endif  // FASTX_REVCOMP_HPP
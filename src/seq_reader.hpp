@@ -147,9 +147,9 @@ public:
                 int r = Fill(kseq_array);
                 filled_queue_.push(kseq_array);
                 if (r < 0) {
-                    // reach end of file
+                    // reach end of file, wake all batch consumers
                     stop_ = true;
-                    consumer_cv_.notify_one();
+                    consumer_cv_.notify_all();
                     break;
                 }
                 consumer_cv_.notify_one();
@@ -218,6 +218,37 @@ public:
         }
     }
 
+    /**
+     * @brief take a whole batch of reads, for workers consuming batches in
+     * parallel. A batch must be given back by release(), do not mix with
+     * read().
+     * 
+     * @param batch_id set to the number of batches taken before, so that
+     * results can be put back in input order
+     * @return KseqArray* batch, NULL at the end of file
+     */
+    KseqArray *read_batch(uint64_t *batch_id = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        consumer_cv_.wait(lock,
+            [this](){return !filled_queue_.empty() || stop_;});
+        if (filled_queue_.empty()) return nullptr;
+        KseqArray *kseq_array = filled_queue_.front();
+        filled_queue_.pop();
+        if (batch_id) *batch_id = batches_;
+        ++batches_;
+        return kseq_array;
+    }
+
+    // give back a batch taken by read_batch()
+    void release(KseqArray *kseq_array) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            kseq_array->clear();
+            empty_queue_.push(kseq_array);
+        }
+        producer_cv_.notify_one();
+    }
+
     void stop() {
         stop_ = true;
         producer_cv_.notify_one();
@@ -237,6 +268,7 @@ private:
     std::queue<KseqArray *> filled_queue_;
     std::queue<KseqArray *> empty_queue_;
     KseqArray *reading_array_ = nullptr;
+    uint64_t batches_ = 0;
     std::thread producer_;
 
     std::atomic_bool stop_;
@@ -246,4 +278,141 @@ private:
 };
 
 
+/**
+ * @brief read pairs from two files(read1 and read2) or one interleaved file,
+ * checking that the records of each pair are mates. A batch of interleaved
+ * input holds whole pairs, since batches are full(KSEQ_ARRAY_CAPACITY
+ * records, even) except the last one.
+ */
+class PairReader {
+public:
+    /**
+     * @brief a batch of pairs, taken by read_batch() and given back by
+     * release()
+     */
+    class Batch {
+    public:
+        int size() const {
+            return size_;
+        }
+
+        kseq_t *read1(int i) {
+            return batch2_ ? batch1_->get(i) : batch1_->get(2 * i);
+        }
+
+        kseq_t *read2(int i) {
+            return batch2_ ? batch2_->get(i) : batch1_->get(2 * i + 1);
+        }
+
+    private:
+        friend class PairReader;
+        KseqArray *batch1_ = nullptr;
+        KseqArray *batch2_ = nullptr;
+        int size_ = 0;
+    };
+
+    /**
+     * @param fp2 read2 input, nullptr if fp1 is interleaved
+     */
+    PairReader(gzFile fp1, gzFile fp2): reader1_(fp1),
+        reader2_(fp2 ? new SeqReader(fp2) : nullptr) {}
+
+    ~PairReader() {
+        delete reader2_;
+    }
+
+    PairReader(const PairReader &) = delete;
+    PairReader &operator=(const PairReader &) = delete;
+
+    bool interleaved() const {
+        return reader2_ == nullptr;
+    }
+
+    // pairs in every batch but the last one
+    int pairs_per_batch() const {
+        return reader2_ ? KSEQ_ARRAY_CAPACITY : KSEQ_ARRAY_CAPACITY / 2;
+    }
+
+    /**
+     * @brief read the next pair, the records are valid until the next call.
+     * Do not mix with read_batch().
+     *
+     * @return false at the end of input
+     */
+    bool read(kseq_t **read1, kseq_t **read2) {
+        SeqReader &mates = reader2_ ? *reader2_ : reader1_;
+        *read1 = reader1_.read();
+        *read2 = *read1 || reader2_ ? mates.read() : nullptr;
+        if (*read1 == nullptr && *read2 == nullptr) return false;
+        if (*read1 == nullptr || *read2 == nullptr) CountError();
+        CheckMates(*read1, *read2);
+        return true;
+    }
+
+    /**
+     * @brief take a batch of pairs for workers consuming batches in
+     * parallel, the mates of all pairs are checked.
+     *
+     * @param batch_id set to the number of batches taken before
+     * @return false at the end of input
+     */
+    bool read_batch(Batch *batch, uint64_t *batch_id = nullptr) {
+        {
+            // mates are in the batches of the same id
+            std::lock_guard<std::mutex> lock(take_mutex_);
+            batch->batch1_ = reader1_.read_batch(batch_id);
+            batch->batch2_ = reader2_ ? reader2_->read_batch() : nullptr;
+        }
+        int size1 = batch->batch1_ ? batch->batch1_->size() : 0;
+        if (reader2_) {
+            int size2 = batch->batch2_ ? batch->batch2_->size() : 0;
+            if (size1 != size2) CountError();
+            batch->size_ = size1;
+        } else {
+            if (size1 % 2) CountError();
+            batch->size_ = size1 / 2;
+        }
+        if (batch->batch1_ == nullptr) return false;
+
+        for (int i = 0; i < batch->size_; ++i) {
+            CheckMates(batch->read1(i), batch->read2(i));
+        }
+        return true;
+    }
+
+    void release(Batch *batch) {
+        if (batch->batch1_) reader1_.release(batch->batch1_);
+        if (batch->batch2_) reader2_->release(batch->batch2_);
+        batch->batch1_ = nullptr;
+        batch->batch2_ = nullptr;
+        batch->size_ = 0;
+    }
+
+private:
+    void CountError() const {
+        if (reader2_) {
+            std::cerr << "Error! Record number not equal for paired inputs."
+                << std::endl;
+        } else {
+            std::cerr << "Error! Odd number of records in interleaved input."
+                << std::endl;
+        }
+        std::exit(1);
+    }
+
+    static void CheckMates(const kseq_t *read1, const kseq_t *read2) {
+        if (!IsMatePair(read1, read2)) {
+            std::cerr << "Error! Paired inputs are out of sync, read1: "
+                << read1->name.s << " is not the mate of read2: "
+                << read2->name.s << std::endl;
+            std::exit(1);
+        }
+    }
+
+    SeqReader reader1_;
+    SeqReader *reader2_;
+    std::mutex take_mutex_;
+};
+
+
 #endif  // FASTX_SEQ_READER_HPP
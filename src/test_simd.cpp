@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "aho_corasick.hpp"
+#include "composition.hpp"
+#include "fastx_pack.hpp"
+#include "qual_map.hpp"
+#include "revcomp.hpp"
+#include "trim.hpp"
+#include "two_bit.hpp"
+#include "utils.hpp"
+
+
+/*
+ * Checks the vectorized kernels against plain references on random inputs of
+ * random lengths and offsets, so that the vector loops, their scalar tails and
+ * unaligned loads are all covered, and the table driven 2bit packing by a
+ * round trip. Kernels are picked once per process, so the checks run in a
+ * child process for each FASTX_SIMD level.
+ */
+
+
+// random inputs per check
+const int TEST_SIMD_ROUNDS = 2000;
+
+static int failures = 0;
+
+
+static
+void Expect(bool ok, const char *kernel, size_t len) {
+    if (ok) return;
+    if (++failures <= 10) {
+        std::cerr << "Error! " << kernel << " differs from the reference at "
+            << "length " << len << std::endl;
+    }
+}
+
+
+// random length, mostly within a few vector widths, sometimes long
+static
+size_t RandomLength(std::mt19937 &rng) {
+    if (rng() % 8 == 0) return rng() % 5000;
+    return rng() % 160;
+}
+
+
+// random string of alphabet, or of any bytes if alphabet is empty
+static
+std::string RandomString(std::mt19937 &rng, size_t len,
+    const std::string &alphabet)
+{
+    std::string str(len, '\0');
+    for (auto &c: str) {
+        c = alphabet.empty() ? static_cast<char>(rng() % 256) :
+            alphabet[rng() % alphabet.size()];
+    }
+    return str;
+}
+
+
+static
+void CheckReverseComplement(std::mt19937 &rng) {
+    const std::string bases = "ACGTNacgtnRYKMBVDHSWUrykmbvdhswu-.*";
+    for (int r = 0; r < TEST_SIMD_ROUNDS; ++r) {
+        size_t len = RandomLength(rng);
+        size_t offset = rng() % 32;
+        std::string seq = RandomString(rng, offset + len,
+            r % 2 ? bases : "");
+        std::string expected = seq;
+        for (size_t i = 0; i < len; ++i) {
+            expected[offset + i] = ComplementBase(seq[offset + len - 1 - i]);
+        }
+        ReverseComplement(&seq[offset], len);
+        Expect(seq == expected, "ReverseComplement", len);
+    }
+}
+
+
+static
+void CheckCountBases(std::mt19937 &rng) {
+    const std::string bases = "ACGTNacgtnRYry-";
+    const char counted[] = "ACGTN";
+    for (int r = 0; r < TEST_SIMD_ROUNDS; ++r) {
+        size_t len = RandomLength(rng);
+        size_t offset = rng() % 32;
+        std::string seq = RandomString(rng, offset + len,
+            r % 2 ? bases : "");
+        uint64_t expected[5] = {0};
+        for (size_t i = offset; i < offset + len; ++i) {
+            const char *p = std::strchr(counted,
+                std::toupper(static_cast<unsigned char>(seq[i])));
+            if (seq[i] && p) ++expected[p - counted];
+        }
+        BaseCounts counts;
+        CountBases(seq.data() + offset, len, &counts);
+        Expect(counts.a == expected[0] && counts.c == expected[1] &&
+            counts.g == expected[2] && counts.t == expected[3] &&
+            counts.n == expected[4], "CountBases", len);
+    }
+}
+
+
+static
+void CheckCountQuals(std::mt19937 &rng) {
+    for (int r = 0; r < TEST_SIMD_ROUNDS; ++r) {
+        size_t len = RandomLength(rng);
+        size_t offset = rng() % 32;
+        std::string qual(offset + len, '\0');
+        for (auto &c: qual) c = static_cast<char>(33 + rng() % 94);
+        QualCounts expected;
+        // single precision probabilities summed in eight lanes then the
+        // tail, the order of all ExpectedErrors kernels
+        auto prob = [](char c) -> double {
+            return static_cast<float>(std::pow(10.0, -(c - 33) / 10.0));
+        };
+        size_t body = len / 8 * 8;
+        double lanes[8] = {0};
+        for (size_t i = offset; i < offset + len; ++i) {
+            int q = qual[i] - 33;
+            expected.q20 += q >= 20;
+            expected.q30 += q >= 30;
+            expected.sum += q;
+            if (i - offset < body) lanes[(i - offset) % 8] += prob(qual[i]);
+        }
+        double expected_errors = 0;
+        for (double lane: lanes) expected_errors += lane;
+        for (size_t i = offset + body; i < offset + len; ++i) {
+            expected_errors += prob(qual[i]);
+        }
+        QualCounts counts;
+        CountQuals(qual.data() + offset, len, &counts);
+        Expect(counts.q20 == expected.q20 && counts.q30 == expected.q30 &&
+            counts.sum == expected.sum, "CountQuals", len);
+        Expect(ExpectedErrors(qual.data() + offset, len) == expected_errors,
+            "ExpectedErrors", len);
+    }
+}
+
+
+/**
+ * @brief text without the searched bytes except at most one hit, so that the
+ * first hit is anywhere in the vector loops or the tail, or missing.
+ */
+static
+void CheckFindFirstOf(std::mt19937 &rng) {
+    for (int r = 0; r < TEST_SIMD_ROUNDS; ++r) {
+        size_t len = RandomLength(rng);
+        size_t offset = rng() % 32;
+        int n = 1 + rng() % AHO_CORASICK_MAX_PREFILTER_BYTES;
+        uint8_t bytes[AHO_CORASICK_MAX_PREFILTER_BYTES];
+        for (int k = 0; k < n; ++k) bytes[k] = rng() % 256;
+
+        std::string text = RandomString(rng, offset + len, "");
+        for (auto &c: text) {
+            while (std::count(bytes, bytes + n, static_cast<uint8_t>(c))) {
+                c = static_cast<char>(rng() % 256);
+            }
+        }
+        if (len && rng() % 4) {
+            text[offset + rng() % len] = static_cast<char>(bytes[rng() % n]);
+        }
+
+        size_t expected = len;
+        for (size_t i = 0; i < len && expected == len; ++i) {
+            if (std::count(bytes, bytes + n,
+                    static_cast<uint8_t>(text[offset + i])))
+            {
+                expected = i;
+            }
+        }
+        Expect(FindFirstOf(text.data() + offset, len, bytes, n) == expected,
+            "FindFirstOf", len);
+    }
+}
+
+
+static
+void CheckCountMismatches(std::mt19937 &rng) {
+    for (int r = 0; r < TEST_SIMD_ROUNDS; ++r) {
+        size_t len = RandomLength(rng);
+        size_t offset = rng() % 32;
+        std::string a = RandomString(rng, offset + len, "ACGTNacgtn");
+        std::string b = a;
+        size_t expected = 0;
+        for (size_t i = offset; i < offset + len; ++i) {
+            // case flips are not mismatches
+            if (rng() % 2) b[i] ^= 0x20;
+            if (rng() % 8 == 0) {
+                b[i] = "ACGTN"[rng() % 5];
+                expected += std::toupper(a[i]) != b[i];
+            }
+        }
+        Expect(CountMismatches(a.data() + offset, b.data() + offset, len) ==
+            expected, "CountMismatches", len);
+    }
+}
+
+
+/**
+ * @brief qualities of 20 to 41 with random dips, so that the first window
+ * below min_qual is anywhere in the vector loops or the tail, or missing.
+ */
+static
+void CheckQualityWindowCut(std::mt19937 &rng) {
+    for (int r = 0; r < TEST_SIMD_ROUNDS; ++r) {
+        size_t len = RandomLength(rng);
+        size_t offset = rng() % 32;
+        int window = 1 + (rng() % 4 ? rng() % 16 : rng() % TRIM_MAX_WINDOW);
+        int min_qual = 10 + rng() % 21;
+        std::string qual(offset + len, '\0');
+        for (auto &c: qual) {
+            c = static_cast<char>(33 + (rng() % 64 ? 20 + rng() % 22 :
+                rng() % 10));
+        }
+
+        size_t w = std::min<size_t>(window, len);
+        size_t expected = len;
+        for (size_t i = 0; w && i + w <= len && expected == len; ++i) {
+            int sum = 0;
+            for (size_t k = i; k < i + w; ++k) sum += qual[offset + k] - 33;
+            if (sum < min_qual * static_cast<int>(w)) expected = i;
+        }
+        Expect(QualityWindowCut(qual.data() + offset, len, window, min_qual)
+            == expected, "QualityWindowCut", len);
+    }
+}
+
+
+// random tables, so that each of the 16 rows of the kernels is used
+static
+void CheckMapBytes(std::mt19937 &rng) {
+    for (int r = 0; r < TEST_SIMD_ROUNDS; ++r) {
+        size_t len = RandomLength(rng);
+        size_t offset = rng() % 32;
+        uint8_t table[256];
+        for (auto &t: table) t = rng() % 256;
+        std::string str = RandomString(rng, offset + len, "");
+        std::string expected = str;
+        for (size_t i = offset; i < offset + len; ++i) {
+            expected[i] = static_cast<char>(
+                table[static_cast<uint8_t>(str[i])]);
+        }
+        MapBytes(&str[offset], len, table);
+        Expect(str == expected, "MapBytes", len);
+    }
+}
+
+
+// base fetched from .2bit: ACGT in upper case, others N, lower case masked
+static
+char TwoBitBase(char c) {
+    char base = std::strchr("ACGTacgt", c) ?
+        static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : 'N';
+    return c >= 'a' && c <= 'z' ?
+        static_cast<char>(std::tolower(static_cast<unsigned char>(base))) :
+        base;
+}
+
+
+/**
+ * @brief pack random sequences with fastx pack and fetch random ranges, so
+ * that ranges start and end at every position within a packed byte.
+ */
+static
+void CheckTwoBit(std::mt19937 &rng) {
+    const std::string bases = "ACGTACGTacgtNnRy-";
+    const size_t n_seqs = 64;
+    char fasta[] = "/tmp/test_simd_XXXXXX";
+    char packed[] = "/tmp/test_simd_XXXXXX";
+    int fasta_fd = mkstemp(fasta);
+    int packed_fd = mkstemp(packed);
+    if (fasta_fd < 0 || packed_fd < 0) {
+        std::perror("Error! Can not create temporary file");
+        std::exit(1);
+    }
+    close(packed_fd);
+
+    // runs of bases, so that N and mask blocks span several bases
+    std::vector<std::string> seqs(n_seqs);
+    FILE *fp = fdopen(fasta_fd, "w");
+    for (size_t k = 0; k < n_seqs; ++k) {
+        size_t len = RandomLength(rng);
+        while (seqs[k].size() < len) {
+            size_t run = std::min<size_t>(1 + rng() % 12,
+                len - seqs[k].size());
+            seqs[k].append(run, bases[rng() % bases.size()]);
+        }
+        std::fprintf(fp, ">seq%zu\n%s\n", k, seqs[k].c_str());
+    }
+    std::fclose(fp);
+
+    const char *argv[] = {"pack", "-o", packed, fasta};
+    FastxPackMain(4, const_cast<char **>(argv));
+    TwoBitReader reader(packed);
+
+    std::string out;
+    for (size_t k = 0; k < n_seqs; ++k) {
+        const std::string &seq = seqs[k];
+        std::string expected(seq.size(), '\0');
+        for (size_t i = 0; i < seq.size(); ++i) {
+            expected[i] = TwoBitBase(seq[i]);
+        }
+        std::string name = "seq" + std::to_string(k);
+        reader.fetch(name, 0, seq.size(), out);
+        Expect(out == expected, "TwoBitReader::fetch", seq.size());
+
+        for (int r = 0; r < TEST_SIMD_ROUNDS / 64 && !seq.empty(); ++r) {
+            size_t start = rng() % seq.size();
+            size_t end = start + rng() % (seq.size() - start);
+            reader.fetch(name, start, end, out);
+            Expect(out == expected.substr(start, end - start + 1),
+                "TwoBitReader::fetch", end - start + 1);
+        }
+    }
+
+    unlink(fasta);
+    unlink(packed);
+}
+
+
+static
+void RunChecks(std::mt19937 &rng) {
+    CheckReverseComplement(rng);
+    CheckTwoBit(rng);
+    CheckCountBases(rng);
+    CheckCountQuals(rng);
+    CheckFindFirstOf(rng);
+    CheckCountMismatches(rng);
+    CheckQualityWindowCut(rng);
+    CheckMapBytes(rng);
+}
+
+
+int main() {
+    const char *levels[] = {"scalar", "sse", "avx2"};
+    int status = 0;
+    for (const char *level: levels) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            std::perror("Error! Failed to fork");
+            return 1;
+        }
+        if (pid == 0) {
+            setenv("FASTX_SIMD", level, 1);
+            std::mt19937 rng(2024);
+            RunChecks(rng);
+            std::exit(failures ? 1 : 0);
+        }
+
+        int child_status = 0;
+        waitpid(pid, &child_status, 0);
+        bool ok = WIFEXITED(child_status) && WEXITSTATUS(child_status) == 0;
+        std::cerr << "FASTX_SIMD=" << level << (ok ? " passed" : " failed")
+            << std::endl;
+        if (!ok) status = 1;
+    }
+    return status;
+}
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cstdint>
+#include "trim.hpp"
+#include "utils.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FASTX_TRIM_X86 1
+#endif
+
+
+static
+size_t CountMismatchesScalar(const char *a, const char *b, size_t n) {
+    size_t mismatches = 0;
+    for (size_t i = 0; i < n; ++i) {
+        mismatches += (a[i] | 0x20) != (b[i] | 0x20);
+    }
+    return mismatches;
+}
+
+
+/**
+ * @brief rolling window sums of qualities, first window below threshold
+ * (sum of raw phred+33 characters) from start on.
+ */
+static
+size_t QualityWindowCutScalar(const char *qual, size_t len, size_t start,
+    int window, int threshold)
+{
+    if (start + window > len) return len;
+    int sum = 0;
+    for (int k = 0; k < window; ++k) {
+        sum += static_cast<uint8_t>(qual[start + k]);
+    }
+    for (size_t i = start; ; ++i) {
+        if (sum < threshold) return i;
+        if (i + window >= len) return len;
+        sum += static_cast<uint8_t>(qual[i + window]) -
+            static_cast<uint8_t>(qual[i]);
+    }
+}
+
+
+#ifdef FASTX_TRIM_X86
+
+/*
+ * Letters are folded to lower case(| 0x20) before compare, the mismatches
+ * of a block are the zero bits of the compare mask.
+ */
+
+__attribute__((target("sse2")))
+static
+size_t CountMismatchesSse2(const char *a, const char *b, size_t n) {
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    size_t mismatches = 0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_or_si128(_mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(a + i)), case_bit);
+        __m128i y = _mm_or_si128(_mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(b + i)), case_bit);
+        uint32_t equal = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        mismatches += 16 - __builtin_popcount(equal);
+    }
+    return mismatches + CountMismatchesScalar(a + i, b + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static
+size_t CountMismatchesAvx2(const char *a, const char *b, size_t n) {
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    size_t mismatches = 0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_or_si256(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(a + i)), case_bit);
+        __m256i y = _mm256_or_si256(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(b + i)), case_bit);
+        uint32_t equal = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        mismatches += 32 - __builtin_popcount(equal);
+    }
+    return mismatches + CountMismatchesSse2(a + i, b + i, n - i);
+}
+
+
+/*
+ * Sums of the windows starting at 8(SSE2) or 16(AVX2) positions at once in
+ * 16-bit lanes, a lane is below the threshold if subtracting threshold - 1
+ * saturates to zero.
+ */
+
+__attribute__((target("sse2")))
+static
+size_t QualityWindowCutSse2(const char *qual, size_t len, size_t start,
+    int window, int threshold)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi16(threshold - 1);
+    size_t i = start;
+    for (; i + 8 + window - 1 <= len; i += 8) {
+        __m128i sum = zero;
+        for (int k = 0; k < window; ++k) {
+            __m128i x = _mm_loadl_epi64(
+                reinterpret_cast<const __m128i *>(qual + i + k));
+            sum = _mm_add_epi16(sum, _mm_unpacklo_epi8(x, zero));
+        }
+        __m128i below = _mm_cmpeq_epi16(_mm_subs_epu16(sum, limit), zero);
+        uint32_t mask = _mm_movemask_epi8(below);
+        if (mask) return i + __builtin_ctz(mask) / 2;
+    }
+    return QualityWindowCutScalar(qual, len, i, window, threshold);
+}
+
+
+__attribute__((target("avx2")))
+static
+size_t QualityWindowCutAvx2(const char *qual, size_t len, size_t start,
+    int window, int threshold)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i limit = _mm256_set1_epi16(threshold - 1);
+    size_t i = start;
+    for (; i + 16 + window - 1 <= len; i += 16) {
+        __m256i sum = zero;
+        for (int k = 0; k < window; ++k) {
+            __m128i x = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(qual + i + k));
+            sum = _mm256_add_epi16(sum, _mm256_cvtepu8_epi16(x));
+        }
+        __m256i below = _mm256_cmpeq_epi16(
+            _mm256_subs_epu16(sum, limit), zero);
+        uint32_t mask = _mm256_movemask_epi8(below);
+        if (mask) return i + __builtin_ctz(mask) / 2;
+    }
+    return QualityWindowCutSse2(qual, len, i, window, threshold);
+}
+
+#endif  // FASTX_TRIM_X86
+
+
+size_t CountMismatches(const char *a, const char *b, size_t n) {
+    typedef size_t (*Kernel)(const char *, const char *, size_t);
+    static const Kernel kernel = [] {
+#ifdef FASTX_TRIM_X86
+        __builtin_cpu_init();
+        if (SimdLimit() >= SimdLevel::kAvx2 &&
+            __builtin_cpu_supports("avx2"))
+        {
+            return &CountMismatchesAvx2;
+        }
+        if (SimdLimit() >= SimdLevel::kSse &&
+            __builtin_cpu_supports("sse2"))
+        {
+            return &CountMismatchesSse2;
+        }
+#endif
+        return &CountMismatchesScalar;
+    }();
+    return kernel(a, b, n);
+}
+
+
+size_t FindAdapter3(const char *seq, size_t len, const std::string &adapter,
+    double error_rate, size_t min_overlap)
+{
+    if (adapter.empty() || len < min_overlap) return len;
+    for (size_t i = 0; i + min_overlap <= len; ++i) {
+        size_t overlap = std::min(adapter.size(), len - i);
+        if (overlap < min_overlap) break;
+        size_t max_mismatches = error_rate * overlap;
+        if (CountMismatches(seq + i, adapter.data(), overlap) <=
+            max_mismatches)
+        {
+            return i;
+        }
+    }
+    return len;
+}
+
+
+size_t FindAdapter5(const char *seq, size_t len, const std::string &adapter,
+    double error_rate, size_t min_overlap)
+{
+    if (adapter.empty() || len < min_overlap) return 0;
+    for (size_t end = len; end >= min_overlap; --end) {
+        size_t overlap = std::min(adapter.size(), end);
+        if (overlap < min_overlap) break;
+        size_t max_mismatches = error_rate * overlap;
+        if (CountMismatches(seq + end - overlap,
+            adapter.data() + adapter.size() - overlap, overlap) <=
+            max_mismatches)
+        {
+            return end;
+        }
+    }
+    return 0;
+}
+
+
+size_t QualityWindowCut(const char *qual, size_t len, int window,
+    int min_qual)
+{
+    if (len == 0) return 0;
+    if (static_cast<size_t>(window) > len) window = len;
+    int threshold = (min_qual + 33) * window;
+
+    typedef size_t (*Kernel)(const char *, size_t, size_t, int, int);
+    static const Kernel kernel = [] {
+#ifdef FASTX_TRIM_X86
+        __builtin_cpu_init();
+        if (SimdLimit() >= SimdLevel::kAvx2 &&
+            __builtin_cpu_supports("avx2"))
+        {
+            return &QualityWindowCutAvx2;
+        }
+        if (SimdLimit() >= SimdLevel::kSse &&
+            __builtin_cpu_supports("sse2"))
+        {
+            return &QualityWindowCutSse2;
+        }
+#endif
+        return &QualityWindowCutScalar;
+    }();
+    return kernel(qual, len, 0, window, threshold);
+}
+
+
+size_t PolyTailStart(const char *seq, size_t len, char base, size_t min_len)
+{
+    size_t start = len;
+    size_t mismatches = 0;
+    for (size_t i = len; i > 0; --i) {
+        if ((seq[i - 1] | 0x20) == (base | 0x20)) {
+            start = i - 1;
+        } else if (++mismatches > (len - i + 1) / 8) {
+            break;
+        }
+    }
+    return len - start >= min_len ? start : len;
+}
@@ -0,0 +1,64 @@
+#ifndef FASTX_TRIM_HPP
+#define FASTX_TRIM_HPP
+
+
+#include <cstddef>
+#include <string>
+
+
+// max window of QualityWindowCut, the window sums fit in 16 bits
+const int TRIM_MAX_WINDOW = 256;
+
+
+/**
+ * @brief number of mismatches between a and b over n bytes, letters compare
+ * in both cases. Uses AVX2 or SSE2 if the cpu supports them(checked at
+ * runtime).
+ */
+size_t CountMismatches(const char *a, const char *b, size_t n);
+
+
+/**
+ * @brief start of a 3' adapter in seq by ungapped overlap alignment. The
+ * adapter is either within seq or its prefix overlaps a suffix of seq of at
+ * least min_overlap bases, with at most error_rate * overlap mismatches.
+ * The leftmost match is taken.
+ *
+ * @return start of the adapter, len if not found
+ */
+size_t FindAdapter3(const char *seq, size_t len, const std::string &adapter,
+    double error_rate, size_t min_overlap);
+
+
+/**
+ * @brief end of a 5' adapter in seq, same as FindAdapter3 with the suffix
+ * of the adapter overlapping a prefix of seq. The rightmost match is taken.
+ *
+ * @return end of the adapter, 0 if not found
+ */
+size_t FindAdapter5(const char *seq, size_t len, const std::string &adapter,
+    double error_rate, size_t min_overlap);
+
+
+/**
+ * @brief start of the first window of phred+33 qualities with mean below
+ * min_qual, the whole string is one window if shorter. Uses AVX2 or SSE2
+ * if the cpu supports them.
+ *
+ * @param window window size, 1 to TRIM_MAX_WINDOW
+ * @return start of the window, len if none
+ */
+size_t QualityWindowCut(const char *qual, size_t len, int window,
+    int min_qual);
+
+
+/**
+ * @brief start of a 3' tail of base(case insensitive) of at least min_len,
+ * allowing one mismatch per 8 bases.
+ *
+ * @return start of the tail, len if none
+ */
+size_t PolyTailStart(const char *seq, size_t len, char base, size_t min_len);
+
+
+#endif  // FASTX_TRIM_HPP
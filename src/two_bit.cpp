@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "two_bit.hpp"
+
+
+static
+uint32_t ReadU32(const char *p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+
+static
+uint64_t ReadU64(const char *p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+
+/**
+ * @brief 4 bases of each packed byte, one memcpy unpacks a byte.
+ */
+static
+const char *UnpackTable() {
+    static char table[256 * 4];
+    static bool initialized = [] {
+        const char *bases = "TCAG";
+        for (int b = 0; b < 256; ++b) {
+            for (int k = 0; k < 4; ++k) {
+                table[b * 4 + k] = bases[(b >> (6 - 2 * k)) & 3];
+            }
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+
+
+bool IsTwoBit(const std::string &filename) {
+    FILE *fp = std::fopen(filename.c_str(), "rb");
+    if (fp == nullptr) return false;
+    char buffer[4];
+    bool ret = std::fread(buffer, 1, 4, fp) == 4 &&
+        ReadU32(buffer) == TWO_BIT_SIGNATURE;
+    std::fclose(fp);
+    return ret;
+}
+
+
+TwoBitReader::TwoBitReader(const std::string &filename): filename_(filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::perror(("Error! Can not open " + filename).c_str());
+        std::exit(1);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 16) {
+        std::cerr << "[TwoBitReader] Error! " << filename << " is not a "
+            << "valid 2bit file" << std::endl;
+        std::exit(1);
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        std::perror(("Error! Can not map " + filename).c_str());
+        std::exit(1);
+    }
+    data_ = static_cast<const char *>(data);
+    size_ = st.st_size;
+
+    uint32_t signature = ReadU32(data_);
+    uint32_t version = ReadU32(data_ + 4);
+    uint32_t count = ReadU32(data_ + 8);
+    if (signature != TWO_BIT_SIGNATURE || version > 1) {
+        std::cerr << "[TwoBitReader] Error! " << filename << " is not a "
+            << "supported 2bit file(little endian, version 0 or 1)"
+            << std::endl;
+        std::exit(1);
+    }
+
+    auto corrupted = [&filename]() {
+        std::cerr << "[TwoBitReader] Error! " << filename << " is "
+            << "truncated or corrupted" << std::endl;
+        std::exit(1);
+    };
+
+    size_t offset_size = version == 0 ? 4 : 8;
+    size_t p = 16;
+    index_.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (p + 1 > size_) corrupted();
+        size_t name_size = static_cast<uint8_t>(data_[p]);
+        if (p + 1 + name_size + offset_size > size_) corrupted();
+        std::string name(data_ + p + 1, name_size);
+        p += 1 + name_size;
+        uint64_t offset = version == 0 ? ReadU32(data_ + p) :
+            ReadU64(data_ + p);
+        p += offset_size;
+
+        Record record;
+        uint64_t q = offset;
+        if (q + 8 > size_) corrupted();
+        record.dna_size = ReadU32(data_ + q);
+        record.n_count = ReadU32(data_ + q + 4);
+        record.n_blocks = data_ + q + 8;
+        q += 8 + 8 * static_cast<uint64_t>(record.n_count);
+        if (q + 4 > size_) corrupted();
+        record.mask_count = ReadU32(data_ + q);
+        record.mask_blocks = data_ + q + 4;
+        q += 4 + 8 * static_cast<uint64_t>(record.mask_count) + 4;
+        record.dna = reinterpret_cast<const uint8_t *>(data_ + q);
+        if (q + (record.dna_size + 3) / 4 > size_) corrupted();
+
+        index_.emplace(std::move(name), record);
+    }
+}
+
+
+TwoBitReader::~TwoBitReader() {
+    if (data_) munmap(const_cast<char *>(data_), size_);
+}
+
+
+const TwoBitReader::Record *TwoBitReader::GetRecord(
+    const std::string &name) const
+{
+    auto iter = index_.find(name);
+    return iter == index_.end() ? nullptr : &iter->second;
+}
+
+
+int64_t TwoBitReader::length(const std::string &name) const {
+    const Record *record = GetRecord(name);
+    return record ? record->dna_size : -1;
+}
+
+
+/**
+ * @brief apply blocks(starts array followed by sizes array) overlapping
+ * [start, end] to out, which holds bases from start.
+ */
+template <typename Apply>
+static
+void ApplyBlocks(const char *blocks, uint32_t count, int64_t start,
+    int64_t end, Apply apply)
+{
+    const char *starts = blocks;
+    const char *sizes = blocks + 4 * static_cast<size_t>(count);
+
+    // first block which may overlap start: the last one starting <= start
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ReadU32(starts + 4 * static_cast<size_t>(mid)) <= start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    uint32_t i = lo > 0 ? lo - 1 : 0;
+
+    for (; i < count; ++i) {
+        int64_t block_start = ReadU32(starts + 4 * static_cast<size_t>(i));
+        if (block_start > end) break;
+        int64_t block_end = block_start +
+            ReadU32(sizes + 4 * static_cast<size_t>(i)) - 1;
+        int64_t s = std::max(block_start, start);
+        int64_t e = std::min(block_end, end);
+        if (s <= e) apply(s - start, e - s + 1);
+    }
+}
+
+
+bool TwoBitReader::fetch(const std::string &name, int64_t start,
+    int64_t end, std::string &out) const
+{
+    const Record *record = GetRecord(name);
+    if (record == nullptr) return false;
+
+    start = std::max<int64_t>(start, 0);
+    end = std::min<int64_t>(end, static_cast<int64_t>(record->dna_size) - 1);
+    out.clear();
+    if (start > end) return true;
+
+    out.resize(end - start + 1);
+    char *p = &out[0];
+    const uint8_t *dna = record->dna;
+    const char *unpack = UnpackTable();
+    int64_t pos = start;
+    while (pos <= end && (pos & 3)) {
+        *p++ = unpack[dna[pos >> 2] * 4 + (pos & 3)];
+        ++pos;
+    }
+    while (pos + 3 <= end) {
+        std::memcpy(p, unpack + dna[pos >> 2] * 4, 4);
+        p += 4;
+        pos += 4;
+    }
+    while (pos <= end) {
+        *p++ = unpack[dna[pos >> 2] * 4 + (pos & 3)];
+        ++pos;
+    }
+
+    char *bases = &out[0];
+    ApplyBlocks(record->n_blocks, record->n_count, start, end,
+        [bases](int64_t offset, int64_t len) {
+            std::memset(bases + offset, 'N', len);
+        });
+    ApplyBlocks(record->mask_blocks, record->mask_count, start, end,
+        [bases](int64_t offset, int64_t len) {
+            for (int64_t i = offset; i < offset + len; ++i) {
+                bases[i] = static_cast<char>(
+                    std::tolower(static_cast<unsigned char>(bases[i])));
+            }
+        });
+
+    return true;
+}
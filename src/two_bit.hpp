@@ -0,0 +1,83 @@
+#ifndef FASTX_TWO_BIT_HPP
+#define FASTX_TWO_BIT_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+/*
+ * UCSC .2bit format(https://genome.ucsc.edu/FAQ/FAQformat.html#format7):
+ *
+ *   header:  signature, version, sequence count, reserved(uint32 each)
+ *   index:   name size(uint8), name, record offset(uint32, uint64 if
+ *            version 1) for each sequence
+ *   record:  dna size, N block count, N block starts, N block sizes,
+ *            mask block count, mask block starts, mask block sizes,
+ *            reserved(uint32 each), packed dna(4 bases per byte, T=0 C=1
+ *            A=2 G=3, first base in the high bits)
+ *
+ * Runs of bases other than ACGT are N blocks, lower case runs are mask
+ * blocks. Integers are little endian.
+ */
+const uint32_t TWO_BIT_SIGNATURE = 0x1A412743;
+
+
+// check signature of a .2bit file
+bool IsTwoBit(const std::string &filename);
+
+
+/**
+ * @brief random access to a .2bit file. The file is mapped read-only, a fetch
+ * unpacks the bases in place of the mapping, there is nothing to load except
+ * the sequence index.
+ */
+class TwoBitReader {
+public:
+    explicit TwoBitReader(const std::string &filename);
+    ~TwoBitReader();
+
+    TwoBitReader(const TwoBitReader &) = delete;
+    TwoBitReader &operator=(const TwoBitReader &) = delete;
+
+    bool has(const std::string &name) const {
+        return index_.find(name) != index_.end();
+    }
+
+    // sequence length, -1 if name not found
+    int64_t length(const std::string &name) const;
+
+    /**
+     * @brief fetch 0-based closed range [start, end] of a sequence, positions
+     * are clamped to the sequence.
+     *
+     * @param out bases, N blocks are N and mask blocks are lower case
+     * @return false if name not found
+     */
+    bool fetch(const std::string &name, int64_t start, int64_t end,
+        std::string &out) const;
+
+private:
+    struct Record {
+        uint32_t dna_size;
+        uint32_t n_count;
+        // starts and sizes of N and mask blocks, not aligned
+        const char *n_blocks;
+        uint32_t mask_count;
+        const char *mask_blocks;
+        const uint8_t *dna;
+    };
+
+    const Record *GetRecord(const std::string &name) const;
+
+    std::string filename_;
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+    std::unordered_map<std::string, Record> index_;
+};
+
+
+#endif  // FASTX_TWO_BIT_HPP
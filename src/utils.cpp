@@ -1,5 +1,6 @@
 #include <climits>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <cmath>
 #include "utils.hpp"
@@ -84,3 +85,20 @@ double SafeStrtod(const char *str)
 
     return res;
 }
+
+
+SimdLevel SimdLimit()
+{
+    static const SimdLevel limit = [] {
+        const char *env = std::getenv("FASTX_SIMD");
+        if (env == nullptr || std::strcmp(env, "avx2") == 0) {
+            return SimdLevel::kAvx2;
+        }
+        if (std::strcmp(env, "sse") == 0) return SimdLevel::kSse;
+        if (std::strcmp(env, "scalar") == 0) return SimdLevel::kScalar;
+        std::cerr << "[SimdLimit] Error! FASTX_SIMD must be scalar, sse or "
+            << "avx2, not " << env << std::endl;
+        std::exit(1);
+    }();
+    return limit;
+}
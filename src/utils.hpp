@@ -34,4 +34,20 @@ long SafeStrtol(const char *str, int base);
 double SafeStrtod(const char *str);
 
 
+// instruction sets of the vectorized kernels, in increasing order
+enum class SimdLevel {
+    kScalar,
+    kSse,
+    kAvx2
+};
+
+
+/**
+ * @brief highest instruction set the vectorized kernels may use. All by
+ * default, the FASTX_SIMD environment variable(scalar, sse or avx2) lowers
+ * it to test or benchmark the fallbacks. Kernels still check the cpu.
+ */
+SimdLevel SimdLimit();
+
+
 #endif  // FASTX_COMMON_HPP